@@ -0,0 +1,166 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#include "edlib.h"
+#include "../common/runTasks.h"
+#include "../common/readFasta.h"
+#include "shardFile.h"
+
+using namespace std;
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    int k = -1;
+    int numShards = 1;
+    int shard = 0;
+    int numThreads = 1;
+    const char* outputPath = NULL;
+    bool printPlan = false;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "k:n:s:t:o:P")) >= 0) {
+        switch (option) {
+        case 'k': k = atoi(optarg); break;
+        case 'n': numShards = atoi(optarg); break;
+        case 's': shard = atoi(optarg); break;
+        case 't': numThreads = atoi(optarg); break;
+        case 'o': outputPath = optarg; break;
+        case 'P': printPlan = true; break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind + 1 != argc || invalidOption || numShards < 1 || shard < 0 || shard >= numShards
+        || numThreads < 0 || (!printPlan && outputPath == NULL)) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] -o <shard.bin> <sequences.fasta>\n", argv[0]);
+        fprintf(stderr, "Computes one shard of all-vs-all comparison: edit distance (NW) of pairs (i, j), i < j,"
+                " of sequences in fasta file (indexed from 0 in order in which they are in file)."
+                " Pairs are split into shards of about the same work (by lengths of sequences), so that"
+                " each shard can be computed by separate process, on any machine that has the same fasta file."
+                " Pairs with edit distance at most K are written to binary shard file, and shard files are"
+                " combined with edlib-allvsall-merge.\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-n N  Number of shards. [default: 1]\n");
+        fprintf(stderr, "\t-s S  Index of shard that is computed, from 0 to N - 1. [default: 0]\n");
+        fprintf(stderr, "\t-k K  Largest edit distance of pairs that are written, -1 for all pairs. [default: -1]\n");
+        fprintf(stderr, "\t-t T  Number of threads, 0 for number of hardware threads. [default: 1]\n");
+        fprintf(stderr, "\t-o FILE  Shard file that pairs are written to.\n");
+        fprintf(stderr, "\t-P  If specified, plan is printed as lines \"<shard>\\t<first row>\\t<last row>"
+                "\\t<first column>\\t<last column>\\t<work>\" (one per tile) and nothing is computed.\n");
+        return 1;
+    }
+    if (numThreads == 0) numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    //-------------------------------------------------------------------------//
+
+    vector< vector<char> > sequences;
+    if (readFastaSequences(argv[optind], &sequences)) {
+        fprintf(stderr, "Error: There is no file with name %s\n", argv[optind]);
+        return 1;
+    }
+    const int numSequences = static_cast<int>(sequences.size());
+    vector<const char*> pointers;
+    vector<int> lengths;
+    for (const vector<char>& sequence : sequences) {
+        pointers.push_back(sequence.data());
+        lengths.push_back(static_cast<int>(sequence.size()));
+    }
+
+    const EdlibAllVsAllPlan plan = edlibPlanAllVsAll(lengths.data(), numSequences, numShards);
+    if (printPlan) {
+        for (int s = 0; s < numShards; s++) {
+            for (int t = plan.shardTiles[s]; t < plan.shardTiles[s + 1]; t++) {
+                const EdlibTile& tile = plan.tiles[t];
+                printf("%d\t%d\t%d\t%d\t%d\t%.0lf\n", s, tile.rowBegin, tile.rowEnd - 1,
+                       tile.columnBegin, tile.columnEnd - 1, tile.work);
+            }
+        }
+        edlibFreeAllVsAllPlan(plan);
+        return 0;
+    }
+
+    // Each task aligns few rows of one tile to its columns, as one batch of all pairs. In tiles on diagonal,
+    // columns start after first row of task, so only few pairs that are not above diagonal are aligned.
+    const int ROWS_PER_TASK = 32;
+    struct Task {
+        int rowBegin;
+        int rowEnd;
+        int columnBegin;
+        int columnEnd;
+    };
+    vector<Task> tasks;
+    double shardWork = 0, totalWork = 0;
+    for (int t = 0; t < plan.numTiles; t++) totalWork += plan.tiles[t].work;
+    for (int t = plan.shardTiles[shard]; t < plan.shardTiles[shard + 1]; t++) {
+        const EdlibTile& tile = plan.tiles[t];
+        shardWork += tile.work;
+        for (int i = tile.rowBegin; i < tile.rowEnd; i += ROWS_PER_TASK) {
+            const int columnBegin = max(tile.columnBegin, i + 1);
+            if (columnBegin < tile.columnEnd) {
+                tasks.push_back({i, min(tile.rowEnd, i + ROWS_PER_TASK), columnBegin, tile.columnEnd});
+            }
+        }
+    }
+    fprintf(stderr, "Shard %d of %d has %d tiles with %.2lf%% of work.\n", shard, numShards,
+            plan.shardTiles[shard + 1] - plan.shardTiles[shard], totalWork > 0 ? 100 * shardWork / totalWork : 0);
+
+    const auto start = chrono::steady_clock::now();
+    vector< vector<ShardPair> > taskPairs(tasks.size());
+    runTasks(static_cast<int>(tasks.size()), numThreads, [&](int t) {
+        const Task& task = tasks[t];
+        const int numRows = task.rowEnd - task.rowBegin;
+        const int numColumns = task.columnEnd - task.columnBegin;
+        const EdlibAlignConfig config = edlibNewAlignConfig(k, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0);
+        vector<EdlibAlignResult> results(static_cast<size_t>(numRows) * numColumns);
+        edlibAlignAllPairs(pointers.data() + task.rowBegin, lengths.data() + task.rowBegin, numRows,
+                           pointers.data() + task.columnBegin, lengths.data() + task.columnBegin, numColumns,
+                           config, results.data());
+        for (int r = 0; r < numRows; r++) {
+            for (int c = 0; c < numColumns; c++) {
+                EdlibAlignResult& result = results[static_cast<size_t>(r) * numColumns + c];
+                const int i = task.rowBegin + r, j = task.columnBegin + c;
+                if (i < j && result.editDistance >= 0) taskPairs[t].push_back({i, j, result.editDistance});
+                edlibFreeAlignResult(result);
+            }
+        }
+    });
+    edlibFreeAllVsAllPlan(plan);
+
+    vector<ShardPair> pairs;
+    for (vector<ShardPair>& found : taskPairs) {
+        pairs.insert(pairs.end(), found.begin(), found.end());
+        vector<ShardPair>().swap(found);
+    }
+    sort(pairs.begin(), pairs.end(), [](const ShardPair& a, const ShardPair& b) {
+        return a.i != b.i ? a.i < b.i : a.j < b.j;
+    });
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ShardFileHeader header = newShardFileHeader();
+    header.numSequences = numSequences;
+    header.numShards = numShards;
+    header.shard = shard;
+    header.k = k;
+    header.fingerprint = sequencesFingerprint(sequences);
+    header.numPairs = pairs.size();
+    FILE* output = fopen(outputPath, "wb");
+    if (output == NULL || fwrite(&header, sizeof(header), 1, output) != 1
+        || fwrite(pairs.data(), sizeof(ShardPair), pairs.size(), output) != pairs.size()) {
+        fprintf(stderr, "Error: Can not write %s\n", outputPath);
+        if (output) fclose(output);
+        return 1;
+    }
+    if (fclose(output)) {
+        fprintf(stderr, "Error: Can not write %s\n", outputPath);
+        return 1;
+    }
+    fprintf(stderr, "Found %lld pairs in %lf seconds.\n", static_cast<long long>(pairs.size()), seconds);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <utility>
+
+#include "shardFile.h"
+
+using namespace std;
+
+// Reads pairs of shard file in chunks.
+struct ShardReader {
+    FILE* file;
+    ShardFileHeader header;
+    uint64_t numRead;  // Number of pairs read from file so far.
+    vector<ShardPair> buffer;
+    size_t position;  // Position of current pair in buffer.
+
+    // @return False if there are no more pairs or file is too short.
+    bool next(ShardPair* pair) {
+        if (position == buffer.size()) {
+            const size_t CHUNK_SIZE = 1 << 14;
+            const size_t numWanted = static_cast<size_t>(min<uint64_t>(CHUNK_SIZE, header.numPairs - numRead));
+            buffer.resize(numWanted);
+            if (numWanted == 0 || fread(buffer.data(), sizeof(ShardPair), numWanted, file) != numWanted) return false;
+            numRead += numWanted;
+            position = 0;
+        }
+        *pair = buffer[position++];
+        return true;
+    }
+};
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    const char* outputPath = NULL;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "o:")) >= 0) {
+        switch (option) {
+        case 'o': outputPath = optarg; break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind >= argc || invalidOption) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] <shard.bin>...\n", argv[0]);
+        fprintf(stderr, "Merges shard files written by edlib-allvsall, given in any order, and prints pairs"
+                " as lines \"<i>\\t<j>\\t<edit distance>\" ordered by i and then by j."
+                " All shards of the same comparison must be given.\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-o FILE  If specified, pairs are written to FILE as one merged shard file"
+                " instead of being printed.\n");
+        return 1;
+    }
+    //-------------------------------------------------------------------------//
+
+    const int numFiles = argc - optind;
+    vector<ShardReader> readers(numFiles);
+    vector<char> hasShard;
+    uint64_t numPairs = 0;
+    for (int f = 0; f < numFiles; f++) {
+        const char* path = argv[optind + f];
+        ShardReader& reader = readers[f];
+        reader.file = fopen(path, "rb");
+        reader.numRead = 0;
+        reader.position = 0;
+        if (reader.file == NULL || !readShardFileHeader(reader.file, &reader.header)) {
+            fprintf(stderr, "Error: %s is not shard file\n", path);
+            return 1;
+        }
+        const ShardFileHeader& header = reader.header;
+        const ShardFileHeader& first = readers[0].header;
+        if (header.numSequences != first.numSequences || header.numShards != first.numShards
+            || header.k != first.k || header.fingerprint != first.fingerprint) {
+            fprintf(stderr, "Error: %s belongs to different comparison than %s\n", path, argv[optind]);
+            return 1;
+        }
+        hasShard.resize(header.numShards, 0);
+        if (header.shard < 0 || header.shard >= header.numShards || hasShard[header.shard]) {
+            fprintf(stderr, "Error: Shard %d of %s is given twice or is invalid\n", header.shard, path);
+            return 1;
+        }
+        hasShard[header.shard] = 1;
+        numPairs += header.numPairs;
+    }
+    if (numFiles != readers[0].header.numShards) {
+        fprintf(stderr, "Error: Comparison has %d shards, but %d are given\n", readers[0].header.numShards, numFiles);
+        return 1;
+    }
+
+    FILE* output = stdout;
+    if (outputPath) {
+        output = fopen(outputPath, "wb");
+        ShardFileHeader header = readers[0].header;
+        header.numShards = 1;
+        header.shard = 0;
+        header.numPairs = numPairs;
+        if (output == NULL || fwrite(&header, sizeof(header), 1, output) != 1) {
+            fprintf(stderr, "Error: Can not write %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    // Pairs of each file are ordered, so smallest of current pairs of files is always next.
+    typedef pair< pair<int, int>, int > QueueItem;  // ((i, j), index of file).
+    priority_queue< QueueItem, vector<QueueItem>, greater<QueueItem> > queue;
+    vector<ShardPair> current(numFiles);
+    for (int f = 0; f < numFiles; f++) {
+        if (readers[f].next(&current[f])) queue.push(make_pair(make_pair(current[f].i, current[f].j), f));
+    }
+    vector<ShardPair> outputBuffer;
+    uint64_t numMerged = 0;
+    bool ordered = true;
+    pair<int, int> last(-1, -1);
+    while (!queue.empty()) {
+        const int f = queue.top().second;
+        ordered = ordered && queue.top().first > last;
+        last = queue.top().first;
+        queue.pop();
+        const ShardPair& found = current[f];
+        if (outputPath) {
+            outputBuffer.push_back(found);
+            if (outputBuffer.size() == (1 << 14)) {
+                fwrite(outputBuffer.data(), sizeof(ShardPair), outputBuffer.size(), output);
+                outputBuffer.clear();
+            }
+        } else {
+            fprintf(output, "%d\t%d\t%d\n", found.i, found.j, found.editDistance);
+        }
+        numMerged++;
+        if (readers[f].next(&current[f])) queue.push(make_pair(make_pair(current[f].i, current[f].j), f));
+    }
+    fwrite(outputBuffer.data(), sizeof(ShardPair), outputBuffer.size(), output);
+    for (ShardReader& reader : readers) fclose(reader.file);
+
+    if (ferror(output) || (outputPath && fclose(output))) {
+        fprintf(stderr, "Error: Can not write %s\n", outputPath ? outputPath : "output");
+        return 1;
+    }
+    if (numMerged != numPairs || !ordered) {
+        fprintf(stderr, "Error: Shard files are truncated or their pairs are not ordered\n");
+        return 1;
+    }
+    fprintf(stderr, "Merged %lld pairs from %d shards.\n", static_cast<long long>(numMerged), numFiles);
+    return 0;
+}
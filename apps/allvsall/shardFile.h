@@ -0,0 +1,73 @@
+#ifndef EDLIB_SHARD_FILE_H
+#define EDLIB_SHARD_FILE_H
+
+/**
+ * Binary file with pairs found by one shard of all-vs-all comparison (or by all of them, once merged).
+ * File is ShardFileHeader followed by numPairs ShardPair records, ordered by i and then by j.
+ * All numbers are in native byte order of machine that wrote the file, which is checked through magic.
+ */
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../common/fnv1a.h"
+
+#define EDLIB_SHARD_FILE_MAGIC "EDLIBAVA"
+#define EDLIB_SHARD_FILE_VERSION 1
+
+struct ShardFileHeader {
+    char magic[8];  // EDLIB_SHARD_FILE_MAGIC, without terminating zero.
+    uint32_t version;  // EDLIB_SHARD_FILE_VERSION.
+    int32_t numSequences;
+    int32_t numShards;  // 1 for merged file.
+    int32_t shard;  // Index of shard, 0 for merged file.
+    int32_t k;  // Largest edit distance of pairs, -1 if all pairs were kept.
+    int32_t reserved;
+    uint64_t fingerprint;  // Hash of sequences, see sequencesFingerprint().
+    uint64_t numPairs;
+};
+
+struct ShardPair {
+    int32_t i;
+    int32_t j;  // i < j.
+    int32_t editDistance;
+};
+
+static_assert(sizeof(ShardFileHeader) == 48 && sizeof(ShardPair) == 12, "Shard file records must not be padded");
+
+/**
+ * @return FNV-1a hash of lengths and characters of sequences, so that files computed from different
+ *         sequences are not merged together.
+ */
+inline uint64_t sequencesFingerprint(const std::vector< std::vector<char> >& sequences) {
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+    for (const std::vector<char>& sequence : sequences) {
+        // Length is hashed byte by byte from least significant one, so that hash does not depend on byte order.
+        unsigned char length[4];
+        for (int b = 0; b < 4; b++) length[b] = static_cast<unsigned char>(sequence.size() >> (8 * b));
+        hash = fnv1a(sequence.data(), sequence.size(), fnv1a(length, sizeof(length), hash));
+    }
+    return hash;
+}
+
+inline ShardFileHeader newShardFileHeader() {
+    ShardFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EDLIB_SHARD_FILE_MAGIC, sizeof(header.magic));
+    header.version = EDLIB_SHARD_FILE_VERSION;
+    return header;
+}
+
+/**
+ * Reads header of shard file and leaves file positioned at its first pair.
+ * @return False if file is not shard file of supported version.
+ */
+inline bool readShardFileHeader(FILE* file, ShardFileHeader* header) {
+    return fread(header, sizeof(*header), 1, file) == 1
+        && !memcmp(header->magic, EDLIB_SHARD_FILE_MAGIC, sizeof(header->magic))
+        && header->version == EDLIB_SHARD_FILE_VERSION;
+}
+
+#endif // EDLIB_SHARD_FILE_H
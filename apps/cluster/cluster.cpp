@@ -0,0 +1,314 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <ctime>
+
+#include "edlib.h"
+#include "../common/fnv1a.h"
+#include "../common/readFasta.h"
+
+using namespace std;
+
+struct Sequence {
+    string name;
+    vector<char> residues;
+};
+
+// Clustering parameters.
+struct Parameters {
+    double identity;
+    EdlibAlignMode mode;
+    int kmerLength;
+};
+
+// Assignment of sequence to cluster.
+struct Assignment {
+    int centroid;  // Index of centroid (in order of creation), -1 if sequence is not within threshold of any.
+    int editDistance;
+    string cigar;
+};
+
+/**
+ * Greedy clustering: sequences are processed from longest to shortest, and each of them is assigned to the
+ * first centroid (in order of creation) that it is within identity threshold of, or becomes new centroid.
+ * Identity of sequence s and centroid c is 1 - d / |c| in NW mode, and 1 - d / |s| in SHW mode (where s is
+ * aligned to prefix of c), so sequence is within threshold of centroid if d <= k(s, c), where
+ * k(s, c) = floor((1 - identity) * |c|) or floor((1 - identity) * |s|).
+ *
+ * Centroids are filtered before they are aligned to sequence: in NW mode their length must differ by at most k,
+ * and in both modes they must share at least distinct(s) - k * w distinct k-mers (of length w) with s,
+ * since each edit destroys at most w k-mers of s.
+ */
+class Clusterer {
+public:
+    Clusterer(const vector<Sequence>& sequences, const Parameters& parameters)
+        : sequences_(sequences), parameters_(parameters) {}
+
+    /**
+     * Assigns sequence to the first centroid among centroids [centroidsBegin, centroidsEnd) that it is
+     * within threshold of. Index must not change during the call, so it can be called from multiple threads.
+     * @param [in] counts  Buffer with at least centroidsEnd zeros, it is left zeroed.
+     */
+    Assignment assign(int s, int centroidsBegin, int centroidsEnd, vector<int>& counts) const {
+        Assignment assignment;
+        assignment.centroid = -1;
+        assignment.editDistance = -1;
+        const vector<uint64_t> kmers = distinctKmers(s);
+        const int length = static_cast<int>(sequences_[s].residues.size());
+
+        // If even the largest k of any centroid would let k-mer filter pass all centroids, it is skipped.
+        // In NW mode, centroid within threshold has |c| <= |s| + k(s, c), so |c| <= |s| / identity.
+        const int largestK = parameters_.mode == EDLIB_MODE_NW
+            ? static_cast<int>((1 - parameters_.identity) * length / parameters_.identity) + 1 : maxK(length);
+        const bool filterKmers = static_cast<long long>(kmers.size())
+            > static_cast<long long>(largestK) * parameters_.kmerLength;
+
+        vector<int> candidates;
+        if (filterKmers) {
+            vector<int> touched;
+            for (const uint64_t kmer : kmers) {
+                const auto it = index_.find(kmer);
+                if (it == index_.end()) continue;
+                const vector<int>& centroids = it->second;
+                for (auto c = lower_bound(centroids.begin(), centroids.end(), centroidsBegin);
+                     c != centroids.end() && *c < centroidsEnd; c++) {
+                    if (counts[*c]++ == 0) touched.push_back(*c);
+                }
+            }
+            for (const int c : touched) {
+                const long long minShared = static_cast<long long>(kmers.size())
+                    - static_cast<long long>(k(s, c)) * parameters_.kmerLength;
+                if (counts[c] >= minShared) candidates.push_back(c);
+                counts[c] = 0;
+            }
+            sort(candidates.begin(), candidates.end());
+        } else {
+            for (int c = centroidsBegin; c < centroidsEnd; c++) candidates.push_back(c);
+        }
+
+        for (const int c : candidates) {
+            const vector<char>& centroid = sequences_[centroids_[c]].residues;
+            const int kc = k(s, c);
+            if (parameters_.mode == EDLIB_MODE_NW && abs(static_cast<int>(centroid.size()) - length) > kc) continue;
+            EdlibAlignResult result = edlibAlign(sequences_[s].residues.data(), length,
+                                                 centroid.data(), static_cast<int>(centroid.size()),
+                                                 edlibNewAlignConfig(kc, parameters_.mode, EDLIB_TASK_DISTANCE,
+                                                                     NULL, 0));
+            const int distance = result.editDistance;
+            edlibFreeAlignResult(result);
+            if (distance < 0 || distance > kc) continue;
+            assignment.centroid = c;
+            assignment.editDistance = distance;
+            assignment.cigar = cigar(s, centroids_[c], distance);
+            break;
+        }
+        return assignment;
+    }
+
+    /**
+     * Makes sequence new centroid, must not be called while assign() runs.
+     * @return Index of centroid.
+     */
+    int addCentroid(int s) {
+        const int c = static_cast<int>(centroids_.size());
+        centroids_.push_back(s);
+        for (const uint64_t kmer : distinctKmers(s)) index_[kmer].push_back(c);
+        return c;
+    }
+
+    int numCentroids() const { return static_cast<int>(centroids_.size()); }
+    int centroid(int c) const { return centroids_[c]; }
+
+private:
+    int maxK(int length) const {
+        return static_cast<int>((1 - parameters_.identity) * length);
+    }
+
+    int k(int s, int c) const {
+        return maxK(static_cast<int>(
+            sequences_[parameters_.mode == EDLIB_MODE_NW ? centroids_[c] : s].residues.size()));
+    }
+
+    vector<uint64_t> distinctKmers(int s) const {
+        const vector<char>& residues = sequences_[s].residues;
+        const int w = parameters_.kmerLength;
+        vector<uint64_t> kmers;
+        for (int i = 0; i + w <= static_cast<int>(residues.size()); i++) {
+            kmers.push_back(fnv1a(residues.data() + i, w));
+        }
+        sort(kmers.begin(), kmers.end());
+        kmers.erase(unique(kmers.begin(), kmers.end()), kmers.end());
+        return kmers;
+    }
+
+    // Cigar of alignment of sequence s to centroid sequence, "=" if they are equal.
+    string cigar(int s, int centroidSequence, int distance) const {
+        const vector<char>& query = sequences_[s].residues;
+        const vector<char>& target = sequences_[centroidSequence].residues;
+        if (distance == 0 && query.size() == target.size()) return "=";
+        EdlibAlignResult result = edlibAlign(query.data(), static_cast<int>(query.size()),
+                                             target.data(), static_cast<int>(target.size()),
+                                             edlibNewAlignConfig(distance, parameters_.mode, EDLIB_TASK_PATH,
+                                                                 NULL, 0));
+        char* cigar = edlibAlignmentToCigar(result.alignment, result.alignmentLength, EDLIB_CIGAR_STANDARD);
+        const string cigarString = cigar;
+        free(cigar);
+        edlibFreeAlignResult(result);
+        return cigarString;
+    }
+
+    const vector<Sequence>& sequences_;
+    const Parameters parameters_;
+    vector<int> centroids_;  // Index of sequence of each centroid.
+    unordered_map<uint64_t, vector<int>> index_;  // Centroids (in increasing order) that have k-mer.
+};
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    Parameters parameters;
+    parameters.identity = 0.97;
+    parameters.kmerLength = 8;
+    char mode[16] = "NW";
+    int numThreads = 1;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "i:m:w:t:")) >= 0) {
+        switch (option) {
+        case 'i': parameters.identity = atof(optarg); break;
+        case 'm': strncpy(mode, optarg, sizeof(mode) - 1); break;
+        case 'w': parameters.kmerLength = atoi(optarg); break;
+        case 't': numThreads = atoi(optarg); break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind + 1 != argc || invalidOption) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] <sequences.fasta>\n", argv[0]);
+        fprintf(stderr, "Clusters sequences greedily: from longest to shortest, each sequence is assigned to the"
+                " first centroid that it is within identity threshold of, or becomes new centroid."
+                " Clusters are printed in UC format (as by USEARCH and VSEARCH).\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-i I  Identity threshold, in (0, 1]. Identity of sequence and centroid is"
+                " 1 - (edit distance) / (length of centroid) in NW mode, and"
+                " 1 - (edit distance) / (length of sequence) in SHW mode. [default: 0.97]\n");
+        fprintf(stderr, "\t-m NW|SHW  Alignment mode, in SHW mode sequence is aligned to prefix of centroid."
+                " [default: NW]\n");
+        fprintf(stderr, "\t-w W  Length of k-mers that are used to filter centroids. [default: 8]\n");
+        fprintf(stderr, "\t-t T  Number of threads, 0 for number of hardware threads. [default: 1]\n");
+        return 1;
+    }
+    //-------------------------------------------------------------------------//
+
+    if (!(parameters.identity > 0 && parameters.identity <= 1)) {
+        fprintf(stderr, "Invalid identity threshold (-i)!\n");
+        return 1;
+    }
+    if (!strcmp(mode, "NW")) {
+        parameters.mode = EDLIB_MODE_NW;
+    } else if (!strcmp(mode, "SHW")) {
+        parameters.mode = EDLIB_MODE_SHW;
+    } else {
+        fprintf(stderr, "Invalid mode (-m)!\n");
+        return 1;
+    }
+    if (parameters.kmerLength <= 0) {
+        fprintf(stderr, "Invalid k-mer length (-w)!\n");
+        return 1;
+    }
+    if (numThreads <= 0) numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+
+    vector< vector<char> > residues;
+    vector<string> names;
+    fprintf(stderr, "Reading sequences...\n");
+    if (readFastaSequences(argv[optind], &residues, &names)) {
+        fprintf(stderr, "Error: There is no file with name %s\n", argv[optind]);
+        return 1;
+    }
+    const int numSequences = static_cast<int>(residues.size());
+    // Unnamed sequences are named by their index.
+    vector<Sequence> sequences(numSequences);
+    for (int i = 0; i < numSequences; i++) {
+        sequences[i].name = names[i].empty() ? to_string(i) : names[i];
+        sequences[i].residues.swap(residues[i]);
+    }
+    fprintf(stderr, "Read %d sequences.\n", numSequences);
+
+    clock_t start = clock();
+    vector<int> order(numSequences);
+    for (int i = 0; i < numSequences; i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&sequences](int x, int y) {
+        return sequences[x].residues.size() > sequences[y].residues.size();
+    });
+
+    // Sequences are processed in batches: first all sequences of batch are assigned, in parallel, to centroids
+    // that existed before batch. Then, in order, those that were not assigned are assigned to centroids
+    // created in batch, or become new centroids. That gives the same result as processing one by one.
+    Clusterer clusterer(sequences, parameters);
+    vector<Assignment> assignments(numSequences);
+    vector<int> clusterSizes;
+    vector< vector<int> > counts(numThreads);
+    const int batchSize = numThreads * 64;
+    for (int batchStart = 0; batchStart < numSequences; batchStart += batchSize) {
+        const int batchEnd = min(numSequences, batchStart + batchSize);
+        const int numOldCentroids = clusterer.numCentroids();
+        for (vector<int>& threadCounts : counts) threadCounts.resize(numOldCentroids + batchSize, 0);
+        const auto assignRange = [&](int thread) {
+            for (int i = batchStart + thread; i < batchEnd; i += numThreads) {
+                assignments[order[i]] = clusterer.assign(order[i], 0, numOldCentroids, counts[thread]);
+            }
+        };
+        vector<thread> threads;
+        for (int t = 1; t < numThreads; t++) threads.push_back(thread(assignRange, t));
+        assignRange(0);
+        for (thread& t : threads) t.join();
+
+        for (int i = batchStart; i < batchEnd; i++) {
+            Assignment& assignment = assignments[order[i]];
+            if (assignment.centroid == -1) {
+                assignment = clusterer.assign(order[i], numOldCentroids, clusterer.numCentroids(), counts[0]);
+            }
+            if (assignment.centroid == -1) {
+                assignment.centroid = clusterer.addCentroid(order[i]);
+                clusterSizes.push_back(0);
+            }
+            clusterSizes[assignment.centroid]++;
+        }
+    }
+    clock_t finish = clock();
+
+    // Output in UC format: S record for each centroid and H record for each hit, in order in which
+    // they were processed, followed by C record for each cluster.
+    for (int i = 0; i < numSequences; i++) {
+        const int s = order[i];
+        const Assignment& assignment = assignments[s];
+        const int length = static_cast<int>(sequences[s].residues.size());
+        const int centroid = clusterer.centroid(assignment.centroid);
+        if (centroid == s) {
+            printf("S\t%d\t%d\t*\t*\t*\t*\t*\t%s\t*\n", assignment.centroid, length, sequences[s].name.c_str());
+        } else {
+            const int identityLength = static_cast<int>(
+                parameters.mode == EDLIB_MODE_NW ? sequences[centroid].residues.size() : length);
+            const double identity = identityLength == 0
+                ? 100.0 : 100.0 * (1 - static_cast<double>(assignment.editDistance) / identityLength);
+            printf("H\t%d\t%d\t%.1f\t+\t0\t0\t%s\t%s\t%s\n", assignment.centroid, length, identity,
+                   assignment.cigar.c_str(), sequences[s].name.c_str(), sequences[centroid].name.c_str());
+        }
+    }
+    for (int c = 0; c < clusterer.numCentroids(); c++) {
+        printf("C\t%d\t%d\t*\t*\t*\t*\t*\t%s\t*\n", c, clusterSizes[c],
+               sequences[clusterer.centroid(c)].name.c_str());
+    }
+    fprintf(stderr, "Found %d clusters.\n", clusterer.numCentroids());
+    fprintf(stderr, "Cpu time of clustering: %lf\n", static_cast<double>(finish - start) / CLOCKS_PER_SEC);
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef EDLIB_APPS_FNV1A_H
+#define EDLIB_APPS_FNV1A_H
+
+#include <stdint.h>
+#include <cstddef>
+
+const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ULL;
+
+/**
+ * @return FNV-1a hash of given bytes. To hash bytes that are not contiguous, pass hash of previous bytes as hash.
+ */
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV1A_OFFSET_BASIS) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+#endif // EDLIB_APPS_FNV1A_H
@@ -0,0 +1,70 @@
+#ifndef EDLIB_APPS_READ_FASTA_H
+#define EDLIB_APPS_READ_FASTA_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Reads sequences from fasta file.
+ * @param [in] path  Path to fasta file.
+ * @param [out] seqs  Sequences, in order in which they are in file.
+ * @param [out] names  If not NULL, set to names of sequences (headers cut at first whitespace, empty for sequence
+ *                     without header). Then each header starts a sequence, even an empty one, so that names
+ *                     match sequences, while otherwise headers without residues are skipped.
+ * @return 0 if all ok, positive number otherwise.
+ */
+inline int readFastaSequences(const char* path, std::vector< std::vector<char> >* seqs,
+                              std::vector<std::string>* names = NULL) {
+    seqs->clear();
+    if (names) names->clear();
+
+    FILE* file = fopen(path, "r");
+    if (file == 0)
+        return 1;
+
+    bool inHeader = false;
+    bool inSequence = false;
+    const int buffSize = 4096;
+    char buffer[buffSize];
+    while (!feof(file)) {
+        int read = fread(buffer, sizeof(char), buffSize, file);
+        for (int i = 0; i < read; ++i) {
+            char c = buffer[i];
+            if (inHeader) {
+                if (c == '\n')
+                    inHeader = false;
+                else if (names)
+                    names->back().push_back(c);
+            } else {
+                if (c == '>') {
+                    inHeader = true;
+                    inSequence = false;
+                    if (names) {
+                        names->push_back(std::string());
+                        seqs->push_back(std::vector<char>());
+                        inSequence = true;
+                    }
+                } else {
+                    if (c == '\r' || c == '\n')
+                        continue;
+                    // If starting new sequence, initialize it.
+                    if (inSequence == false) {
+                        inSequence = true;
+                        seqs->push_back(std::vector<char>());
+                        if (names) names->push_back(std::string());
+                    }
+                    seqs->back().push_back(c);
+                }
+            }
+        }
+    }
+    fclose(file);
+
+    if (names) {
+        for (std::string& name : *names) name = name.substr(0, name.find_first_of(" \t\r"));
+    }
+    return 0;
+}
+
+#endif // EDLIB_APPS_READ_FASTA_H
@@ -0,0 +1,25 @@
+#ifndef EDLIB_APPS_RUN_TASKS_H
+#define EDLIB_APPS_RUN_TASKS_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs task(0), ..., task(numTasks - 1) on given number of threads (including calling thread),
+ * each thread takes next task once it finishes one.
+ */
+inline void runTasks(int numTasks, int numThreads, const std::function<void(int)>& task) {
+    std::atomic<int> nextTask(0);
+    const auto work = [&]() {
+        for (int t = nextTask++; t < numTasks; t = nextTask++) task(t);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(numThreads, numTasks); i++) threads.push_back(std::thread(work));
+    work();
+    for (std::thread& t : threads) t.join();
+}
+
+#endif // EDLIB_APPS_RUN_TASKS_H
@@ -0,0 +1,418 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+
+#include "edlib.h"
+#include "../common/runTasks.h"
+
+using namespace std;
+
+// Content of input, mapped to memory if it is a regular file.
+struct Input {
+    const char* data;
+    long long size;
+    void* mapped;  // NULL if content was read to buffer instead.
+    vector<char> buffer;
+};
+
+int openInput(const char* path, Input* input);
+void closeInput(Input* input);
+
+// Pattern that is searched for.
+struct Pattern {
+    const char* pattern;
+    int length;
+    int k;
+    const EdlibQueryProfile* profile;
+};
+
+// Line that contains occurrence of pattern.
+struct LineMatch {
+    long long start;  // Position of line in input.
+    long long end;  // Position of newline character that ends line, or of end of input.
+    long long lineNumber;  // One-based.
+    long long offset;  // Position of best occurrence in input.
+    int editDistance;  // Edit distance of best occurrence.
+};
+
+// Occurrence of pattern in sequence of FASTA record.
+struct RecordMatch {
+    int record;
+    long long start;  // Position of occurrence in sequence, zero-based.
+    long long end;  // Position after occurrence.
+    int editDistance;
+};
+
+/**
+ * Best occurrence of pattern in sequence (EDLIB_MODE_HW).
+ * @param [out] start  Position of first occurrence with smallest edit distance.
+ * @return Edit distance of occurrence.
+ */
+int bestOccurrence(const Pattern& pattern, const char* sequence, long long length, long long* start) {
+    EdlibAlignResult result = edlibAlign(pattern.pattern, pattern.length, sequence, static_cast<int>(length),
+                                         edlibNewAlignConfig(pattern.k, EDLIB_MODE_HW, EDLIB_TASK_LOC, NULL, 0));
+    const int editDistance = result.editDistance;
+    *start = result.startLocations ? result.startLocations[0] : 0;
+    edlibFreeAlignResult(result);
+    return editDistance;
+}
+
+// Collects lines in which occurrences end, while chunk of lines is scanned.
+struct LineScan {
+    const char* chunk;
+    long long chunkLength;
+    vector<LineMatch>* matches;
+};
+
+void addLine(long long endLocation, int editDistance, void* context) {
+    (void) editDistance;
+    const LineScan& scan = *static_cast<LineScan*>(context);
+    vector<LineMatch>& matches = *scan.matches;
+    // Occurrences are reported in increasing order, so occurrence is either in last found line or in new one.
+    if (!matches.empty() && endLocation < matches.back().end) return;
+    LineMatch match;
+    match.start = endLocation;
+    while (match.start > 0 && scan.chunk[match.start - 1] != '\n') match.start--;
+    const void* newline = memchr(scan.chunk + endLocation, '\n', scan.chunkLength - endLocation);
+    match.end = newline ? static_cast<const char*>(newline) - scan.chunk : scan.chunkLength;
+    matches.push_back(match);
+}
+
+/**
+ * Finds lines of input that contain occurrence of pattern.
+ * Input is split at line ends into chunks, which are scanned in parallel.
+ * @return Lines in order in which they are in input.
+ */
+vector<LineMatch> grepLines(const Input& input, const Pattern& pattern, int numThreads) {
+    // Chunks have at least 1MB, and there are a few of them per thread.
+    const long long chunkSize = max(1LL << 20, input.size / (4LL * numThreads) + 1);
+    vector<long long> chunkStarts(1, 0);
+    while (chunkStarts.back() < input.size) {
+        const long long end = min(input.size, chunkStarts.back() + chunkSize);
+        const void* newline = memchr(input.data + end - 1, '\n', input.size - end + 1);
+        chunkStarts.push_back(newline ? static_cast<const char*>(newline) - input.data + 1 : input.size);
+    }
+    const int numChunks = static_cast<int>(chunkStarts.size()) - 1;
+
+    vector< vector<LineMatch> > chunkMatches(numChunks);
+    vector<long long> chunkNumLines(numChunks);
+    runTasks(numChunks, numThreads, [&](int chunk) {
+        const char* const chunkData = input.data + chunkStarts[chunk];
+        const long long chunkLength = chunkStarts[chunk + 1] - chunkStarts[chunk];
+        vector<LineMatch>& matches = chunkMatches[chunk];
+        if (pattern.length <= pattern.k) {
+            // Every line contains occurrence, even empty one.
+            for (long long start = 0; start < chunkLength; ) {
+                LineMatch match;
+                match.start = start;
+                const void* newline = memchr(chunkData + start, '\n', chunkLength - start);
+                match.end = newline ? static_cast<const char*>(newline) - chunkData : chunkLength;
+                matches.push_back(match);
+                start = match.end + 1;
+            }
+        } else {
+            LineScan scan;
+            scan.chunk = chunkData;
+            scan.chunkLength = chunkLength;
+            scan.matches = &matches;
+            edlibScan(pattern.profile, chunkData, chunkLength, pattern.k, '\n', addLine, &scan);
+        }
+
+        // Lines are numbered within chunk, and their best occurrences are found.
+        long long numLines = 0;
+        long long counted = 0;  // Position up to which newlines were counted.
+        for (LineMatch& match : matches) {
+            numLines += count(chunkData + counted, chunkData + match.start, '\n');
+            counted = match.start;
+            match.lineNumber = numLines + 1;
+            long long start;
+            match.editDistance = bestOccurrence(pattern, chunkData + match.start, match.end - match.start, &start);
+            match.offset = chunkStarts[chunk] + match.start + start;
+            match.start += chunkStarts[chunk];
+            match.end += chunkStarts[chunk];
+        }
+        chunkNumLines[chunk] = numLines + count(chunkData + counted, chunkData + chunkLength, '\n');
+    });
+
+    vector<LineMatch> matches;
+    long long linesBefore = 0;
+    for (int chunk = 0; chunk < numChunks; chunk++) {
+        for (LineMatch& match : chunkMatches[chunk]) {
+            match.lineNumber += linesBefore;
+            matches.push_back(match);
+        }
+        linesBefore += chunkNumLines[chunk];
+    }
+    return matches;
+}
+
+// Collects positions where occurrences end, while part of sequence is scanned.
+struct PartScan {
+    long long partStart;  // Position of part in sequence.
+    long long ownStart;  // Only positions from it on are collected, those before are collected by previous part.
+    vector< pair<long long, int> >* ends;
+};
+
+void addEnd(long long endLocation, int editDistance, void* context) {
+    const PartScan& scan = *static_cast<PartScan*>(context);
+    const long long position = scan.partStart + endLocation;
+    if (position >= scan.ownStart) scan.ends->push_back(make_pair(position, editDistance));
+}
+
+/**
+ * Finds occurrences of pattern in sequences of FASTA records (sequences can span multiple lines).
+ * Sequences are split into parts that overlap by pattern length + k, so each occurrence is whole in some part,
+ * and parts are scanned in parallel. Consecutive end positions are one occurrence, whose end is the first
+ * position with smallest edit distance, and its start is found by aligning reversed pattern backwards from it.
+ * @param [out] names  Names of records.
+ * @return Occurrences in order of records and positions.
+ */
+vector<RecordMatch> grepRecords(const Input& input, const Pattern& pattern, int numThreads,
+                                vector<string>* names) {
+    // Sequences are collected without newlines.
+    vector<char> sequences;
+    vector<long long> sequenceStarts;
+    names->clear();
+    for (long long lineStart = 0; lineStart < input.size; ) {
+        const void* newline = memchr(input.data + lineStart, '\n', input.size - lineStart);
+        const long long lineEnd = newline ? static_cast<const char*>(newline) - input.data : input.size;
+        if (input.data[lineStart] == '>' || names->empty()) {
+            sequenceStarts.push_back(static_cast<long long>(sequences.size()));
+            if (input.data[lineStart] == '>') {
+                const char* name = input.data + lineStart + 1;
+                names->push_back(string(name, find_if(name, input.data + lineEnd, [](char c) {
+                    return c == ' ' || c == '\t' || c == '\r';
+                })));
+            } else {  // Sequence without header.
+                names->push_back("");
+            }
+        }
+        if (input.data[lineStart] != '>') {
+            long long end = lineEnd;
+            if (end > lineStart && input.data[end - 1] == '\r') end--;
+            sequences.insert(sequences.end(), input.data + lineStart, input.data + end);
+        }
+        lineStart = lineEnd + 1;
+    }
+    const int numRecords = static_cast<int>(names->size());
+    sequenceStarts.push_back(static_cast<long long>(sequences.size()));
+
+    // Parts of at most 1MB, with enough of them for all threads.
+    struct Part {
+        int record;
+        long long start;
+        long long end;
+    };
+    const long long partSize = max(1LL << 16, min(1LL << 20, static_cast<long long>(sequences.size())
+                                                  / (4LL * numThreads) + 1));
+    vector<Part> parts;
+    for (int r = 0; r < numRecords; r++) {
+        const long long length = sequenceStarts[r + 1] - sequenceStarts[r];
+        for (long long start = 0; start < length; start += partSize) {
+            Part part;
+            part.record = r;
+            part.start = start;
+            part.end = min(length, start + partSize);
+            parts.push_back(part);
+        }
+    }
+    vector< vector< pair<long long, int> > > partEnds(parts.size());
+    const long long overlap = static_cast<long long>(pattern.length) + pattern.k;
+    runTasks(static_cast<int>(parts.size()), numThreads, [&](int p) {
+        const Part& part = parts[p];
+        PartScan scan;
+        scan.partStart = max(0LL, part.start - overlap);
+        scan.ownStart = part.start;
+        scan.ends = &partEnds[p];
+        edlibScan(pattern.profile, sequences.data() + sequenceStarts[part.record] + scan.partStart,
+                  part.end - scan.partStart, pattern.k, -1, addEnd, &scan);
+    });
+
+    // Runs of consecutive end positions are merged, end of occurrence is set to position after its best end.
+    vector<RecordMatch> matches;
+    int runRecord = -1;
+    long long runEnd = -1;  // Position after last end of run.
+    for (int p = 0; p < static_cast<int>(parts.size()); p++) {
+        const int record = parts[p].record;
+        for (const pair<long long, int>& end : partEnds[p]) {
+            if (record == runRecord && end.first == runEnd) {
+                RecordMatch& match = matches.back();
+                if (end.second < match.editDistance) {
+                    match.end = end.first + 1;
+                    match.editDistance = end.second;
+                }
+            } else {
+                RecordMatch match;
+                match.record = record;
+                match.end = end.first + 1;
+                match.editDistance = end.second;
+                matches.push_back(match);
+            }
+            runRecord = record;
+            runEnd = end.first + 1;
+        }
+    }
+
+    // Occurrence starts where reversed pattern, aligned backwards from its end, ends.
+    vector<char> reversedPattern(pattern.pattern, pattern.pattern + pattern.length);
+    reverse(reversedPattern.begin(), reversedPattern.end());
+    vector<char> reversedSequence;
+    for (RecordMatch& match : matches) {
+        const char* const sequence = sequences.data() + sequenceStarts[match.record];
+        const long long windowStart = max(0LL, match.end - pattern.length - match.editDistance);
+        reversedSequence.assign(sequence + windowStart, sequence + match.end);
+        reverse(reversedSequence.begin(), reversedSequence.end());
+        EdlibAlignResult result = edlibAlign(reversedPattern.data(), pattern.length,
+                                             reversedSequence.data(), static_cast<int>(reversedSequence.size()),
+                                             edlibNewAlignConfig(match.editDistance, EDLIB_MODE_SHW,
+                                                                 EDLIB_TASK_DISTANCE, NULL, 0));
+        match.start = match.end - 1 - (result.numLocations > 0 ? result.endLocations[0] : -1);
+        edlibFreeAlignResult(result);
+    }
+    return matches;
+}
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    int k = 1;
+    int numThreads = 1;
+    bool fasta = false;
+    bool countOnly = false;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "k:t:fc")) >= 0) {
+        switch (option) {
+        case 'k': k = atoi(optarg); break;
+        case 't': numThreads = atoi(optarg); break;
+        case 'f': fasta = true; break;
+        case 'c': countOnly = true; break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind + 1 > argc || invalidOption || k < 0) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] <pattern> [<file>...]\n", argv[0]);
+        fprintf(stderr, "Searches files (or standard input if there are none, or file is -) for occurrences of"
+                " pattern with edit distance at most K (as EDLIB_MODE_HW).\n"
+                "Each line that contains occurrence is printed as"
+                " \"<line number>:<byte offset>:<edit distance>:<line>\", where byte offset is position"
+                " of best occurrence in file (zero-based), and edit distance is its edit distance.\n"
+                "In FASTA mode, each occurrence in sequences is printed as"
+                " \"<record name>\\t<start>\\t<end>\\t<edit distance>\", with zero-based start and end"
+                " (end is position after occurrence), and occurrences can span lines of sequence.\n"
+                "Output is prefixed with \"<file>:\" if there are multiple files,"
+                " and it does not depend on number of threads.\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-k K  Largest edit distance of occurrence. [default: 1]\n");
+        fprintf(stderr, "\t-t T  Number of threads, 0 for number of hardware threads. [default: 1]\n");
+        fprintf(stderr, "\t-f  If specified, input is FASTA and its sequences are searched (FASTA mode).\n");
+        fprintf(stderr, "\t-c  If specified, only number of matching lines (or occurrences) is printed.\n");
+        return 2;
+    }
+    //-------------------------------------------------------------------------//
+
+    if (numThreads <= 0) numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    Pattern pattern;
+    pattern.pattern = argv[optind];
+    pattern.length = static_cast<int>(strlen(pattern.pattern));
+    pattern.k = k;
+    EdlibQueryProfile* profile = edlibNewQueryProfile(pattern.pattern, pattern.length, edlibDefaultAlignConfig());
+    pattern.profile = profile;
+
+    vector<const char*> paths(argv + optind + 1, argv + argc);
+    if (paths.empty()) paths.push_back("-");
+    bool found = false;
+    bool failed = false;
+    for (const char* path : paths) {
+        Input input;
+        if (openInput(path, &input)) {
+            fprintf(stderr, "Error: Can not read %s\n", path);
+            failed = true;
+            continue;
+        }
+        const string prefix = paths.size() > 1 ? string(path) + ":" : "";
+        if (fasta) {
+            vector<string> names;
+            const vector<RecordMatch> matches = grepRecords(input, pattern, numThreads, &names);
+            if (countOnly) {
+                printf("%s%zu\n", prefix.c_str(), matches.size());
+            } else {
+                for (const RecordMatch& match : matches) {
+                    printf("%s%s\t%lld\t%lld\t%d\n", prefix.c_str(), names[match.record].c_str(),
+                           match.start, match.end, match.editDistance);
+                }
+            }
+            found = found || !matches.empty();
+        } else {
+            const vector<LineMatch> matches = grepLines(input, pattern, numThreads);
+            if (countOnly) {
+                printf("%s%zu\n", prefix.c_str(), matches.size());
+            } else {
+                for (const LineMatch& match : matches) {
+                    printf("%s%lld:%lld:%d:", prefix.c_str(), match.lineNumber, match.offset, match.editDistance);
+                    fwrite(input.data + match.start, 1, match.end - match.start, stdout);
+                    printf("\n");
+                }
+            }
+            found = found || !matches.empty();
+        }
+        closeInput(&input);
+    }
+    edlibFreeQueryProfile(profile);
+
+    // Same exit status as grep: 0 if something was found, 1 if not, 2 on error.
+    return failed ? 2 : (found ? 0 : 1);
+}
+
+
+
+int openInput(const char* path, Input* input) {
+    input->mapped = NULL;
+    input->buffer.clear();
+    const bool isStdin = !strcmp(path, "-");
+    const int fd = isStdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode) && fileStat.st_size > 0) {
+        void* mapped = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            input->mapped = mapped;
+            input->data = static_cast<const char*>(mapped);
+            input->size = fileStat.st_size;
+            if (!isStdin) close(fd);
+            return 0;
+        }
+    }
+
+    // Pipes and other inputs that can not be mapped are read to buffer.
+    const int buffSize = 1 << 16;
+    char buffer[buffSize];
+    ssize_t read;
+    while ((read = ::read(fd, buffer, buffSize)) > 0) {
+        input->buffer.insert(input->buffer.end(), buffer, buffer + read);
+    }
+    if (!isStdin) close(fd);
+    if (read < 0)
+        return 1;
+    input->data = input->buffer.data();
+    input->size = static_cast<long long>(input->buffer.size());
+    return 0;
+}
+
+void closeInput(Input* input) {
+    if (input->mapped) munmap(input->mapped, input->size);
+    input->mapped = NULL;
+    input->buffer.clear();
+}
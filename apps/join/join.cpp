@@ -0,0 +1,103 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <ctime>
+
+#include "edlib.h"
+#include "../common/readFasta.h"
+
+using namespace std;
+
+// Prints pairs as they are streamed from edlibSimilarityJoin().
+void printPairs(const EdlibJoinPair* pairs, int numPairs, void* context) {
+    long long* totalPairs = static_cast<long long*>(context);
+    for (int i = 0; i < numPairs; i++) {
+        printf("%d\t%d\t%d\n", pairs[i].a, pairs[i].b, pairs[i].editDistance);
+    }
+    *totalPairs += numPairs;
+}
+
+// Only counts pairs, used in silent mode.
+void countPairs(const EdlibJoinPair* pairs, int numPairs, void* context) {
+    (void) pairs;
+    *static_cast<long long*>(context) += numPairs;
+}
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    bool silent = false;
+    int option;
+    int kArg = 1;
+    int numThreads = 1;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "k:t:s")) >= 0) {
+        switch (option) {
+        case 'k': kArg = atoi(optarg); break;
+        case 't': numThreads = atoi(optarg); break;
+        case 's': silent = true; break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind + 1 > argc || optind + 2 < argc || invalidOption || kArg < 0 || numThreads < 0) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] <A.fasta> [<B.fasta>]\n", argv[0]);
+        fprintf(stderr, "Finds all pairs of sequences a from A and b from B with edit distance (NW) at most K,"
+                " and prints them as lines \"<index of a>\\t<index of b>\\t<edit distance>\","
+                " with sequences indexed from 0 in order in which they are in files."
+                " If B is not given, A is joined with itself.\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-s  If specified, pairs will only be counted, not printed (silent mode).\n");
+        fprintf(stderr, "\t-k K  Largest edit distance of pair, non-negative. [default: 1]\n");
+        fprintf(stderr, "\t-t T  Number of threads that candidate pairs are verified with,"
+                " 0 for number of hardware threads. [default: 1]\n");
+        return 1;
+    }
+    //-------------------------------------------------------------------------//
+
+    vector< vector<char> > sequences[2];
+    const int numFiles = argc - optind;
+    for (int f = 0; f < numFiles; f++) {
+        const char* filepath = argv[optind + f];
+        fprintf(stderr, "Reading %s...\n", filepath);
+        if (readFastaSequences(filepath, &sequences[f])) {
+            fprintf(stderr, "Error: There is no file with name %s\n", filepath);
+            return 1;
+        }
+        fprintf(stderr, "Read %d sequences.\n", static_cast<int>(sequences[f].size()));
+    }
+
+    vector<const char*> pointers[2];
+    vector<int> lengths[2];
+    for (int f = 0; f < numFiles; f++) {
+        for (const vector<char>& sequence : sequences[f]) {
+            pointers[f].push_back(sequence.data());
+            lengths[f].push_back(static_cast<int>(sequence.size()));
+        }
+    }
+    // Self join is given same arrays for both sets.
+    const int b = numFiles == 2 ? 1 : 0;
+
+    EdlibAlignConfig config = edlibDefaultAlignConfig();
+    config.k = kArg;
+    config.numThreads = numThreads == 0 ? EDLIB_ALL_THREADS : numThreads;
+    long long totalPairs = 0;
+    clock_t start = clock();
+    const int status = edlibSimilarityJoin(pointers[0].data(), lengths[0].data(),
+                                           static_cast<int>(pointers[0].size()),
+                                           pointers[b].data(), lengths[b].data(),
+                                           static_cast<int>(pointers[b].size()),
+                                           config, silent ? countPairs : printPairs, &totalPairs);
+    clock_t finish = clock();
+    if (status != EDLIB_STATUS_OK) {
+        fprintf(stderr, "Error: Join failed!\n");
+        return 1;
+    }
+    fprintf(stderr, "Found %lld pairs.\n", totalPairs);
+    fprintf(stderr, "Cpu time of join: %lf\n", static_cast<double>(finish - start) / CLOCKS_PER_SEC);
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "edlib.h"
+#include "edlibClient.h"
+#include "../common/readFasta.h"
+
+using namespace std;
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    int k = -1;
+    const char* modeArg = "HW";
+    const char* taskArg = "loc";
+    const char* referenceName = NULL;
+    bool listReferences = false;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "k:m:p:r:l")) >= 0) {
+        switch (option) {
+        case 'k': k = atoi(optarg); break;
+        case 'm': modeArg = optarg; break;
+        case 'p': taskArg = optarg; break;
+        case 'r': referenceName = optarg; break;
+        case 'l': listReferences = true; break;
+        default: invalidOption = true;
+        }
+    }
+    EdlibAlignMode mode = EDLIB_MODE_HW;
+    if (!strcmp(modeArg, "NW")) mode = EDLIB_MODE_NW;
+    else if (!strcmp(modeArg, "SHW")) mode = EDLIB_MODE_SHW;
+    else if (strcmp(modeArg, "HW")) invalidOption = true;
+    EdlibAlignTask task = EDLIB_TASK_LOC;
+    if (!strcmp(taskArg, "distance")) task = EDLIB_TASK_DISTANCE;
+    else if (!strcmp(taskArg, "path")) task = EDLIB_TASK_PATH;
+    else if (strcmp(taskArg, "loc")) invalidOption = true;
+    if (optind + 1 > argc || (optind + 2 > argc && !listReferences) || optind + 2 < argc || invalidOption) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] <socket> <queries.fasta>\n", argv[0]);
+        fprintf(stderr, "Aligns queries to reference loaded by edlib-server that listens on socket, and prints"
+                " line \"<query index>\\t<edit distance>\\t<start>\\t<end>\" for each query"
+                " (followed by \"\\t<cigar>\" if path is found), with zero-based start and end"
+                " of first optimal alignment (both inclusive, -1 if not found).\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-r NAME  Name of reference that queries are aligned to. [default: first reference]\n");
+        fprintf(stderr, "\t-m HW|NW|SHW  Alignment mode. [default: HW]\n");
+        fprintf(stderr, "\t-k K  Largest edit distance, -1 for no limit. [default: -1]\n");
+        fprintf(stderr, "\t-p distance|loc|path  What to find. [default: loc]\n");
+        fprintf(stderr, "\t-l  If specified, references of server are listed and queries are not needed.\n");
+        return 1;
+    }
+    //-------------------------------------------------------------------------//
+
+    EdlibClient* client = edlibClientConnect(argv[optind]);
+    if (client == NULL) {
+        fprintf(stderr, "Error: Can not connect to server at %s\n", argv[optind]);
+        return 1;
+    }
+    if (listReferences) {
+        for (int r = 0; r < edlibClientNumReferences(client); r++) {
+            printf("%d\t%s\t%d\n", r, edlibClientReferenceName(client, r), edlibClientReferenceLength(client, r));
+        }
+        edlibClientClose(client);
+        return 0;
+    }
+    const int reference = referenceName ? edlibClientFindReference(client, referenceName) : 0;
+    if (reference < 0 || reference >= edlibClientNumReferences(client)) {
+        fprintf(stderr, "Error: Server has no such reference\n");
+        edlibClientClose(client);
+        return 1;
+    }
+
+    vector< vector<char> > queries;
+    if (readFastaSequences(argv[optind + 1], &queries)) {
+        fprintf(stderr, "Error: There is no file with name %s\n", argv[optind + 1]);
+        edlibClientClose(client);
+        return 1;
+    }
+    vector<const char*> queryPointers;
+    vector<int> queryLengths;
+    for (const vector<char>& query : queries) {
+        queryPointers.push_back(query.data());
+        queryLengths.push_back(static_cast<int>(query.size()));
+    }
+
+    const int numQueries = static_cast<int>(queries.size());
+    vector<EdlibAlignResult> results(numQueries);
+    const auto start = chrono::steady_clock::now();
+    const int status = edlibClientAlign(client, reference, queryPointers.data(), queryLengths.data(), numQueries,
+                                        edlibNewAlignConfig(k, mode, task, NULL, 0), results.data());
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    edlibClientClose(client);
+    if (status != EDLIB_STATUS_OK) {
+        fprintf(stderr, "Error: Connection to server failed\n");
+        return 1;
+    }
+
+    for (int i = 0; i < numQueries; i++) {
+        const EdlibAlignResult& result = results[i];
+        if (result.status != EDLIB_STATUS_OK) {
+            printf("%d\terror\n", i);
+            continue;
+        }
+        printf("%d\t%d\t%d\t%d", i, result.editDistance,
+               result.startLocations ? result.startLocations[0] : -1,
+               result.endLocations ? result.endLocations[0] : -1);
+        if (result.alignment) {
+            char* cigar = edlibAlignmentToCigar(result.alignment, result.alignmentLength, EDLIB_CIGAR_EXTENDED);
+            printf("\t%s", cigar);
+            free(cigar);
+        }
+        printf("\n");
+        edlibFreeAlignResult(results[i]);
+    }
+    fprintf(stderr, "Aligned %d queries in %lf seconds.\n", numQueries, seconds);
+    return 0;
+}
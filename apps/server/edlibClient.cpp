@@ -0,0 +1,225 @@
+#include "edlibClient.h"
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <string>
+
+#include "protocol.h"
+
+using namespace std;
+
+struct EdlibClient {
+    int fd;
+    uint32_t nextRequestId;
+    vector<string> referenceNames;
+    vector<int> referenceLengths;
+};
+
+/**
+ * @return Number of bytes of response, including its header.
+ */
+static size_t responseSize(const EdlibResponseHeader& header) {
+    return sizeof(header) + sizeof(int32_t) * header.numLocations * (header.hasStartLocations ? 2 : 1)
+        + (header.hasAlignment ? header.alignmentLength : 0);
+}
+
+/**
+ * @return Copy of bytes as newly allocated array, the same as edlib allocates arrays of results.
+ */
+template <class T>
+static T* copyArray(const char* bytes, int numValues) {
+    T* values = static_cast<T*>(malloc(sizeof(T) * numValues));
+    memcpy(values, bytes, sizeof(T) * numValues);
+    return values;
+}
+
+static EdlibAlignResult parseAlignResponse(const char* response) {
+    EdlibResponseHeader header;
+    memcpy(&header, response, sizeof(header));
+    const char* data = response + sizeof(header);
+    EdlibAlignResult result;
+    result.status = header.status;
+    result.editDistance = header.editDistance;
+    result.alphabetLength = header.alphabetLength;
+    result.numLocations = header.numLocations;
+    result.endLocations = result.startLocations = NULL;
+    result.alignment = NULL;
+    result.alignmentLength = 0;
+    if (header.numLocations > 0) {
+        result.endLocations = copyArray<int>(data, header.numLocations);
+        data += sizeof(int32_t) * header.numLocations;
+    }
+    if (header.hasStartLocations) {
+        result.startLocations = copyArray<int>(data, header.numLocations);
+        data += sizeof(int32_t) * header.numLocations;
+    }
+    if (header.hasAlignment) {
+        result.alignment = copyArray<unsigned char>(data, header.alignmentLength);
+        result.alignmentLength = header.alignmentLength;
+    }
+    return result;
+}
+
+/**
+ * Sends requests and receives responses at the same time, so that neither client nor server
+ * block on full socket buffer.
+ * @param [in] requests  Bytes of all requests.
+ * @param [in] numResponses  Number of responses to wait for.
+ * @param [in] onResponse  Called for each received response.
+ * @return False if connection failed.
+ */
+template <class OnResponse>
+static bool exchange(EdlibClient* client, const vector<char>& requests, int numResponses, OnResponse onResponse) {
+    size_t sent = 0;
+    vector<char> received;  // Received bytes that do not form whole response yet.
+    const int BUFFER_SIZE = 1 << 16;
+    vector<char> buffer(BUFFER_SIZE);
+    while (numResponses > 0) {
+        pollfd pollFd;
+        pollFd.fd = client->fd;
+        pollFd.events = POLLIN | (sent < requests.size() ? POLLOUT : 0);
+        if (poll(&pollFd, 1, -1) < 0) return false;
+        if ((pollFd.revents & POLLOUT) && sent < requests.size()) {
+            const ssize_t written = send(client->fd, requests.data() + sent, requests.size() - sent,
+                                         MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            if (written > 0) sent += written;
+        }
+        if (pollFd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            const ssize_t numReceived = recv(client->fd, buffer.data(), BUFFER_SIZE, MSG_DONTWAIT);
+            if (numReceived == 0 || (numReceived < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) return false;
+            if (numReceived > 0) received.insert(received.end(), buffer.data(), buffer.data() + numReceived);
+            // Whole responses are handled in place, the rest is kept for next time.
+            size_t parsed = 0;
+            while (numResponses > 0 && received.size() - parsed >= sizeof(EdlibResponseHeader)) {
+                EdlibResponseHeader header;
+                memcpy(&header, received.data() + parsed, sizeof(header));
+                if (header.magic != EDLIB_SERVER_MAGIC) return false;
+                if (received.size() - parsed < responseSize(header)) break;
+                onResponse(header, received.data() + parsed);
+                parsed += responseSize(header);
+                numResponses--;
+            }
+            received.erase(received.begin(), received.begin() + parsed);
+        }
+    }
+    return true;
+}
+
+static EdlibRequestHeader newRequestHeader(EdlibClient* client, EdlibRequestType type) {
+    EdlibRequestHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = EDLIB_SERVER_MAGIC;
+    header.requestId = client->nextRequestId++;
+    header.type = type;
+    return header;
+}
+
+extern "C" EdlibClient* edlibClientConnect(const char* socketPath) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) return NULL;
+    strcpy(address.sun_path, socketPath);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return NULL;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return NULL;
+    }
+    EdlibClient* client = new EdlibClient();
+    client->fd = fd;
+    client->nextRequestId = 0;
+
+    const EdlibRequestHeader header = newRequestHeader(client, EDLIB_REQUEST_REFERENCES);
+    vector<char> request(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header + 1));
+    const bool ok = exchange(client, request, 1, [client](const EdlibResponseHeader& response, const char* bytes) {
+        const char* data = bytes + sizeof(response);
+        for (int i = 0; i < response.numLocations; i++) {
+            int32_t lengths[2];
+            memcpy(lengths, data, sizeof(lengths));
+            data += sizeof(lengths);
+            client->referenceLengths.push_back(lengths[0]);
+            client->referenceNames.push_back(string(data, lengths[1]));
+            data += lengths[1];
+        }
+    });
+    if (!ok) {
+        edlibClientClose(client);
+        return NULL;
+    }
+    return client;
+}
+
+extern "C" int edlibClientNumReferences(const EdlibClient* client) {
+    return static_cast<int>(client->referenceNames.size());
+}
+
+extern "C" const char* edlibClientReferenceName(const EdlibClient* client, int reference) {
+    return client->referenceNames[reference].c_str();
+}
+
+extern "C" int edlibClientReferenceLength(const EdlibClient* client, int reference) {
+    return client->referenceLengths[reference];
+}
+
+extern "C" int edlibClientFindReference(const EdlibClient* client, const char* name) {
+    for (int i = 0; i < static_cast<int>(client->referenceNames.size()); i++) {
+        if (client->referenceNames[i] == name) return i;
+    }
+    return -1;
+}
+
+extern "C" int edlibClientAlign(EdlibClient* client, int reference,
+                                const char* const* queries, const int* queryLengths, int numQueries,
+                                const EdlibAlignConfig config, EdlibAlignResult* results) {
+    if (numQueries < 0 || config.equalitySet != NULL
+        || (config.additionalEqualities != NULL && config.additionalEqualitiesLength > 0)) {
+        return EDLIB_STATUS_ERROR;
+    }
+    for (int i = 0; i < numQueries; i++) {
+        if (queryLengths[i] < 0) return EDLIB_STATUS_ERROR;
+    }
+
+    vector<char> requests;
+    const uint32_t firstRequestId = client->nextRequestId;
+    for (int i = 0; i < numQueries; i++) {
+        EdlibRequestHeader header = newRequestHeader(client, EDLIB_REQUEST_ALIGN);
+        header.reference = reference;
+        header.k = config.k;
+        header.mode = config.mode;
+        header.task = config.task;
+        header.equalityPresets = config.equalityPresets;
+        header.queryLength = queryLengths[i];
+        requests.insert(requests.end(), reinterpret_cast<const char*>(&header),
+                        reinterpret_cast<const char*>(&header + 1));
+        requests.insert(requests.end(), queries[i], queries[i] + queryLengths[i]);
+    }
+    vector<char> answered(numQueries, 0);
+    const bool ok = exchange(client, requests, numQueries,
+                             [&](const EdlibResponseHeader& header, const char* response) {
+        const uint32_t i = header.requestId - firstRequestId;
+        if (i < static_cast<uint32_t>(numQueries) && !answered[i]) {
+            results[i] = parseAlignResponse(response);
+            answered[i] = 1;
+        }
+    });
+    if (!ok) {
+        for (int i = 0; i < numQueries; i++) {
+            if (answered[i]) edlibFreeAlignResult(results[i]);
+        }
+        return EDLIB_STATUS_ERROR;
+    }
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" void edlibClientClose(EdlibClient* client) {
+    close(client->fd);
+    delete client;
+}
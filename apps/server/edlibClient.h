@@ -0,0 +1,79 @@
+#ifndef EDLIB_CLIENT_H
+#define EDLIB_CLIENT_H
+
+/**
+ * @file
+ * @brief Client of edlib-server: queries are aligned by server to references that it has already loaded,
+ * so short-lived processes do not have to load references themselves.
+ */
+
+#include "edlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+     * @brief Connection to edlib-server.
+     */
+    typedef struct EdlibClient EdlibClient;
+
+    /**
+     * Connects to server and gets list of its references.
+     * @param [in] socketPath  Path of Unix domain socket that server listens on.
+     * @return Client, or NULL if server could not be reached. Close it with edlibClientClose().
+     */
+    EdlibClient* edlibClientConnect(const char* socketPath);
+
+    /**
+     * @return Number of references that server has loaded.
+     */
+    int edlibClientNumReferences(const EdlibClient* client);
+
+    /**
+     * @return Name of reference (first word of its FASTA header).
+     */
+    const char* edlibClientReferenceName(const EdlibClient* client, int reference);
+
+    /**
+     * @return Length of reference.
+     */
+    int edlibClientReferenceLength(const EdlibClient* client, int reference);
+
+    /**
+     * @return Index of first reference with given name, or -1 if there is none.
+     */
+    int edlibClientFindReference(const EdlibClient* client, const char* name);
+
+    /**
+     * Aligns each of queries to reference on server, with the same result as edlibAlign() would give.
+     * All requests are sent without waiting for responses (while responses are already read), so that
+     * server can align them in batches together with requests of other clients.
+     * @param [in] client
+     * @param [in] reference  Index of reference that queries are aligned to (as target).
+     * @param [in] queries  Array of queries.
+     * @param [in] queryLengths  queryLengths[i] is number of characters in queries[i].
+     * @param [in] numQueries  Number of queries.
+     * @param [in] config  Only k, mode, task and equalityPresets are used, additional equalities and
+     *                     equality set can not be sent to server.
+     * @param [out] results  Array of numQueries results, results[i] is set to result of aligning queries[i].
+     *                       Make sure to clean up each of them using edlibFreeAlignResult().
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if config has additional equalities or equality set,
+     *         some length is negative or connection to server failed (then results are not set).
+     *         If server finds request invalid (e.g. because reference does not exist), status of its result
+     *         is EDLIB_STATUS_ERROR.
+     */
+    int edlibClientAlign(EdlibClient* client, int reference,
+                         const char* const* queries, const int* queryLengths, int numQueries,
+                         const EdlibAlignConfig config, EdlibAlignResult* results);
+
+    /**
+     * Closes connection and frees client.
+     */
+    void edlibClientClose(EdlibClient* client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EDLIB_CLIENT_H
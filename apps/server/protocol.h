@@ -0,0 +1,51 @@
+#ifndef EDLIB_SERVER_PROTOCOL_H
+#define EDLIB_SERVER_PROTOCOL_H
+
+/**
+ * Binary protocol of edlib-server, spoken over Unix domain socket.
+ * Server and clients run on the same machine, so all numbers are in native byte order.
+ *
+ * Client sends requests, each is RequestHeader followed by queryLength characters of query.
+ * Server answers each request with response, which is ResponseHeader followed by:
+ *  - for EDLIB_REQUEST_ALIGN: numLocations end locations, numLocations start locations if they were found
+ *    (int32_t each), and alignmentLength bytes of alignment if it was found.
+ *  - for EDLIB_REQUEST_REFERENCES: numLocations references, each as int32_t length of reference,
+ *    int32_t length of its name and characters of name.
+ * Client may send many requests before reading responses, and responses of different requests may come
+ * in different order than requests did, so they are matched by requestId.
+ */
+
+#include <stdint.h>
+
+#define EDLIB_SERVER_MAGIC 0x45444c42u  // "EDLB"
+
+typedef enum {
+    EDLIB_REQUEST_ALIGN = 0,  // Align query to reference.
+    EDLIB_REQUEST_REFERENCES = 1  // List loaded references.
+} EdlibRequestType;
+
+typedef struct {
+    uint32_t magic;  // EDLIB_SERVER_MAGIC.
+    uint32_t requestId;  // Chosen by client, it is copied to response.
+    int32_t type;  // EdlibRequestType.
+    int32_t reference;  // Index of reference that query is aligned to.
+    int32_t k;
+    int32_t mode;  // EdlibAlignMode.
+    int32_t task;  // EdlibAlignTask.
+    int32_t equalityPresets;
+    int32_t queryLength;
+} EdlibRequestHeader;
+
+typedef struct {
+    uint32_t magic;  // EDLIB_SERVER_MAGIC.
+    uint32_t requestId;
+    int32_t status;  // EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if request was invalid.
+    int32_t editDistance;
+    int32_t alphabetLength;
+    int32_t numLocations;  // Number of locations, or of references for EDLIB_REQUEST_REFERENCES.
+    int32_t hasStartLocations;  // 1 if start locations follow end locations, 0 otherwise.
+    int32_t hasAlignment;  // 1 if alignment follows locations, 0 otherwise.
+    int32_t alignmentLength;
+} EdlibResponseHeader;
+
+#endif // EDLIB_SERVER_PROTOCOL_H
@@ -0,0 +1,470 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <tuple>
+#include <cerrno>
+
+#include "edlib.h"
+#include "protocol.h"
+#include "../common/readFasta.h"
+
+using namespace std;
+
+// Longest query that is accepted, longer one is treated as broken request.
+static const int MAX_QUERY_LENGTH = 1 << 30;
+
+// While client has more bytes of responses waiting than this, no more of its requests are read.
+static const size_t MAX_PENDING_OUTPUT = 1 << 24;
+
+struct Reference {
+    string name;
+    vector<char> sequence;
+};
+
+// Connection of one client. It is owned by server loop and by requests of client that are not answered yet,
+// so that socket is closed only once all of them are done.
+// Socket is non-blocking: workers only queue responses, and server loop sends them when client takes them,
+// so that client which does not read its responses holds up nobody but itself.
+struct Connection {
+    int fd;
+    vector<char> received;  // Received bytes that do not form whole request yet.
+    bool readOpen;  // False once client stopped sending, its responses are still sent.
+    atomic<int> numUnanswered;  // Requests that were received but whose responses are not queued yet.
+
+    explicit Connection(int socketFd) : fd(socketFd), readOpen(true), numUnanswered(0), numSent(0) {}
+
+    ~Connection() {
+        close(fd);
+    }
+
+    void queueOutput(const vector<char>& bytes) {
+        lock_guard<mutex> lock(outputMutex);
+        output.insert(output.end(), bytes.begin(), bytes.end());
+    }
+
+    size_t pendingOutput() {
+        lock_guard<mutex> lock(outputMutex);
+        return output.size() - numSent;
+    }
+
+    /**
+     * Sends as much of queued output as socket takes without blocking.
+     * @return False if client went away.
+     */
+    bool flush() {
+        lock_guard<mutex> lock(outputMutex);
+        while (numSent < output.size()) {
+            const ssize_t written = send(fd, output.data() + numSent, output.size() - numSent, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+                // Sent bytes are dropped once they are at least half of output, so each byte is moved O(1) times.
+                if (numSent * 2 >= output.size()) {
+                    output.erase(output.begin(), output.begin() + numSent);
+                    numSent = 0;
+                }
+                return true;
+            }
+            numSent += written;
+        }
+        output.clear();
+        numSent = 0;
+        return true;
+    }
+
+private:
+    mutex outputMutex;  // Responses are queued by workers.
+    vector<char> output;  // Queued responses, first numSent bytes of them are already sent.
+    size_t numSent;
+};
+
+struct Request {
+    shared_ptr<Connection> connection;
+    EdlibRequestHeader header;
+    vector<char> query;
+};
+
+/**
+ * Requests from all connections wait here, workers take all waiting requests at once (up to batch size),
+ * so concurrent requests are aligned together.
+ */
+class RequestQueue {
+public:
+    RequestQueue() : stopped(false) {}
+
+    void push(vector<Request>* newRequests) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            for (Request& request : *newRequests) requests.push_back(move(request));
+        }
+        newRequests->clear();
+        nonEmpty.notify_all();
+    }
+
+    /**
+     * Waits for requests and takes at most maxBatch of them.
+     * @return False if queue was stopped and there are no more requests.
+     */
+    bool pop(int maxBatch, vector<Request>* batch) {
+        unique_lock<mutex> lock(queueMutex);
+        nonEmpty.wait(lock, [this]() { return stopped || !requests.empty(); });
+        if (requests.empty()) return false;
+        const int batchSize = min(maxBatch, static_cast<int>(requests.size()));
+        for (int i = 0; i < batchSize; i++) {
+            batch->push_back(move(requests.front()));
+            requests.pop_front();
+        }
+        return true;
+    }
+
+    void stop() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopped = true;
+        }
+        nonEmpty.notify_all();
+    }
+
+private:
+    mutex queueMutex;
+    condition_variable nonEmpty;
+    deque<Request> requests;
+    bool stopped;
+};
+
+template <class T>
+void append(vector<char>* buffer, const T* values, int numValues) {
+    const char* bytes = reinterpret_cast<const char*>(values);
+    buffer->insert(buffer->end(), bytes, bytes + sizeof(T) * numValues);
+}
+
+/**
+ * @return Response header for given request, with all counts set to zero.
+ */
+EdlibResponseHeader newResponseHeader(const Request& request, int status) {
+    EdlibResponseHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = EDLIB_SERVER_MAGIC;
+    header.requestId = request.header.requestId;
+    header.status = status;
+    header.editDistance = -1;
+    return header;
+}
+
+void appendAlignResponse(const Request& request, const EdlibAlignResult& result, vector<char>* buffer) {
+    EdlibResponseHeader header = newResponseHeader(request, result.status);
+    header.editDistance = result.editDistance;
+    header.alphabetLength = result.alphabetLength;
+    header.numLocations = result.endLocations ? result.numLocations : 0;
+    header.hasStartLocations = result.startLocations != NULL;
+    header.hasAlignment = result.alignment != NULL;
+    header.alignmentLength = result.alignment ? result.alignmentLength : 0;
+    append(buffer, &header, 1);
+    append(buffer, result.endLocations, header.numLocations);
+    if (header.hasStartLocations) append(buffer, result.startLocations, header.numLocations);
+    if (header.hasAlignment) append(buffer, result.alignment, header.alignmentLength);
+}
+
+void appendReferencesResponse(const Request& request, const vector<Reference>& references, vector<char>* buffer) {
+    EdlibResponseHeader header = newResponseHeader(request, EDLIB_STATUS_OK);
+    header.numLocations = static_cast<int32_t>(references.size());
+    append(buffer, &header, 1);
+    for (const Reference& reference : references) {
+        const int32_t lengths[2] = {static_cast<int32_t>(reference.sequence.size()),
+                                    static_cast<int32_t>(reference.name.size())};
+        append(buffer, lengths, 2);
+        append(buffer, reference.name.data(), static_cast<int>(reference.name.size()));
+    }
+}
+
+/**
+ * Aligns batch of requests and writes responses. Align requests with the same reference and parameters
+ * are aligned together with edlibAlignQueries(), which computes columns of reference once for prefixes
+ * that queries share. Responses are collected per connection and queued at once, then server loop
+ * is woken up through wakeFd to send them.
+ */
+void processBatch(const vector<Reference>& references, vector<Request>& batch, int wakeFd) {
+    const auto isValid = [&references](const EdlibRequestHeader& header) {
+        return header.type == EDLIB_REQUEST_REFERENCES
+            || (header.type == EDLIB_REQUEST_ALIGN
+                && header.reference >= 0 && header.reference < static_cast<int>(references.size())
+                && header.mode >= EDLIB_MODE_NW && header.mode <= EDLIB_MODE_HW
+                && header.task >= EDLIB_TASK_DISTANCE && header.task <= EDLIB_TASK_PATH);
+    };
+    // Align requests are grouped by reference and parameters.
+    vector<int> order;
+    for (int i = 0; i < static_cast<int>(batch.size()); i++) {
+        if (isValid(batch[i].header) && batch[i].header.type == EDLIB_REQUEST_ALIGN) order.push_back(i);
+    }
+    const auto groupKey = [&batch](int i) {
+        const EdlibRequestHeader& h = batch[i].header;
+        return make_tuple(h.reference, h.mode, h.task, h.k, h.equalityPresets);
+    };
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return groupKey(a) < groupKey(b); });
+
+    vector<EdlibAlignResult> results(batch.size());
+    vector<const char*> queries;
+    vector<int> queryLengths;
+    vector<EdlibAlignResult> groupResults;
+    for (size_t groupStart = 0; groupStart < order.size(); ) {
+        size_t groupEnd = groupStart + 1;
+        while (groupEnd < order.size() && groupKey(order[groupEnd]) == groupKey(order[groupStart])) groupEnd++;
+        const EdlibRequestHeader& header = batch[order[groupStart]].header;
+        EdlibAlignConfig config = edlibNewAlignConfig(header.k, static_cast<EdlibAlignMode>(header.mode),
+                                                      static_cast<EdlibAlignTask>(header.task), NULL, 0);
+        config.equalityPresets = header.equalityPresets;
+        const Reference& reference = references[header.reference];
+        queries.clear();
+        queryLengths.clear();
+        for (size_t j = groupStart; j < groupEnd; j++) {
+            queries.push_back(batch[order[j]].query.data());
+            queryLengths.push_back(static_cast<int>(batch[order[j]].query.size()));
+        }
+        groupResults.resize(queries.size());
+        edlibAlignQueries(queries.data(), queryLengths.data(), static_cast<int>(queries.size()),
+                          reference.sequence.data(), static_cast<int>(reference.sequence.size()),
+                          config, groupResults.data());
+        for (size_t j = groupStart; j < groupEnd; j++) results[order[j]] = groupResults[j - groupStart];
+        groupStart = groupEnd;
+    }
+
+    // Responses are written in order of requests, one write per connection.
+    unordered_map<Connection*, vector<char> > responses;
+    for (int i = 0; i < static_cast<int>(batch.size()); i++) {
+        const Request& request = batch[i];
+        vector<char>& buffer = responses[request.connection.get()];
+        if (!isValid(request.header)) {
+            const EdlibResponseHeader header = newResponseHeader(request, EDLIB_STATUS_ERROR);
+            append(&buffer, &header, 1);
+        } else if (request.header.type == EDLIB_REQUEST_REFERENCES) {
+            appendReferencesResponse(request, references, &buffer);
+        } else {
+            appendAlignResponse(request, results[i], &buffer);
+            edlibFreeAlignResult(results[i]);
+        }
+    }
+    for (const Request& request : batch) {
+        auto it = responses.find(request.connection.get());
+        if (it == responses.end()) continue;
+        request.connection->queueOutput(it->second);
+        responses.erase(it);
+    }
+    // Only after responses are queued, so that server loop does not close connection before sending them.
+    for (const Request& request : batch) request.connection->numUnanswered--;
+    const char wake = 0;
+    if (write(wakeFd, &wake, 1) < 0) {
+        // Pipe is full, so server loop is going to wake up anyway.
+    }
+}
+
+/**
+ * Splits received bytes of connection into requests.
+ * @return False if connection sent something that is not a request.
+ */
+bool parseRequests(const shared_ptr<Connection>& connection, vector<Request>* requests) {
+    vector<char>& received = connection->received;
+    size_t parsed = 0;
+    while (received.size() - parsed >= sizeof(EdlibRequestHeader)) {
+        Request request;
+        memcpy(&request.header, received.data() + parsed, sizeof(EdlibRequestHeader));
+        if (request.header.magic != EDLIB_SERVER_MAGIC
+            || request.header.queryLength < 0 || request.header.queryLength > MAX_QUERY_LENGTH) {
+            return false;
+        }
+        const size_t requestSize = sizeof(EdlibRequestHeader) + request.header.queryLength;
+        if (received.size() - parsed < requestSize) break;
+        const char* query = received.data() + parsed + sizeof(EdlibRequestHeader);
+        request.query.assign(query, query + request.header.queryLength);
+        request.connection = connection;
+        connection->numUnanswered++;
+        requests->push_back(move(request));
+        parsed += requestSize;
+    }
+    received.erase(received.begin(), received.begin() + parsed);
+    return true;
+}
+
+static volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    int numThreads = 0;
+    int maxBatch = 256;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "t:b:")) >= 0) {
+        switch (option) {
+        case 't': numThreads = atoi(optarg); break;
+        case 'b': maxBatch = atoi(optarg); break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind + 2 > argc || invalidOption || numThreads < 0 || maxBatch <= 0) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] <socket> <references.fasta>...\n", argv[0]);
+        fprintf(stderr, "Loads references once and aligns queries to them for clients that connect to"
+                " Unix domain socket (see apps/server/protocol.h and apps/server/edlibClient.h),"
+                " until it is stopped with SIGINT or SIGTERM.\n"
+                "References are indexed from 0 in order in which they are in files."
+                " Requests that arrive at the same time are aligned together in batches.\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-t T  Number of worker threads, 0 for number of hardware threads. [default: 0]\n");
+        fprintf(stderr, "\t-b B  Largest number of requests in one batch. [default: 256]\n");
+        return 1;
+    }
+    //-------------------------------------------------------------------------//
+
+    if (numThreads == 0) numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    const char* socketPath = argv[optind];
+    vector<Reference> references;
+    for (int i = optind + 1; i < argc; i++) {
+        vector< vector<char> > sequences;
+        vector<string> names;
+        if (readFastaSequences(argv[i], &sequences, &names)) {
+            fprintf(stderr, "Error: There is no file with name %s\n", argv[i]);
+            return 1;
+        }
+        for (size_t r = 0; r < sequences.size(); r++) {
+            references.push_back(Reference());
+            references.back().name.swap(names[r]);
+            references.back().sequence.swap(sequences[r]);
+        }
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path %s is too long\n", socketPath);
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath);
+    const int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath);
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listenFd, 64) < 0) {
+        fprintf(stderr, "Error: Can not listen on %s: %s\n", socketPath, strerror(errno));
+        return 1;
+    }
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    fprintf(stderr, "Listening on %s with %d references.\n", socketPath, static_cast<int>(references.size()));
+
+    // Workers write to this pipe when they queue responses, to wake up server loop from poll.
+    int wakeFds[2];
+    if (pipe(wakeFds) < 0 || fcntl(wakeFds[0], F_SETFL, O_NONBLOCK) < 0
+        || fcntl(wakeFds[1], F_SETFL, O_NONBLOCK) < 0) {
+        fprintf(stderr, "Error: Can not create pipe: %s\n", strerror(errno));
+        return 1;
+    }
+
+    RequestQueue queue;
+    vector<thread> workers;
+    for (int i = 0; i < numThreads; i++) {
+        workers.push_back(thread([&]() {
+            vector<Request> batch;
+            while (queue.pop(maxBatch, &batch)) {
+                processBatch(references, batch, wakeFds[1]);
+                batch.clear();
+            }
+        }));
+    }
+
+    // Requests are received and responses are sent by this thread, poll times out regularly
+    // so that stop request is noticed.
+    vector< shared_ptr<Connection> > connections;
+    vector<Request> newRequests;
+    const int BUFFER_SIZE = 1 << 16;
+    vector<char> buffer(BUFFER_SIZE);
+    while (!stopRequested) {
+        vector<pollfd> pollFds(2 + connections.size());
+        pollFds[0].fd = listenFd;
+        pollFds[0].events = POLLIN;
+        pollFds[1].fd = wakeFds[0];
+        pollFds[1].events = POLLIN;
+        for (size_t i = 0; i < connections.size(); i++) {
+            const size_t pendingOutput = connections[i]->pendingOutput();
+            pollFds[2 + i].fd = connections[i]->fd;
+            pollFds[2 + i].events = (connections[i]->readOpen && pendingOutput < MAX_PENDING_OUTPUT ? POLLIN : 0)
+                | (pendingOutput > 0 ? POLLOUT : 0);
+        }
+        if (poll(pollFds.data(), pollFds.size(), 200) <= 0) continue;
+        if (pollFds[1].revents & POLLIN) {
+            while (read(wakeFds[0], buffer.data(), BUFFER_SIZE) > 0) {}
+        }
+
+        vector< shared_ptr<Connection> > openConnections;
+        for (size_t i = 0; i < connections.size(); i++) {
+            Connection& connection = *connections[i];
+            const short revents = pollFds[2 + i].revents;
+            bool open = true;
+            if (revents & POLLIN) {
+                const ssize_t received = recv(connection.fd, buffer.data(), BUFFER_SIZE, 0);
+                if (received == 0) {
+                    connection.readOpen = false;
+                } else if (received < 0) {
+                    open = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+                } else {
+                    connection.received.insert(connection.received.end(), buffer.data(), buffer.data() + received);
+                    open = parseRequests(connections[i], &newRequests);
+                }
+            }
+            if (open && (revents & POLLOUT)) open = connection.flush();
+            // Client that hung up can not get its responses, and client that stopped sending is done
+            // once it got all of them.
+            if (revents & (POLLHUP | POLLERR)) open = false;
+            if (open && !connection.readOpen) {
+                open = connection.numUnanswered > 0 || connection.pendingOutput() > 0;
+            }
+            if (open) {
+                openConnections.push_back(connections[i]);
+            } else {
+                shutdown(connection.fd, SHUT_RDWR);
+            }
+        }
+        connections.swap(openConnections);
+        if (pollFds[0].revents & POLLIN) {
+            const int fd = accept(listenFd, NULL, NULL);
+            if (fd >= 0) {
+                if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+                    close(fd);
+                } else {
+                    connections.push_back(make_shared<Connection>(fd));
+                }
+            }
+        }
+        if (!newRequests.empty()) queue.push(&newRequests);
+    }
+
+    fprintf(stderr, "Stopping.\n");
+    queue.stop();
+    for (thread& worker : workers) worker.join();
+    connections.clear();
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    close(listenFd);
+    unlink(socketPath);
+    return 0;
+}
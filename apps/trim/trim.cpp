@@ -0,0 +1,243 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+
+#include "edlib.h"
+#include "../common/runTasks.h"
+
+using namespace std;
+
+// Read from FASTQ or FASTA file.
+struct Record {
+    string header;  // Header line without leading '@' or '>'.
+    string sequence;
+    string quality;  // Empty for FASTA.
+};
+
+// Reads records one by one, format is detected from first character of input.
+class RecordReader {
+public:
+    explicit RecordReader(FILE* input) : file(input), line(NULL), lineCapacity(0), lineLength(-1) {
+        nextLine();
+        fastq = lineLength > 0 && line[0] == '@';
+    }
+
+    ~RecordReader() {
+        free(line);
+    }
+
+    bool isFastq() const {
+        return fastq;
+    }
+
+    /**
+     * @return False if there are no more records.
+     */
+    bool read(Record* record) {
+        while (lineLength == 0) nextLine();  // Empty lines between records are skipped.
+        if (lineLength < 0) return false;
+        record->header.assign(line + 1, lineLength - 1);
+        record->sequence.clear();
+        record->quality.clear();
+        if (fastq) {
+            nextLine();
+            record->sequence.assign(line, lineLength > 0 ? lineLength : 0);
+            nextLine();  // Separator line.
+            nextLine();
+            record->quality.assign(line, lineLength > 0 ? lineLength : 0);
+            nextLine();
+        } else {
+            // Sequence of FASTA record can span multiple lines.
+            for (nextLine(); lineLength >= 0 && (lineLength == 0 || line[0] != '>'); nextLine()) {
+                record->sequence.append(line, lineLength);
+            }
+        }
+        return true;
+    }
+
+private:
+    FILE* file;
+    char* line;
+    size_t lineCapacity;
+    ssize_t lineLength;  // Length of current line without line end, -1 at end of file.
+    bool fastq;
+
+    void nextLine() {
+        lineLength = getline(&line, &lineCapacity, file);
+        while (lineLength > 0 && (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) lineLength--;
+    }
+};
+
+int readAdapters(const char* path, vector<string>* names, vector<string>* adapters);
+
+int main(int argc, char * const argv[]) {
+
+    //----------------------------- PARSE COMMAND LINE ------------------------//
+    int option;
+    vector<string> adapterNames;
+    vector<string> adapters;
+    const char* adaptersPath = NULL;
+    const char* infoPath = NULL;
+    EdlibTrimConfig trimConfig = edlibDefaultTrimConfig();
+    int minLength = 0;
+    int numThreads = 1;
+
+    bool invalidOption = false;
+    while ((option = getopt(argc, argv, "a:A:5e:O:n:m:i:t:")) >= 0) {
+        switch (option) {
+        case 'a':
+            adapters.push_back(optarg);
+            adapterNames.push_back("adapter" + to_string(adapters.size()));
+            break;
+        case 'A': adaptersPath = optarg; break;
+        case '5': trimConfig.end = EDLIB_TRIM_START; break;
+        case 'e': trimConfig.maxErrorRate = atof(optarg); break;
+        case 'O': trimConfig.minOverlap = atoi(optarg); break;
+        case 'n': trimConfig.searchLength = atoi(optarg); break;
+        case 'm': minLength = atoi(optarg); break;
+        case 'i': infoPath = optarg; break;
+        case 't': numThreads = atoi(optarg); break;
+        default: invalidOption = true;
+        }
+    }
+    if (optind + 1 < argc || invalidOption || (adapters.empty() && adaptersPath == NULL)
+        || trimConfig.maxErrorRate < 0 || trimConfig.minOverlap < 0 || trimConfig.searchLength < -1) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: %s [options...] -a <adapter> [<reads.fastq>]\n", argv[0]);
+        fprintf(stderr, "Trims adapters (or primers) from 3' end of reads (or from 5' end with -5),"
+                " reading FASTQ or FASTA from file (or standard input if there is none, or file is -)"
+                " and writing trimmed reads in the same format to standard output, in order of input.\n"
+                "At 3' end, adapter is either whole in read, in which case it and everything after it is trimmed,"
+                " or its prefix is at end of read. Of all adapters, the one with most matched characters is"
+                " trimmed (then the one with least edits).\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "\t-a ADAPTER  Sequence of adapter, can be given multiple times.\n");
+        fprintf(stderr, "\t-A FILE  FASTA file with adapters, they are added to those given with -a.\n");
+        fprintf(stderr, "\t-5  If specified, adapters are trimmed from 5' end of reads instead of 3' end.\n");
+        fprintf(stderr, "\t-e E  Largest allowed number of edits per matched character of adapter."
+                " [default: 0.1]\n");
+        fprintf(stderr, "\t-O O  Smallest number of matched characters of adapter at end of read."
+                " [default: 3]\n");
+        fprintf(stderr, "\t-n N  Only N characters at trimmed end of read are searched, -1 for whole read."
+                " [default: -1]\n");
+        fprintf(stderr, "\t-m M  Reads shorter than M after trimming are discarded. [default: 0]\n");
+        fprintf(stderr, "\t-i FILE  For each trimmed read, line \"<read name>\\t<adapter name>\\t<start>\\t<end>"
+                "\\t<edit distance>\" is written to FILE, with zero-based start and end"
+                " (end is position after adapter).\n");
+        fprintf(stderr, "\t-t T  Number of threads, 0 for number of hardware threads. [default: 1]\n");
+        return 1;
+    }
+    //-------------------------------------------------------------------------//
+
+    if (numThreads <= 0) numThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    if (adaptersPath && readAdapters(adaptersPath, &adapterNames, &adapters)) {
+        fprintf(stderr, "Error: There is no file with name %s\n", adaptersPath);
+        return 1;
+    }
+    vector<const char*> adapterPointers;
+    vector<int> adapterLengths;
+    for (const string& adapter : adapters) {
+        adapterPointers.push_back(adapter.data());
+        adapterLengths.push_back(static_cast<int>(adapter.size()));
+    }
+    EdlibAdapterPanel* panel = edlibNewAdapterPanel(adapterPointers.data(), adapterLengths.data(),
+                                                    static_cast<int>(adapters.size()), trimConfig,
+                                                    edlibDefaultAlignConfig());
+
+    const bool isStdin = optind == argc || !strcmp(argv[optind], "-");
+    FILE* input = isStdin ? stdin : fopen(argv[optind], "r");
+    if (input == NULL) {
+        fprintf(stderr, "Error: There is no file with name %s\n", argv[optind]);
+        edlibFreeAdapterPanel(panel);
+        return 1;
+    }
+    FILE* info = NULL;
+    if (infoPath && (info = fopen(infoPath, "w")) == NULL) {
+        fprintf(stderr, "Error: Can not write %s\n", infoPath);
+        edlibFreeAdapterPanel(panel);
+        return 1;
+    }
+
+    // Reads are trimmed in batches: each batch is read, trimmed in parallel and written in order.
+    RecordReader reader(input);
+    const int BATCH_SIZE = 1 << 14;
+    const int TASK_SIZE = 256;
+    vector<Record> batch(BATCH_SIZE);
+    vector<EdlibTrimResult> results(BATCH_SIZE);
+    long long numReads = 0, numTrimmed = 0, numDiscarded = 0;
+    vector<long long> adapterCounts(adapters.size(), 0);
+    while (true) {
+        int batchSize = 0;
+        while (batchSize < BATCH_SIZE && reader.read(&batch[batchSize])) batchSize++;
+        if (batchSize == 0) break;
+        runTasks((batchSize + TASK_SIZE - 1) / TASK_SIZE, numThreads, [&](int task) {
+            for (int i = task * TASK_SIZE; i < min(batchSize, (task + 1) * TASK_SIZE); i++) {
+                results[i] = edlibTrimRead(panel, batch[i].sequence.data(),
+                                           static_cast<int>(batch[i].sequence.size()));
+            }
+        });
+
+        for (int i = 0; i < batchSize; i++) {
+            Record& record = batch[i];
+            const EdlibTrimResult& result = results[i];
+            numReads++;
+            if (result.adapter != -1) {
+                numTrimmed++;
+                adapterCounts[result.adapter]++;
+                if (info) {
+                    const string name = record.header.substr(0, record.header.find_first_of(" \t"));
+                    fprintf(info, "%s\t%s\t%d\t%d\t%d\n", name.c_str(), adapterNames[result.adapter].c_str(),
+                            result.startLocation, result.endLocation + 1, result.editDistance);
+                }
+                const int keepStart = trimConfig.end == EDLIB_TRIM_START ? result.endLocation + 1 : 0;
+                const int keepEnd = trimConfig.end == EDLIB_TRIM_START
+                    ? static_cast<int>(record.sequence.size()) : result.startLocation;
+                record.sequence = record.sequence.substr(keepStart, keepEnd - keepStart);
+                if (!record.quality.empty()) record.quality = record.quality.substr(keepStart, keepEnd - keepStart);
+            }
+            if (static_cast<int>(record.sequence.size()) < minLength) {
+                numDiscarded++;
+                continue;
+            }
+            if (reader.isFastq()) {
+                printf("@%s\n%s\n+\n%s\n", record.header.c_str(), record.sequence.c_str(), record.quality.c_str());
+            } else {
+                printf(">%s\n%s\n", record.header.c_str(), record.sequence.c_str());
+            }
+        }
+    }
+
+    fprintf(stderr, "Processed %lld reads, trimmed %lld, discarded %lld as too short.\n",
+            numReads, numTrimmed, numDiscarded);
+    for (int a = 0; a < static_cast<int>(adapters.size()); a++) {
+        fprintf(stderr, "%s\t%lld\n", adapterNames[a].c_str(), adapterCounts[a]);
+    }
+
+    if (info) fclose(info);
+    if (!isStdin) fclose(input);
+    edlibFreeAdapterPanel(panel);
+    return 0;
+}
+
+
+
+int readAdapters(const char* path, vector<string>* names, vector<string>* adapters) {
+    FILE* file = fopen(path, "r");
+    if (file == 0)
+        return 1;
+
+    RecordReader reader(file);
+    Record record;
+    while (reader.read(&record)) {
+        names->push_back(record.header.substr(0, record.header.find_first_of(" \t")));
+        adapters->push_back(record.sequence);
+    }
+
+    fclose(file);
+    return 0;
+}
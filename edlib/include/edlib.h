@@ -29,6 +29,7 @@ extern "C" {
 // Status codes
 #define EDLIB_STATUS_OK 0
 #define EDLIB_STATUS_ERROR 1
+#define EDLIB_STATUS_CANCELLED 2  //!< Alignment was cancelled or ran out of time, see EdlibAlignResult.status.
 
     /**
      * Alignment methods - how should Edlib treat gaps before and after query?
@@ -94,8 +95,108 @@ extern "C" {
         char second;
     } EdlibEqualityPair;
 
+// Built-in equality presets, they can be combined with bitwise or.
+#define EDLIB_EQUALITY_CASE_INSENSITIVE 1  //!< Lowercase and uppercase ASCII letters are equal.
+/**
+ * IUPAC nucleotide codes are equal if bases they stand for overlap,
+ * e.g. R (A or G) is equal to A, G, N and S (C or G), but not to C or T. U is equal to T.
+ */
+#define EDLIB_EQUALITY_IUPAC_NUCLEOTIDE 2
+/**
+ * IUPAC amino acid codes are equal if amino acids they stand for overlap:
+ * B is equal to D and N, Z to E and Q, J to I and L, while X is equal to any amino acid.
+ */
+#define EDLIB_EQUALITY_IUPAC_AMINO_ACID 4
+
+// Value of EdlibAlignConfig.numThreads that uses one thread per hardware thread.
+#define EDLIB_ALL_THREADS (-1)
+
+    /**
+     * @brief Task that edlib gives to executor to run.
+     */
+    typedef void (*EdlibTask)(void* taskContext);
+
+    /**
+     * @brief Runs tasks of alignments that use more than one thread (see EdlibAlignConfig.numThreads),
+     * so they can run in host application's thread pool instead of in threads created by edlib.
+     */
+    typedef struct {
+        /**
+         * Schedules task to run: it has to call task(taskContext) exactly once, in any thread, and
+         * should return without waiting for it. It can be called concurrently from different threads.
+         * Edlib waits for its tasks by itself, and while doing so it runs tasks that did not start yet,
+         * so executor with busy threads only delays them.
+         * Exception are threads of pipelined EDLIB_MODE_NW, which wait for each other: numThreads - 1 of them
+         * are submitted at once and they must all start, otherwise alignment never finishes.
+         * @param [in] executorContext  EdlibExecutor.executorContext.
+         */
+        void (*submit)(void* executorContext, EdlibTask task, void* taskContext);
+
+        /**
+         * Passed to submit(), can be NULL.
+         */
+        void* executorContext;
+    } EdlibExecutor;
+
+    /**
+     * Phases of alignment, reported by progress callback.
+     */
+    typedef enum {
+        EDLIB_PHASE_DISTANCE,  //!< Finding edit distance and end locations.
+        EDLIB_PHASE_START_LOCATIONS,  //!< Finding start locations (only in EDLIB_MODE_HW).
+        EDLIB_PHASE_ALIGNMENT  //!< Finding alignment path.
+    } EdlibAlignPhase;
+
+    /**
+     * @brief Progress of alignment, reported by progress callback (see EdlibAlignConfig.progressCallback).
+     */
+    typedef struct {
+        EdlibAlignPhase phase;
+        /**
+         * In EDLIB_PHASE_DISTANCE, index of round of auto-adjusted k (each round doubles k), or first of rounds
+         * that are computed concurrently (see EdlibAlignConfig.speculativeRounds). 0 if k is given.
+         * In EDLIB_PHASE_ALIGNMENT, depth of Hirschberg's recursion that is being computed.
+         * Otherwise 0.
+         */
+        int round;
+        /**
+         * In EDLIB_PHASE_DISTANCE, k of round. Otherwise edit distance.
+         */
+        int k;
+        /**
+         * Done fraction of phase (in EDLIB_PHASE_DISTANCE, of round), from 0 to 1.
+         */
+        double fraction;
+    } EdlibProgress;
+
+    /**
+     * @brief Receives progress of alignment.
+     * It is called from thread that calls edlibAlign() or from threads of alignment, but never concurrently.
+     * @param [in] progress
+     * @param [in] progressContext  EdlibAlignConfig.progressContext.
+     * @return 0 to continue alignment, anything else to cancel it (see EDLIB_STATUS_CANCELLED),
+     *         after which callback is not called any more.
+     */
+    typedef int (*EdlibProgressCallback)(const EdlibProgress* progress, void* progressContext);
+
+    /**
+     * @brief Token that cancels alignments which use it (see EdlibAlignConfig.cancellationToken).
+     * Create it with edlibNewCancellationToken().
+     */
+    typedef struct EdlibCancellationToken EdlibCancellationToken;
+
+    /**
+     * @brief Equality definition built once from additional equalities and equality presets,
+     * which can be reused by many alignments. Create it with edlibNewEqualitySet().
+     */
+    typedef struct EdlibEqualitySet EdlibEqualitySet;
+
     /**
      * @brief Configuration object for edlibAlign() function.
+     * Always create it with edlibNewAlignConfig() or edlibDefaultAlignConfig() and then change members you need:
+     * members are added in new versions, so config that is filled member by member would leave them unset.
+     * Since version 2.0, config has more members than before, so programs built with earlier versions
+     * have to be rebuilt.
      */
     typedef struct {
         /**
@@ -137,11 +238,133 @@ extern "C" {
          * 0 if there are none.
          */
         int additionalEqualitiesLength;
+
+        /**
+         * Built-in equality presets (EDLIB_EQUALITY_*) combined with bitwise or, 0 if there are none.
+         * They extend equality same as additionalEqualities do, but are much cheaper than defining same
+         * equalities via additionalEqualities: case insensitivity is applied while reading sequences,
+         * so alphabet does not grow because of lowercase letters.
+         * IUPAC presets consider only uppercase codes, combine them with EDLIB_EQUALITY_CASE_INSENSITIVE
+         * to also match lowercase (e.g. soft-masked) sequences.
+         * If EDLIB_EQUALITY_CASE_INSENSITIVE is used, additionalEqualities are also case insensitive.
+         */
+        int equalityPresets;
+
+        /**
+         * Equality set built with edlibNewEqualitySet(), NULL if there is none.
+         * If set, it is used instead of additionalEqualities and equalityPresets.
+         * Additional equalities and presets are also turned into equality set internally, but that set
+         * is rebuilt only when they change (a few most recently used sets are cached per thread), so this is
+         * useful mostly to skip hashing of long list of additional equalities on each call.
+         */
+        const EdlibEqualitySet* equalitySet;
+
+        /**
+         * Maximal number of threads used by one alignment, EDLIB_ALL_THREADS (or any negative number)
+         * for number of hardware threads. 0 is the same as 1.
+         * Result is always same as with one thread.
+         * In EDLIB_MODE_HW, target is split into chunks which overlap by (query length + k) and are
+         * scanned concurrently. Only long targets are split, since each thread gets a chunk of at
+         * least 64K characters.
+         * In EDLIB_MODE_NW, edit distance is computed by threads in a pipeline, each of them computing
+         * its own part of each column. It pays off only for long sequences with large edit distance
+         * (thousands or more), otherwise one thread is used.
+         * EDLIB_MODE_SHW and finding of alignment path use one thread.
+         * Default is 1.
+         */
+        int numThreads;
+
+        /**
+         * Used only if k is negative (auto-adjusted): number of consecutive rounds of k (64, 128, 256, ...)
+         * that are computed concurrently, each in its own thread(s). As soon as one of them finds the solution,
+         * others are cancelled: all rounds that find solution find the same one, so result does not change.
+         * Useful to lower latency of aligning very different sequences if there are idle cores.
+         * Default is 1 (rounds are computed one after another).
+         */
+        int speculativeRounds;
+
+        /**
+         * Executor that runs tasks of alignment if it uses more than one thread.
+         * If NULL (default), edlib's built-in pool of threads is used (with one thread per hardware thread),
+         * except for pipelined EDLIB_MODE_NW, which gets its own threads.
+         */
+        const EdlibExecutor* executor;
+
+        /**
+         * Token created with edlibNewCancellationToken(), NULL if there is none.
+         * Once edlibCancel() is called on it (from any thread), alignments that use it stop soon after
+         * and return with status EDLIB_STATUS_CANCELLED.
+         */
+        const EdlibCancellationToken* cancellationToken;
+
+        /**
+         * Time limit for alignment in milliseconds, non-positive if there is none.
+         * If alignment takes longer, it stops soon after and returns with status EDLIB_STATUS_CANCELLED.
+         * Default is 0.
+         */
+        int timeoutMs;
+
+        /**
+         * Called periodically while alignment is computed, NULL if there is none.
+         * It is called at most once per progressIntervalMs, first time when progressIntervalMs passes
+         * from start of alignment, so short alignments are not reported at all.
+         */
+        EdlibProgressCallback progressCallback;
+
+        /**
+         * Passed to progressCallback, can be NULL.
+         */
+        void* progressContext;
+
+        /**
+         * Minimal time between two calls of progressCallback, in milliseconds, non-positive for default,
+         * which is 100.
+         */
+        int progressIntervalMs;
     } EdlibAlignConfig;
 
+    /**
+     * Creates cancellation token, which can be shared by many alignments.
+     * @return Token that is not cancelled, free it with edlibFreeCancellationToken() once no alignment uses it.
+     */
+    EDLIB_API EdlibCancellationToken* edlibNewCancellationToken(void);
+
+    /**
+     * Cancels alignments that use given token, including those that start later.
+     * It is safe to call it while other threads align with the token.
+     */
+    EDLIB_API void edlibCancel(EdlibCancellationToken* cancellationToken);
+
+    /**
+     * Frees token created with edlibNewCancellationToken().
+     */
+    EDLIB_API void edlibFreeCancellationToken(EdlibCancellationToken* cancellationToken);
+
+    /**
+     * Builds equality set, which extends edlib's definition of equality (which is that each character is equal
+     * only to itself) with given additional equalities and presets.
+     * Set can be shared by many alignments (also concurrently), via EdlibAlignConfig.equalitySet.
+     * @param [in] additionalEqualities  Pairs of characters that are equal, can be NULL if there are none.
+     * @param [in] additionalEqualitiesLength  Number of additional equalities.
+     * @param [in] equalityPresets  Built-in equality presets (EDLIB_EQUALITY_*) combined with bitwise or.
+     * @return Equality set, free it with edlibFreeEqualitySet() once it is not used any more.
+     */
+    EDLIB_API EdlibEqualitySet* edlibNewEqualitySet(
+        const EdlibEqualityPair* additionalEqualities,
+        int additionalEqualitiesLength,
+        int equalityPresets
+    );
+
+    /**
+     * Frees equality set created with edlibNewEqualitySet().
+     */
+    EDLIB_API void edlibFreeEqualitySet(EdlibEqualitySet* equalitySet);
+
     /**
      * Helper method for easy construction of configuration object.
-     * @return Configuration object filled with given parameters.
+     * @return Configuration object filled with given parameters, other members are set to their defaults
+     *         (no equality presets, no equality set, one thread, no speculative rounds, built-in executor,
+     *         no cancellation token, no timeout, no progress callback).
      */
     EDLIB_API EdlibAlignConfig edlibNewAlignConfig(
         int k, EdlibAlignMode mode, EdlibAlignTask task,
@@ -151,7 +374,9 @@ extern "C" {
 
     /**
      * @return Default configuration object, with following defaults:
-     *         k = -1, mode = EDLIB_MODE_NW, task = EDLIB_TASK_DISTANCE, no additional equalities.
+     *         k = -1, mode = EDLIB_MODE_NW, task = EDLIB_TASK_DISTANCE, no additional equalities,
+     *         no equality presets, no equality set, one thread, no speculative rounds, built-in executor,
+     *         no cancellation token, no timeout, no progress callback.
      */
     EDLIB_API EdlibAlignConfig edlibDefaultAlignConfig(void);
 
@@ -161,7 +386,11 @@ extern "C" {
      */
     typedef struct {
         /**
-         * EDLIB_STATUS_OK or EDLIB_STATUS_ERROR. If error, all other fields will have undefined values.
+         * EDLIB_STATUS_OK, EDLIB_STATUS_ERROR or EDLIB_STATUS_CANCELLED.
+         * If error, all other fields will have undefined values.
+         * If cancelled, result holds what was found before cancellation: editDistance is -1 if it was not
+         * computed yet, otherwise edit distance and end locations are valid, while start locations and
+         * alignment are NULL if they were not computed yet. alphabetLength is always valid.
          */
         int status;
 
@@ -213,6 +442,7 @@ extern "C" {
 
         /**
          * Number of different characters in query and target together.
+         * If EDLIB_EQUALITY_CASE_INSENSITIVE is used, lowercase and uppercase letter count as one character.
          */
         int alphabetLength;
     } EdlibAlignResult;
@@ -246,6 +476,712 @@ extern "C" {
     );
 
 
+    /**
+     * @brief Half-open interval [start, end) of positions in a sequence.
+     */
+    typedef struct {
+        int start;
+        int end;
+    } EdlibInterval;
+
+    /**
+     * @brief DNA sequence packed with 2 bits per base (4 bases per byte).
+     * Base i is stored in byte i / 4, in bits 2 * (i % 4) and 2 * (i % 4) + 1 (first base in lowest bits),
+     * with codes A = 0, C = 1, G = 2, T = 3.
+     * Since N can not be represented with 2 bits, positions of N bases are given as list of intervals,
+     * and values of bits stored for them are ignored.
+     */
+    typedef struct {
+        /**
+         * Packed bases, of size at least (length + 3) / 4 bytes.
+         */
+        const unsigned char* data;
+
+        /**
+         * Number of bases in sequence.
+         */
+        int length;
+
+        /**
+         * Intervals of positions that are N. They must be sorted and must not overlap.
+         * Can be set to NULL if there are none.
+         */
+        const EdlibInterval* nIntervals;
+
+        /**
+         * Number of N intervals, 0 if there are none.
+         */
+        int nIntervalsLength;
+    } EdlibPackedSequence;
+
+    /**
+     * Same as edlibAlign(), but works on 2-bit packed DNA sequences.
+     * Target is read directly from packed data during alignment, no unpacked copy of it is ever created,
+     * so memory usage and bandwidth for long targets is four times smaller than with edlibAlign().
+     * Result is the same as result of edlibAlign() on unpacked sequences made of characters 'A', 'C', 'G', 'T'
+     * and 'N', and additionalEqualities from config are defined over those characters.
+     * Only difference is alphabetLength, which is 5 if there are any N intervals, otherwise 4.
+     * @param [in] query  First sequence.
+     * @param [in] target  Second sequence.
+     * @param [in] config  Additional alignment parameters, like alignment method and wanted results.
+     * @return  Result of alignment, same as for edlibAlign().
+     *          Make sure to clean up the object using edlibFreeAlignResult() or by manually freeing needed members.
+     */
+    EDLIB_API EdlibAlignResult edlibAlignPacked(
+        EdlibPackedSequence query,
+        EdlibPackedSequence target,
+        const EdlibAlignConfig config
+    );
+
+    /**
+     * @brief Query prepared for search, which can be reused by many searches.
+     * Create it with edlibNewQueryProfile().
+     */
+    typedef struct EdlibQueryProfile EdlibQueryProfile;
+
+    /**
+     * @brief Search over target that is given in chunks. Create it with edlibStreamBegin().
+     */
+    typedef struct EdlibStream EdlibStream;
+
+    /**
+     * @brief State of alignment after some columns of target (see edlibColumnStateBegin()).
+     */
+    typedef struct EdlibColumnState EdlibColumnState;
+
+    /**
+     * Result of search done with EdlibStream or EdlibColumnState.
+     */
+    typedef struct {
+        /**
+         * EDLIB_STATUS_OK or EDLIB_STATUS_ERROR. If error, all other fields will have undefined values.
+         */
+        int status;
+
+        /**
+         * -1 if k is non-negative and edit distance is larger than k.
+         */
+        int editDistance;
+
+        /**
+         * Array of zero-based positions in whole target (all chunks together) where optimal alignment paths end.
+         * Set to NULL if edit distance is larger than k.
+         * If you do not free whole result object using edlibFreeStreamResult(), do not forget to use free().
+         */
+        long long* endLocations;
+
+        /**
+         * Number of end locations.
+         */
+        int numLocations;
+    } EdlibStreamResult;
+
+    /**
+     * Prepares query for search.
+     * @param [in] query  Query sequence.
+     * @param [in] queryLength  Number of characters in query.
+     * @param [in] config  Only equalities (additionalEqualities, equalityPresets and equalitySet) are used,
+     *                     since they define how query matches target characters.
+     * @return Query profile, free it with edlibFreeQueryProfile() once it is not used any more.
+     */
+    EDLIB_API EdlibQueryProfile* edlibNewQueryProfile(const char* query, int queryLength,
+                                                      const EdlibAlignConfig config);
+
+    /**
+     * Frees query profile created with edlibNewQueryProfile().
+     */
+    EDLIB_API void edlibFreeQueryProfile(EdlibQueryProfile* profile);
+
+    /**
+     * Begins search for query in target which is given in chunks, one after another, with edlibStreamFeed().
+     * Result is same as result of edlibAlign() with task EDLIB_TASK_LOC (without start locations)
+     * on whole target, but target does not have to be in memory at once: memory used by search depends only
+     * on length of query, not on length of target.
+     * @param [in] profile  Query profile, it must exist until search ends.
+     * @param [in] mode  EDLIB_MODE_HW or EDLIB_MODE_SHW.
+     * @param [in] k  Same as EdlibAlignConfig.k. If negative, search is done without limit,
+     *                which is slower than with small k, since it can not be auto-adjusted.
+     * @return Search, or NULL if mode is EDLIB_MODE_NW.
+     */
+    EDLIB_API EdlibStream* edlibStreamBegin(const EdlibQueryProfile* profile, EdlibAlignMode mode, int k);
+
+    /**
+     * Gives next chunk of target to search. Chunk can be of any length and can be freed once function returns.
+     * Chunk is searched right away, so no characters are kept from it and none are searched twice.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if chunkLength is negative.
+     */
+    EDLIB_API int edlibStreamFeed(EdlibStream* stream, const char* chunk, int chunkLength);
+
+    /**
+     * Ends search and frees it.
+     * @return Result of search. Make sure to clean up the object using edlibFreeStreamResult().
+     */
+    EDLIB_API EdlibStreamResult edlibStreamEnd(EdlibStream* stream);
+
+    /**
+     * Frees memory in EdlibStreamResult that was allocated by edlib.
+     */
+    EDLIB_API void edlibFreeStreamResult(EdlibStreamResult result);
+
+    /**
+     * Begins alignment of query to target whose characters are given with edlibColumnStateAdvance().
+     * State of alignment is state of one column of dynamic programming matrix, which can be copied at any
+     * point with edlibColumnStateCopy() and used later to continue alignment from there, e.g. to align query
+     * to many targets that share a prefix, or to continue with alignment as target grows,
+     * without computing it again from the start.
+     * @param [in] profile  Query profile, it must exist as long as state.
+     * @param [in] mode  Alignment method.
+     * @param [in] k  Same as EdlibAlignConfig.k. If negative, alignment is done without limit,
+     *                which is slower than with small k, since it can not be auto-adjusted.
+     * @return State at start of target, free it with edlibFreeColumnState().
+     */
+    EDLIB_API EdlibColumnState* edlibColumnStateBegin(const EdlibQueryProfile* profile, EdlibAlignMode mode,
+                                                      int k);
+
+    /**
+     * Continues alignment with given characters of target, that follow those given before.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if targetLength is negative.
+     */
+    EDLIB_API int edlibColumnStateAdvance(EdlibColumnState* state, const char* target, int targetLength);
+
+    /**
+     * @return Copy of state, free it with edlibFreeColumnState().
+     */
+    EDLIB_API EdlibColumnState* edlibColumnStateCopy(const EdlibColumnState* state);
+
+    /**
+     * Lowers k of alignment, for example to continue only if a better result can still be found.
+     * k can not be raised, since state does not contain cells with values above its k
+     * (in EDLIB_MODE_HW and EDLIB_MODE_SHW, k of state is also lowered to best score found so far).
+     * @param [in] k  New k, negative for no limit.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if k is larger than k of state.
+     */
+    EDLIB_API int edlibColumnStateSetK(EdlibColumnState* state, int k);
+
+    /**
+     * @return Number of target characters that state is computed for.
+     */
+    EDLIB_API long long edlibColumnStatePosition(const EdlibColumnState* state);
+
+    /**
+     * @return Result of alignment as if target ended at current position, which is the same as result of
+     *         edlibAlign() with EDLIB_TASK_LOC (without start locations) on target given so far.
+     *         Make sure to clean up the object using edlibFreeStreamResult().
+     */
+    EDLIB_API EdlibStreamResult edlibColumnStateResult(const EdlibColumnState* state);
+
+    /**
+     * Frees state created with edlibColumnStateBegin() or edlibColumnStateCopy().
+     */
+    EDLIB_API void edlibFreeColumnState(EdlibColumnState* state);
+
+    /**
+     * @brief Alignment of query to target that is changed by edits (see edlibIncrementalBegin()).
+     */
+    typedef struct EdlibIncrementalAlignment EdlibIncrementalAlignment;
+
+    /**
+     * Aligns query to target, remembering states of columns of alignment at checkpoints along target,
+     * so that after target is edited only columns from the edit on are computed again, and only until
+     * they become the same as before the edit (up to score that edit added to all their cells).
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] target  Second sequence, it is copied.
+     * @param [in] targetLength  Number of characters in second sequence.
+     * @param [in] config  Additional alignment parameters, same as for edlibAlign().
+     *                     Only k, mode, task and equalities are used.
+     * @return Alignment, free it with edlibFreeIncrementalAlignment().
+     */
+    EDLIB_API EdlibIncrementalAlignment* edlibIncrementalBegin(const char* query, int queryLength,
+                                                               const char* target, int targetLength,
+                                                               const EdlibAlignConfig config);
+
+    /**
+     * Edits target: replaces deletedLength characters starting at position with insertedLength given
+     * characters, and updates alignment.
+     * Target is kept with gap at last edit, so edit moves only characters between it and previous edit.
+     * Columns are computed from last checkpoint before edit until they are the same as before the edit
+     * (up to score that edit added to all their cells, as in NW where each later column changes by edit's cost),
+     * which is usually at first checkpoint after it (checkpoints are max(4096, target length / 64) apart).
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if edited part is not inside target.
+     */
+    EDLIB_API int edlibIncrementalEdit(EdlibIncrementalAlignment* alignment, int position, int deletedLength,
+                                       const char* inserted, int insertedLength);
+
+    /**
+     * @return Result of alignment of query to current target, same as result of edlibAlign().
+     *         Edit distance and end locations are already computed, while start locations and alignment path
+     *         (if task asks for them) are computed on call, only for part of target that query aligns to.
+     *         Make sure to clean up the object using edlibFreeAlignResult().
+     */
+    EDLIB_API EdlibAlignResult edlibIncrementalResult(const EdlibIncrementalAlignment* alignment);
+
+    /**
+     * Frees alignment created with edlibIncrementalBegin().
+     */
+    EDLIB_API void edlibFreeIncrementalAlignment(EdlibIncrementalAlignment* alignment);
+
+    /**
+     * Aligns each of queries to target, with the same result as edlibAlign() would give for it.
+     * Queries are sorted into trie of blocks of their rows, so that rows of first blocks that
+     * queries share are computed only once per column of target. This is faster than aligning queries
+     * one by one when many of them share long prefixes (e.g. variants of amplicon, barcodes with common adapter).
+     * Only edit distance and end locations are found together, start locations and alignment path
+     * (if task asks for them) are then found for each query on its own.
+     * @param [in] queries  Array of queries.
+     * @param [in] queryLengths  queryLengths[i] is number of characters in queries[i].
+     * @param [in] numQueries  Number of queries.
+     * @param [in] target  Sequence that all queries are aligned to.
+     * @param [in] targetLength  Number of characters in target.
+     * @param [in] config  Additional alignment parameters, same as for edlibAlign().
+     *                     Only k, mode, task and equalities are used.
+     * @param [out] results  Array of numQueries results, results[i] is set to result of aligning queries[i].
+     *                       Make sure to clean up each of them using edlibFreeAlignResult().
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if some length is negative (then results are not set).
+     */
+    EDLIB_API int edlibAlignQueries(const char* const* queries, const int* queryLengths, int numQueries,
+                                    const char* target, int targetLength, const EdlibAlignConfig config,
+                                    EdlibAlignResult* results);
+
+    /**
+     * Aligns each of queries to each of targets, with the same result as edlibAlign() would give for each pair.
+     * Query profiles (Peq) are built only once per query, over one alphabet shared by all sequences.
+     * Pairs are then computed in tiles of consecutive queries and consecutive targets, sized so that profiles
+     * and targets of one tile fit in L2 cache together, and all pairs of tile are computed before next tile.
+     * That way each target is read from memory once per tile of queries instead of once per query.
+     * @param [in] queries  Array of queries.
+     * @param [in] queryLengths  queryLengths[i] is number of characters in queries[i].
+     * @param [in] numQueries  Number of queries.
+     * @param [in] targets  Array of targets.
+     * @param [in] targetLengths  targetLengths[j] is number of characters in targets[j].
+     * @param [in] numTargets  Number of targets.
+     * @param [in] config  Additional alignment parameters, same as for edlibAlign(). Tiles are computed
+     *                     in parallel with numThreads threads (or executor), while each pair is computed
+     *                     on one thread. Progress callback is not used.
+     * @param [out] results  Array of numQueries * numTargets results, results[i * numTargets + j] is set to
+     *                       result of aligning queries[i] to targets[j].
+     *                       Make sure to clean up each of them using edlibFreeAlignResult().
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if some length or number of sequences is negative
+     *         (then results are not set).
+     */
+    EDLIB_API int edlibAlignAllPairs(const char* const* queries, const int* queryLengths, int numQueries,
+                                     const char* const* targets, const int* targetLengths, int numTargets,
+                                     const EdlibAlignConfig config, EdlibAlignResult* results);
+
+    /**
+     * @brief Index of words that a query can be searched for (see edlibDictionarySearch()).
+     */
+    typedef struct EdlibDictionary EdlibDictionary;
+
+    /**
+     * Word of dictionary that matches query.
+     */
+    typedef struct {
+        int word;  // Index of word, as given to edlibNewDictionary().
+        int editDistance;  // Edit distance between query and word.
+    } EdlibDictionaryMatch;
+
+    /**
+     * @brief Words of dictionary that match query.
+     */
+    typedef struct {
+        int status;  // EDLIB_STATUS_OK or EDLIB_STATUS_ERROR.
+        EdlibDictionaryMatch* matches;  // Ordered by edit distance, then by index of word.
+        int numMatches;
+    } EdlibDictionaryResult;
+
+    /**
+     * Builds dictionary from words, e.g. gene names or barcodes. Words are sorted, so that columns of
+     * alignment for prefix that words share are computed only once per search.
+     * @param [in] words  Array of words, they are copied.
+     * @param [in] wordLengths  wordLengths[i] is number of characters in words[i].
+     * @param [in] numWords  Number of words.
+     * @return Dictionary, or NULL if some length is negative. Free it with edlibFreeDictionary().
+     */
+    EDLIB_API EdlibDictionary* edlibNewDictionary(const char* const* words, const int* wordLengths, int numWords);
+
+    /**
+     * Finds all words of dictionary whose edit distance to query is at most k.
+     * Query is aligned to each word as if it was target, so result for each word is the same as edlibAlign()
+     * would give for query and word. Words are visited in sorted order, with column states for their
+     * common prefixes kept on a stack, and words whose prefix already has all cells above k are skipped.
+     * Time of search therefore depends on number of nodes in trie of words, rather than on total length of them.
+     * @param [in] dictionary
+     * @param [in] query
+     * @param [in] queryLength
+     * @param [in] config  Only k, mode and equalities are used. If k is negative, all words are matched.
+     *                     Words are pruned only in EDLIB_MODE_NW and EDLIB_MODE_SHW.
+     * @return Matching words. Make sure to clean up the object using edlibFreeDictionaryResult().
+     */
+    EDLIB_API EdlibDictionaryResult edlibDictionarySearch(const EdlibDictionary* dictionary,
+                                                          const char* query, int queryLength,
+                                                          const EdlibAlignConfig config);
+
+    /**
+     * Frees memory in EdlibDictionaryResult that was allocated by edlib.
+     */
+    EDLIB_API void edlibFreeDictionaryResult(EdlibDictionaryResult result);
+
+    /**
+     * Frees dictionary created with edlibNewDictionary().
+     */
+    EDLIB_API void edlibFreeDictionary(EdlibDictionary* dictionary);
+
+    /**
+     * @brief Index of barcodes that reads are matched to (see edlibNewBarcodeIndex()).
+     */
+    typedef struct EdlibBarcodeIndex EdlibBarcodeIndex;
+
+    /**
+     * Barcode that read is matched to.
+     */
+    typedef struct {
+        int status;  // EDLIB_STATUS_OK or EDLIB_STATUS_ERROR.
+        // Index of barcode with smallest edit distance to read (as given to edlibNewBarcodeIndex()),
+        // -1 if no barcode is within k or if more than one barcode has the smallest edit distance.
+        int barcode;
+        int editDistance;  // Smallest edit distance of barcode to read, -1 if no barcode is within k.
+        int ambiguous;  // 1 if more than one barcode has the smallest edit distance, 0 otherwise.
+    } EdlibBarcodeMatch;
+
+    /**
+     * Builds index for matching reads to barcodes (e.g. for demultiplexing), with edit distance (NW) of
+     * at most k. For each barcode, hashes of all sequences obtained from it by deleting at most k characters
+     * are stored (symmetric deletion), so index has about numBarcodes * (barcodeLength choose k) entries
+     * and is meant for short barcodes and small k.
+     * Characters are compared exactly, equalities are not supported.
+     * @param [in] barcodes  Array of barcodes, they are copied.
+     * @param [in] barcodeLengths  barcodeLengths[i] is number of characters in barcodes[i].
+     * @param [in] numBarcodes  Number of barcodes.
+     * @param [in] k  Largest edit distance of read to its barcode, non-negative.
+     * @return Index, or NULL if some length or k is negative. Free it with edlibFreeBarcodeIndex().
+     */
+    EDLIB_API EdlibBarcodeIndex* edlibNewBarcodeIndex(const char* const* barcodes, const int* barcodeLengths,
+                                                      int numBarcodes, int k);
+
+    /**
+     * Finds barcode with smallest edit distance (NW) to read, among barcodes within k of it.
+     * Candidates are barcodes that share deletion variant with read, found in expected constant time,
+     * and only they are aligned to read (with single block of Myers's algorithm if read has at most
+     * 64 characters). Index is not changed, so it can be used from multiple threads at once.
+     */
+    EDLIB_API EdlibBarcodeMatch edlibBarcodeIndexLookup(const EdlibBarcodeIndex* index,
+                                                        const char* read, int readLength);
+
+    /**
+     * Frees index created with edlibNewBarcodeIndex().
+     */
+    EDLIB_API void edlibFreeBarcodeIndex(EdlibBarcodeIndex* index);
+
+    /**
+     * Pair of strings found by edlibSimilarityJoin().
+     */
+    typedef struct {
+        int a;  // Index of string in set A.
+        int b;  // Index of string in set B.
+        int editDistance;
+    } EdlibJoinPair;
+
+    /**
+     * Called by edlibSimilarityJoin() with pairs found so far, they are valid only during the call.
+     */
+    typedef void (*EdlibJoinCallback)(const EdlibJoinPair* pairs, int numPairs, void* context);
+
+    /**
+     * Finds all pairs of strings a from set A and b from set B whose edit distance (NW) is at most k.
+     * Candidate pairs are generated with filters, so that most pairs are never aligned:
+     *  - length filter: lengths of a and b differ by at most k.
+     *  - prefix filter: q-grams of each string are sorted from globally rarest to most common, and
+     *    first kq + 1 of them must be shared by a and b, so candidates are found through inverted lists.
+     *  - count filter: a and b share at least max(|a|, |b|) - q + 1 - kq q-grams.
+     * q is chosen from average length of strings and k. Strings with less than kq + 1 q-grams pass
+     * only through length filter, so join is fastest when strings are long compared to k.
+     * Candidates are then verified with Myers's algorithm bounded by k, in parallel.
+     * Characters are compared exactly, equalities are not supported.
+     * @param [in] stringsA  Array of strings of set A.
+     * @param [in] lengthsA  lengthsA[i] is number of characters in stringsA[i].
+     * @param [in] numA  Number of strings in set A.
+     * @param [in] stringsB  Array of strings of set B, it may be the same as set A (self join), in which
+     *                       case each pair is found twice and each string is paired with itself.
+     * @param [in] lengthsB  lengthsB[i] is number of characters in stringsB[i].
+     * @param [in] numB  Number of strings in set B.
+     * @param [in] config  Only k (non-negative), numThreads and executor are used.
+     * @param [in] callback  Pairs are streamed to it as they are found. It is called only from calling thread,
+     *                       with pairs ordered by a and then by b.
+     * @param [in] callbackContext  Passed to callback.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if k or some length is negative.
+     */
+    EDLIB_API int edlibSimilarityJoin(const char* const* stringsA, const int* lengthsA, int numA,
+                                      const char* const* stringsB, const int* lengthsB, int numB,
+                                      const EdlibAlignConfig config,
+                                      EdlibJoinCallback callback, void* callbackContext);
+
+    /**
+     * Called by edlibScan() for each position of text where occurrence of query within k ends.
+     */
+    typedef void (*EdlibScanCallback)(long long endLocation, int editDistance, void* context);
+
+    /**
+     * Finds all occurrences of query in text (EDLIB_MODE_HW) with edit distance at most k: unlike edlibAlign(),
+     * which reports only end locations with best score, callback is called for each position of text where
+     * some occurrence within k ends, with smallest edit distance of occurrences that end there,
+     * in increasing order of positions.
+     * If separator is given, occurrences never contain it: text is scanned as if it was split into pieces
+     * at separators (e.g. lines, with separator '\n'), and no position of separator is reported.
+     * If query length is at most k, every position that is not separator is reported.
+     * @param [in] profile  Query profile.
+     * @param [in] text  Text that is searched, it can be longer than 2^31 characters.
+     * @param [in] textLength  Number of characters in text.
+     * @param [in] k  Largest edit distance of occurrence, non-negative.
+     * @param [in] separator  Character (0 to 255) that occurrences can not contain, -1 for none.
+     * @param [in] callback  Called for each found end position.
+     * @param [in] callbackContext  Passed to callback.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if k or textLength is negative, or separator is invalid.
+     */
+    EDLIB_API int edlibScan(const EdlibQueryProfile* profile, const char* text, long long textLength, int k,
+                            int separator, EdlibScanCallback callback, void* callbackContext);
+
+    /**
+     * End of read that adapters are trimmed from.
+     */
+    typedef enum {
+        EDLIB_TRIM_END,  // 3' end: adapter and everything after it is trimmed.
+        EDLIB_TRIM_START  // 5' end: adapter and everything before it is trimmed.
+    } EdlibTrimEnd;
+
+    /**
+     * @brief Configuration of adapter trimming (see edlibNewAdapterPanel()).
+     */
+    typedef struct {
+        /**
+         * End of read that adapters are searched at.
+         */
+        EdlibTrimEnd end;
+
+        /**
+         * Largest allowed number of edits per character of adapter that is aligned to read,
+         * e.g. with 0.1 occurrence of 25 characters of adapter may have 2 edits.
+         */
+        double maxErrorRate;
+
+        /**
+         * Smallest number of characters of adapter that partial occurrence must contain.
+         */
+        int minOverlap;
+
+        /**
+         * Only this many characters at trimmed end of read are searched, -1 for whole read.
+         */
+        int searchLength;
+    } EdlibTrimConfig;
+
+    /**
+     * Helper method for easy construction of configuration object.
+     * @return Configuration object filled with default values:
+     *         end = EDLIB_TRIM_END, maxErrorRate = 0.1, minOverlap = 3, searchLength = -1.
+     */
+    EDLIB_API EdlibTrimConfig edlibDefaultTrimConfig(void);
+
+    /**
+     * @brief Panel of adapters (or primers) that reads are trimmed with (see edlibNewAdapterPanel()).
+     */
+    typedef struct EdlibAdapterPanel EdlibAdapterPanel;
+
+    /**
+     * Adapter found at end of read.
+     */
+    typedef struct {
+        int status;  // EDLIB_STATUS_OK or EDLIB_STATUS_ERROR.
+        int adapter;  // Index of adapter, as given to edlibNewAdapterPanel(), -1 if no adapter was found.
+        int editDistance;  // Number of edits in occurrence of adapter, -1 if no adapter was found.
+        // Occurrence of adapter is read[startLocation, endLocation] (both inclusive), -1 if no adapter was found.
+        // Trimmed read is read[0, startLocation) for EDLIB_TRIM_END and read(endLocation, readLength)
+        // for EDLIB_TRIM_START.
+        int startLocation;
+        int endLocation;
+        int adapterLength;  // Number of characters of adapter in occurrence, smaller than length of adapter if partial.
+    } EdlibTrimResult;
+
+    /**
+     * Prepares adapters for trimming of reads. All adapters are compiled into Peq tables of one
+     * bit-vector matrix, with adapters of at most 64 characters packed several into each word,
+     * so that each column of read is computed for all adapters at once.
+     * Occurrences are found as follows (described for EDLIB_TRIM_END, EDLIB_TRIM_START is its mirror image):
+     *  - full occurrence: whole adapter aligned (EDLIB_MODE_HW) to part of read, which may be followed
+     *    by any characters (e.g. when insert is shorter than read).
+     *  - partial occurrence: prefix of adapter of at least minOverlap characters aligned to suffix of read.
+     * Occurrence with adapter prefix of length m is found if it has at most maxErrorRate * m edits.
+     * Of all occurrences, the one with most characters of adapter is reported, then the one with least
+     * edits, then the one farthest from trimmed end of read, then the one with adapter of smallest index.
+     * Adapters with no characters are never found.
+     * @param [in] adapters  Array of adapters, they are copied.
+     * @param [in] adapterLengths  adapterLengths[i] is number of characters in adapters[i].
+     * @param [in] numAdapters  Number of adapters.
+     * @param [in] trimConfig  Where and how adapters are searched.
+     * @param [in] config  Only equalities (additionalEqualities, equalityPresets and equalitySet) are used.
+     * @return Panel, or NULL if some length, maxErrorRate or minOverlap is negative, or searchLength is smaller
+     *         than -1. Free it with edlibFreeAdapterPanel().
+     */
+    EDLIB_API EdlibAdapterPanel* edlibNewAdapterPanel(const char* const* adapters, const int* adapterLengths,
+                                                      int numAdapters, const EdlibTrimConfig trimConfig,
+                                                      const EdlibAlignConfig config);
+
+    /**
+     * Finds adapter at end of read in one pass over searched end of read, see edlibNewAdapterPanel().
+     * Panel is not changed, so it can be used from multiple threads at once.
+     */
+    EDLIB_API EdlibTrimResult edlibTrimRead(const EdlibAdapterPanel* panel, const char* read, int readLength);
+
+    /**
+     * Frees panel created with edlibNewAdapterPanel().
+     */
+    EDLIB_API void edlibFreeAdapterPanel(EdlibAdapterPanel* panel);
+
+    /**
+     * Rectangle of pair space of all-vs-all comparison: pairs (i, j) of sequences
+     * with rowBegin <= i < rowEnd, columnBegin <= j < columnEnd and i < j.
+     */
+    typedef struct {
+        int rowBegin;
+        int rowEnd;
+        int columnBegin;
+        int columnEnd;
+        double work;  // Sum of products of lengths of sequences of each pair in tile.
+    } EdlibTile;
+
+    /**
+     * @brief Split of all-vs-all comparison into shards that can be computed independently.
+     */
+    typedef struct {
+        int status;  // EDLIB_STATUS_OK or EDLIB_STATUS_ERROR.
+        EdlibTile* tiles;  // Ordered by rows, then by columns.
+        int numTiles;
+        /**
+         * Array of numShards + 1 indices of tiles: shard s consists of tiles from shardTiles[s]
+         * to shardTiles[s + 1] - 1.
+         */
+        int* shardTiles;
+        int numShards;
+    } EdlibAllVsAllPlan;
+
+    /**
+     * Splits pairs (i, j), i < j, of sequences into tiles and tiles into shards with about the same work,
+     * so that all-vs-all comparison can be spread over many processes or machines.
+     * Sequences are cut into blocks of consecutive sequences with about the same sum of lengths,
+     * and each pair of blocks forms one tile, so that there are at least 8 tiles per shard
+     * (if there are enough sequences). Tiles are then assigned to shards in order, each shard getting
+     * consecutive tiles with about 1 / numShards of total work (sum of products of lengths over all pairs,
+     * where empty sequences count as sequences of length 1).
+     * Plan depends only on lengths and number of shards, so each worker can compute it on its own.
+     * @param [in] lengths  lengths[i] is number of characters in i-th sequence.
+     * @param [in] numSequences  Number of sequences.
+     * @param [in] numShards  Number of shards, positive.
+     * @return Plan, with status EDLIB_STATUS_ERROR if some length or numSequences is negative or
+     *         numShards is not positive. Free it with edlibFreeAllVsAllPlan().
+     */
+    EDLIB_API EdlibAllVsAllPlan edlibPlanAllVsAll(const int* lengths, int numSequences, int numShards);
+
+    /**
+     * Frees arrays of plan created with edlibPlanAllVsAll().
+     */
+    EDLIB_API void edlibFreeAllVsAllPlan(EdlibAllVsAllPlan plan);
+
+    /**
+     * @brief Results of a batch, stored in few contiguous buffers instead of arrays of each result.
+     * Each result is a fixed-size record with offsets into shared buffers of locations, alignments and
+     * (optionally) cigars, so the whole batch is freed at once and can be saved as is to a binary file.
+     */
+    typedef struct EdlibResultArena EdlibResultArena;
+
+    /**
+     * @param [in] withCigars  If not 0, cigar of each result that has alignment is also stored in arena.
+     * @param [in] cigarFormat  Format of stored cigars.
+     * @return Empty arena. Free it with edlibFreeResultArena().
+     */
+    EDLIB_API EdlibResultArena* edlibNewResultArena(int withCigars, EdlibCigarFormat cigarFormat);
+
+    /**
+     * Moves results to the end of arena: their arrays are copied into arena and then freed with
+     * edlibFreeAlignResult(), so results must not be freed again. Typically results of edlibAlignQueries()
+     * or edlibAlignAllPairs() are given, or result of edlibAlign() as array of one. Batches can also be
+     * aligned straight into arena with edlibAlignQueriesToArena() and edlibAlignAllPairsToArena().
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if arena was loaded from file or buffer, since
+     *         such arena can not be changed (then results are not changed).
+     */
+    EDLIB_API int edlibResultArenaAppend(EdlibResultArena* arena, EdlibAlignResult* results, int numResults);
+
+    /**
+     * Same as edlibAlignQueries(), but results are appended to arena (in order of queries) instead of being
+     * returned. Arrays of each result are written into buffers of arena as soon as result is found,
+     * without allocating them (or cigar) for each result on its own.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if edlibAlignQueries() would return it or arena was
+     *         loaded from file or buffer (then arena is not changed).
+     */
+    EDLIB_API int edlibAlignQueriesToArena(const char* const* queries, const int* queryLengths, int numQueries,
+                                           const char* target, int targetLength,
+                                           const EdlibAlignConfig config, EdlibResultArena* arena);
+
+    /**
+     * Same as edlibAlignAllPairs(), but results are appended to arena (in the same order as edlibAlignAllPairs()
+     * returns them) instead of being returned. Arrays of results are written into buffers of arena as
+     * pairs are computed, without allocating them (or cigar) for each pair on its own.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if edlibAlignAllPairs() would return it or arena was
+     *         loaded from file or buffer (then arena is not changed).
+     */
+    EDLIB_API int edlibAlignAllPairsToArena(const char* const* queries, const int* queryLengths, int numQueries,
+                                            const char* const* targets, const int* targetLengths, int numTargets,
+                                            const EdlibAlignConfig config, EdlibResultArena* arena);
+
+    /**
+     * @return Number of results in arena.
+     */
+    EDLIB_API long long edlibResultArenaSize(const EdlibResultArena* arena);
+
+    /**
+     * @return Result with given index, with arrays pointing into arena. They are valid until arena is
+     *         changed or freed, and must not be changed or freed. Result with status EDLIB_STATUS_ERROR
+     *         is returned if index is out of range.
+     */
+    EDLIB_API EdlibAlignResult edlibResultArenaGet(const EdlibResultArena* arena, long long index);
+
+    /**
+     * @return Cigar of result with given index (see edlibAlignmentToCigar()), or NULL if cigars are not
+     *         stored or result has no alignment. It is valid as long as result from edlibResultArenaGet().
+     */
+    EDLIB_API const char* edlibResultArenaCigar(const EdlibResultArena* arena, long long index);
+
+    /**
+     * Writes arena to binary file: versioned header followed by records, locations, alignments and cigars,
+     * each starting at multiple of 8 bytes, in native byte order. Since that is exactly how arena keeps
+     * them in memory, file can be memory mapped and used through edlibResultArenaFromBuffer() without copying.
+     * @return EDLIB_STATUS_OK, or EDLIB_STATUS_ERROR if file could not be written.
+     */
+    EDLIB_API int edlibSaveResultArena(const EdlibResultArena* arena, const char* path);
+
+    /**
+     * Opens arena written by edlibSaveResultArena(). File is memory mapped (on Windows it is read into memory),
+     * so only parts of it that are used are read, and it must not be changed until arena is freed.
+     * @return Arena that can be read but not appended to, or NULL if file could not be read, it is not
+     *         arena file of supported version and byte order, or it is corrupted.
+     *         Free it with edlibFreeResultArena().
+     */
+    EDLIB_API EdlibResultArena* edlibLoadResultArena(const char* path);
+
+    /**
+     * Uses contents of arena file that are already in memory (e.g. memory mapped file) without copying them.
+     * @param [in] buffer  Contents of file written by edlibSaveResultArena(), aligned to 8 bytes.
+     *                     It must not be changed or freed before arena is freed.
+     * @param [in] size  Number of bytes in buffer.
+     * @return Same as edlibLoadResultArena().
+     */
+    EDLIB_API EdlibResultArena* edlibResultArenaFromBuffer(const void* buffer, long long size);
+
+    /**
+     * Frees arena with all its results (but not buffer that it was created from).
+     */
+    EDLIB_API void edlibFreeResultArena(EdlibResultArena* arena);
+
+
     /**
      * Builds cigar string from given alignment sequence.
      * @param [in] alignment  Alignment sequence.
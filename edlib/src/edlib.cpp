@@ -2,10 +2,39 @@
 
 #include <stdint.h>
 #include <cstdlib>
+#include <cstdio>
+#include <climits>
 #include <algorithm>
 #include <vector>
+#include <unordered_map>
 #include <cstring>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// For helpers of inner loops that are called from several loops, which compiler would otherwise not inline.
+#if defined(__GNUC__)
+#define EDLIB_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define EDLIB_FORCE_INLINE __forceinline
+#else
+#define EDLIB_FORCE_INLINE inline
+#endif
 
 using namespace std;
 
@@ -54,27 +83,195 @@ struct Block {
 
 
 /**
- * Defines equality relation on alphabet characters.
- * By default each character is always equal only to itself, but you can also provide additional equalities.
+ * Masks of what IUPAC codes stand for, used by built-in equality presets.
+ * Two codes are equal if their masks have at least one bit in common.
+ * Only uppercase codes have masks, lowercase ones are handled by case folding.
  */
-class EqualityDefinition {
-private:
-    bool matrix[MAX_UCHAR + 1][MAX_UCHAR + 1];
+class IupacCodes {
 public:
-    EqualityDefinition(const string& alphabet,
-                       const EdlibEqualityPair* additionalEqualities = NULL,
-                       const int additionalEqualitiesLength = 0) {
-        for (int i = 0; i < static_cast<int>(alphabet.size()); i++) {
-            for (int j = 0; j < static_cast<int>(alphabet.size()); j++) {
-                matrix[i][j] = (i == j);
+    // Bases (A = 1, C = 2, G = 4, T/U = 8) that nucleotide code stands for, 0 if not a nucleotide code.
+    uint32_t nucleotide[MAX_UCHAR + 1];
+    // Amino acids (one bit per residue) that amino acid code stands for, 0 if not an amino acid code.
+    uint32_t aminoAcid[MAX_UCHAR + 1];
+
+    IupacCodes() {
+        for (int i = 0; i <= MAX_UCHAR; i++) {
+            nucleotide[i] = aminoAcid[i] = 0;
+        }
+
+        const uint32_t A = 1, C = 2, G = 4, T = 8;
+        nucleotide['A'] = A; nucleotide['C'] = C; nucleotide['G'] = G;
+        nucleotide['T'] = T; nucleotide['U'] = T;
+        nucleotide['R'] = A | G; nucleotide['Y'] = C | T; nucleotide['S'] = G | C; nucleotide['W'] = A | T;
+        nucleotide['K'] = G | T; nucleotide['M'] = A | C;
+        nucleotide['B'] = C | G | T; nucleotide['D'] = A | G | T; nucleotide['H'] = A | C | T;
+        nucleotide['V'] = A | C | G; nucleotide['N'] = A | C | G | T;
+
+        const char residues[] = "ACDEFGHIKLMNPQRSTVWYUO";
+        uint32_t allResidues = 0;
+        for (int i = 0; residues[i]; i++) {
+            aminoAcid[static_cast<unsigned char>(residues[i])] = static_cast<uint32_t>(1) << i;
+            allResidues |= aminoAcid[static_cast<unsigned char>(residues[i])];
+        }
+        aminoAcid['B'] = aminoAcid['D'] | aminoAcid['N'];
+        aminoAcid['Z'] = aminoAcid['E'] | aminoAcid['Q'];
+        aminoAcid['J'] = aminoAcid['I'] | aminoAcid['L'];
+        aminoAcid['X'] = allResidues;
+    }
+};
+
+static const IupacCodes& iupacCodes() {
+    static const IupacCodes codes;
+    return codes;
+}
+
+/**
+ * @return Character with ASCII lowercase letters turned into uppercase ones, other characters are unchanged.
+ */
+static inline unsigned char foldCase(const unsigned char c) {
+    return c >= 'a' && c <= 'z' ? static_cast<unsigned char>(c - 'a' + 'A') : c;
+}
+
+static const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ULL;
+
+/**
+ * @return FNV-1a hash of given bytes. To hash bytes that are not contiguous, pass hash of previous bytes as hash.
+ */
+static inline uint64_t fnv1a(const void* const data, const size_t size, uint64_t hash = FNV1A_OFFSET_BASIS) {
+    const unsigned char* const bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+/**
+ * Set of 256 bits, stored as 4 words.
+ */
+struct CharMask {
+    Word words[(MAX_UCHAR + 1) / WORD_SIZE];
+
+    bool contains(const unsigned char c) const {
+        return (words[c / WORD_SIZE] >> (c % WORD_SIZE)) & WORD_1;
+    }
+
+    void add(const unsigned char c) {
+        words[c / WORD_SIZE] |= WORD_1 << (c % WORD_SIZE);
+    }
+};
+
+/**
+ * Equality relation on all characters, stored as one 256-bit mask per character.
+ * It is built once from additional equalities and equality presets, and can then be reused by many alignments.
+ * NOTE: EDLIB_EQUALITY_CASE_INSENSITIVE is applied while transforming sequences, by folding characters
+ *   into the same symbol, so relation is defined only on folded characters.
+ */
+struct EdlibEqualitySet {
+    int presets;
+    // masks[a] contains b if characters a and b are equal.
+    CharMask masks[MAX_UCHAR + 1];
+
+    EdlibEqualitySet(const EdlibEqualityPair* const additionalEqualities, const int additionalEqualitiesLength,
+                     const int equalityPresets) : presets(equalityPresets) {
+        memset(masks, 0, sizeof(masks));
+        for (int c = 0; c <= MAX_UCHAR; c++) {
+            masks[c].add(static_cast<unsigned char>(c));
+        }
+
+        const IupacCodes& iupac = iupacCodes();
+        for (int a = 0; a <= MAX_UCHAR; a++) {
+            if (!iupac.nucleotide[a] && !iupac.aminoAcid[a]) continue;
+            for (int b = 0; b <= MAX_UCHAR; b++) {
+                if (((presets & EDLIB_EQUALITY_IUPAC_NUCLEOTIDE) && (iupac.nucleotide[a] & iupac.nucleotide[b]))
+                    || ((presets & EDLIB_EQUALITY_IUPAC_AMINO_ACID) && (iupac.aminoAcid[a] & iupac.aminoAcid[b]))) {
+                    masks[a].add(static_cast<unsigned char>(b));
+                }
             }
         }
+
         if (additionalEqualities != NULL) {
             for (int i = 0; i < additionalEqualitiesLength; i++) {
-                size_t firstTransformed = alphabet.find(additionalEqualities[i].first);
-                size_t secondTransformed = alphabet.find(additionalEqualities[i].second);
-                if (firstTransformed != string::npos && secondTransformed != string::npos) {
-                    matrix[firstTransformed][secondTransformed] = matrix[secondTransformed][firstTransformed] = true;
+                unsigned char first = static_cast<unsigned char>(additionalEqualities[i].first);
+                unsigned char second = static_cast<unsigned char>(additionalEqualities[i].second);
+                if (presets & EDLIB_EQUALITY_CASE_INSENSITIVE) {
+                    first = foldCase(first);
+                    second = foldCase(second);
+                }
+                masks[first].add(second);
+                masks[second].add(first);
+            }
+        }
+    }
+};
+
+/**
+ * Equality set built from additional equalities and presets, remembered so it can be reused.
+ */
+struct CachedEqualitySet {
+    uint64_t hash;
+    vector<EdlibEqualityPair> pairs;
+    shared_ptr<const EdlibEqualitySet> equalitySet;
+};
+
+/**
+ * @return Equality set that extends equality as defined by config, or NULL if each character is
+ *         equal only to itself. If config does not contain equality set, one is built from additional
+ *         equalities and presets, and it is cached (per thread), so that many alignments with same equalities
+ *         build it only once. Returned set is shared with cache, so it stays valid while it is held
+ *         even if cache evicts it meanwhile (for example when progress callback aligns with other equalities).
+ *         If set is owned by config, returned pointer does not own it.
+ */
+static shared_ptr<const EdlibEqualitySet> configEqualitySet(const EdlibAlignConfig& config) {
+    if (config.equalitySet != NULL) {
+        return shared_ptr<const EdlibEqualitySet>(shared_ptr<const EdlibEqualitySet>(), config.equalitySet);
+    }
+    const int numPairs = config.additionalEqualities == NULL ? 0 : config.additionalEqualitiesLength;
+    if (numPairs == 0 && config.equalityPresets == 0) return NULL;
+
+    const uint64_t hash = fnv1a(config.additionalEqualities, sizeof(EdlibEqualityPair) * numPairs,
+                                fnv1a(&config.equalityPresets, sizeof(config.equalityPresets)));
+
+    static const int CACHE_SIZE = 8;
+    static thread_local vector<CachedEqualitySet> cache;
+    for (int i = 0; i < static_cast<int>(cache.size()); i++) {
+        CachedEqualitySet& cached = cache[i];
+        if (cached.hash == hash && cached.equalitySet->presets == config.equalityPresets
+            && static_cast<int>(cached.pairs.size()) == numPairs
+            && (numPairs == 0 || memcmp(cached.pairs.data(), config.additionalEqualities,
+                                        sizeof(EdlibEqualityPair) * numPairs) == 0)) {
+            // Move to front, so least recently used sets are evicted first.
+            rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+            return cache[0].equalitySet;
+        }
+    }
+
+    if (static_cast<int>(cache.size()) == CACHE_SIZE) cache.pop_back();
+    CachedEqualitySet cached;
+    cached.hash = hash;
+    cached.pairs.assign(config.additionalEqualities, config.additionalEqualities + numPairs);
+    cached.equalitySet.reset(new EdlibEqualitySet(config.additionalEqualities, numPairs, config.equalityPresets));
+    cache.insert(cache.begin(), std::move(cached));
+    return cache[0].equalitySet;
+}
+
+/**
+ * Defines equality relation on alphabet characters, as one bitmask of equal symbols per alphabet symbol.
+ * By default each character is always equal only to itself, but you can also provide equality set
+ * which extends that definition.
+ */
+class EqualityDefinition {
+private:
+    // masks[a] contains b if alphabet symbols a and b are equal.
+    vector<CharMask> masks;
+public:
+    EqualityDefinition(const string& alphabet, const EdlibEqualitySet* const equalities) {
+        const int alphabetLength = static_cast<int>(alphabet.size());
+        masks.assign(alphabetLength, CharMask());
+        for (int i = 0; i < alphabetLength; i++) {
+            masks[i].add(static_cast<unsigned char>(i));
+            if (equalities == NULL) continue;
+            const CharMask& charMask = equalities->masks[static_cast<unsigned char>(alphabet[i])];
+            for (int j = 0; j < alphabetLength; j++) {
+                if (charMask.contains(static_cast<unsigned char>(alphabet[j]))) {
+                    masks[i].add(static_cast<unsigned char>(j));
                 }
             }
         }
@@ -86,35 +283,444 @@ public:
      * @return True if a and b are defined as equal, false otherwise.
      */
     bool areEqual(unsigned char a, unsigned char b) const {
-        return matrix[a][b];
+        return masks[a].contains(b);
+    }
+
+    /**
+     * @param a  Element from transformed sequence.
+     * @return Mask of all elements that are equal to a.
+     */
+    const CharMask& equalTo(unsigned char a) const {
+        return masks[a];
+    }
+};
+
+/**
+ * Alphabet of packed DNA sequences: index of each character is its 2-bit code, N is used for masked positions.
+ */
+static const char PACKED_ALPHABET[] = "ACGTN";
+static const unsigned char PACKED_N = 4;
+
+/**
+ * Read-only view of 2-bit packed DNA sequence (see EdlibPackedSequence),
+ * which extracts symbols directly from packed bytes.
+ * Symbols are indexes into PACKED_ALPHABET.
+ * Lookup of N intervals is amortized O(1) when positions are accessed in order (forward or backward).
+ */
+class PackedSequence {
+private:
+    const unsigned char* data;
+    const EdlibInterval* nIntervals;
+    int nIntervalsLength;
+    mutable int interval; // Index of first N interval that ends after last accessed position.
+public:
+    explicit PackedSequence(const EdlibPackedSequence& seq)
+        : data(seq.data), nIntervals(seq.nIntervals),
+          nIntervalsLength(seq.nIntervals == NULL ? 0 : seq.nIntervalsLength), interval(0) {}
+
+    unsigned char operator[](const int i) const {
+        while (interval < nIntervalsLength && nIntervals[interval].end <= i) interval++;
+        while (interval > 0 && nIntervals[interval - 1].end > i) interval--;
+        if (interval < nIntervalsLength && nIntervals[interval].start <= i) return PACKED_N;
+        return (data[i >> 2] >> ((i & 3) << 1)) & 3;
+    }
+
+    /**
+     * @return End (exclusive) of run of same symbols that starts at position i. Only runs of N are detected,
+     *         for other symbols i + 1 is returned.
+     */
+    int runEnd(const int i, const int) const {
+        if ((*this)[i] == PACKED_N) return nIntervals[interval].end;
+        return i + 1;
+    }
+};
+
+/**
+ * @return True if N intervals of packed sequence are inside of sequence, sorted and not overlapping.
+ */
+static inline bool isValidPackedSequence(const EdlibPackedSequence& seq) {
+    if (seq.length < 0 || (seq.length > 0 && seq.data == NULL)) return false;
+    if (seq.nIntervals == NULL) return true;
+    int previousEnd = 0;
+    for (int i = 0; i < seq.nIntervalsLength; i++) {
+        const EdlibInterval interval = seq.nIntervals[i];
+        if (interval.start < previousEnd || interval.end < interval.start || interval.end > seq.length) {
+            return false;
+        }
+        previousEnd = interval.end;
+    }
+    return true;
+}
+
+/**
+ * Read-only view of original sequence, which maps each character to its alphabet symbol on access.
+ */
+class MappedSequence {
+private:
+    const unsigned char* seq;
+    const unsigned char* symbols;
+public:
+    /**
+     * @param seq_  Original sequence.
+     * @param symbols_  Array of length 256, symbols_[c] is alphabet symbol of character c.
+     */
+    MappedSequence(const char* const seq_, const unsigned char* const symbols_)
+        : seq(reinterpret_cast<const unsigned char*>(seq_)), symbols(symbols_) {}
+
+    unsigned char operator[](const int i) const {
+        return symbols[seq[i]];
+    }
+
+    /**
+     * @return End (exclusive) of run of characters with the same symbol that starts at position i, at most length.
+     *         Since all characters that match nothing in query share one symbol, that covers runs of
+     *         different foreign characters too (e.g. NNRNN when R is not in query).
+     */
+    int runEnd(const int i, const int length) const {
+        const unsigned char c = seq[i];
+        const unsigned char symbol = symbols[c];
+        const uint64_t pattern = static_cast<uint64_t>(c) * 0x0101010101010101ULL;
+        int j = i + 1;
+        // Run of one character is compared 8 characters at once, then 8 symbols are looked up at once,
+        // and first different one is found character by character.
+        while (j + 8 <= length) {
+            uint64_t chunk;
+            memcpy(&chunk, seq + j, sizeof(chunk));
+            if (chunk != pattern) break;
+            j += 8;
+        }
+        while (j + 8 <= length) {
+            const unsigned char* const chunk = seq + j;
+            const int different = (symbols[chunk[0]] ^ symbol) | (symbols[chunk[1]] ^ symbol)
+                | (symbols[chunk[2]] ^ symbol) | (symbols[chunk[3]] ^ symbol)
+                | (symbols[chunk[4]] ^ symbol) | (symbols[chunk[5]] ^ symbol)
+                | (symbols[chunk[6]] ^ symbol) | (symbols[chunk[7]] ^ symbol);
+            if (different) break;
+            j += 8;
+        }
+        while (j < length && symbols[seq[j]] == symbol) j++;
+        return j;
+    }
+};
+
+/**
+ * View of sequence in reverse: element i is element (last - i) of original sequence.
+ */
+template <class Sequence>
+class ReversedSequence {
+private:
+    Sequence seq;
+    int last;
+public:
+    ReversedSequence(const Sequence& seq_, const int last_) : seq(seq_), last(last_) {}
+
+    unsigned char operator[](const int i) const {
+        return seq[last - i];
+    }
+
+    /**
+     * Runs are not detected in reversed sequences, so this always returns i + 1.
+     */
+    int runEnd(const int i, const int) const {
+        return i + 1;
+    }
+};
+
+/**
+ * View of part of sequence: element i is element (offset + i) of original sequence.
+ */
+template <class Sequence>
+class OffsetSequence {
+private:
+    Sequence seq;
+    int offset;
+public:
+    OffsetSequence(const Sequence& seq_, const int offset_) : seq(seq_), offset(offset_) {}
+
+    unsigned char operator[](const int i) const {
+        return seq[offset + i];
+    }
+
+    int runEnd(const int i, const int length) const {
+        return seq.runEnd(offset + i, offset + length) - offset;
+    }
+};
+
+// Flag that edlibCancel() sets, and alignments that use token poll.
+struct EdlibCancellationToken {
+    atomic<bool> cancelled;
+
+    EdlibCancellationToken() : cancelled(false) {}
+};
+
+class ResultScratch;
+
+// Scratch that arrays of results computed on this thread are taken from, NULL if they are allocated with malloc().
+static thread_local ResultScratch* resultScratch = NULL;
+
+/**
+ * Memory for arrays of results that are stored into result arena as soon as they are computed, so that batches
+ * aligned into arena do not allocate arrays of each result. While scratch exists, it is used by its thread:
+ * arrays are taken from its chunks, which are kept and reused for next results once reset() is called.
+ */
+class ResultScratch {
+private:
+    static const size_t CHUNK_WORDS = 1 << 15;
+
+    ResultScratch* previous;
+    vector< vector<uint64_t> > chunks;
+    size_t chunk;  // Chunk that arrays are taken from.
+    size_t used;  // Number of words of chunk that are taken.
+
+public:
+    ResultScratch() : previous(resultScratch), chunk(0), used(0) {
+        resultScratch = this;
+    }
+
+    ~ResultScratch() {
+        resultScratch = previous;
+    }
+
+    void* allocate(const size_t size) {
+        const size_t words = max<size_t>(1, (size + 7) / 8);  // Each array has its own address.
+        while (chunk < chunks.size() && used + words > chunks[chunk].size()) {
+            chunk++;
+            used = 0;
+        }
+        if (chunk == chunks.size()) chunks.push_back(vector<uint64_t>(max(words, static_cast<size_t>(CHUNK_WORDS))));
+        void* const array = chunks[chunk].data() + used;
+        used += words;
+        return array;
+    }
+
+    bool owns(const void* const array) const {
+        const uint64_t* const word = static_cast<const uint64_t*>(array);
+        for (const vector<uint64_t>& c : chunks) {
+            if (word >= c.data() && word < c.data() + c.size()) return true;
+        }
+        return false;
+    }
+
+    /**
+     * Makes all chunks available again, arrays taken so far must not be used anymore.
+     */
+    void reset() {
+        chunk = used = 0;
+    }
+};
+
+/**
+ * Allocates array of result, which is freed with freeResultArray().
+ */
+template <class T>
+static inline T* allocateResultArray(const size_t numElements) {
+    const size_t size = sizeof(T) * numElements;
+    return static_cast<T*>(resultScratch != NULL ? resultScratch->allocate(size) : malloc(size));
+}
+
+/**
+ * Frees array of result, unless it was taken from scratch of this thread (then it is reused on reset).
+ */
+static inline void freeResultArray(void* const array) {
+    if (array != NULL && (resultScratch == NULL || !resultScratch->owns(array))) free(array);
+}
+
+/**
+ * Reports progress of alignment to progress callback. Progress is measured in units of work
+ * (usually columns) done in current phase, which scans add concurrently.
+ */
+class ProgressReporter {
+private:
+    EdlibProgressCallback callback;
+    void* context;
+    long long intervalNs;
+    atomic<long long> nextReportNs;  // Time (since epoch of steady clock) of next report.
+    mutex reportMutex;  // Ensures that callback is not called concurrently.
+    atomic<bool> cancelRequested;
+
+    // Phase is changed only while there are no scans.
+    EdlibProgress progress;
+    long long totalWork;
+    bool scansAreWork;  // If false, columns of scans are not counted as work.
+    atomic<long long> doneWork;
+
+    static long long nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    static const int DEFAULT_INTERVAL_MS = 100;  // Used if EdlibAlignConfig.progressIntervalMs is not positive.
+
+    ProgressReporter(const EdlibProgressCallback callback_, void* const context_, const int intervalMs)
+        : callback(callback_), context(context_),
+          intervalNs((intervalMs > 0 ? intervalMs : DEFAULT_INTERVAL_MS) * 1000000ll),
+          nextReportNs(nowNs() + intervalNs), cancelRequested(false), totalWork(0), scansAreWork(true),
+          doneWork(0) {
+        progress.phase = EDLIB_PHASE_DISTANCE;
+        progress.round = progress.k = 0;
+        progress.fraction = 0;
+    }
+
+    /**
+     * Starts new phase (or round of phase), with no work done.
+     * @param [in] scansAreWork_  If false, work is counted only with advance().
+     */
+    void startPhase(const EdlibAlignPhase phase, const int round, const int k, const long long totalWork_,
+                    const bool scansAreWork_) {
+        progress.phase = phase;
+        progress.round = round;
+        progress.k = k;
+        totalWork = totalWork_;
+        scansAreWork = scansAreWork_;
+        doneWork.store(0);
+    }
+
+    void enterLevel() { progress.round++; }
+    void leaveLevel() { progress.round--; }
+
+    /**
+     * Counts columns computed by scan, and reports progress if it is time for it.
+     */
+    void scanned(const long long columns) {
+        advance(scansAreWork ? columns : 0);
+    }
+
+    /**
+     * Counts done work, and reports progress if it is time for it.
+     */
+    void advance(const long long work) {
+        if (work > 0) doneWork.fetch_add(work, memory_order_relaxed);
+        const long long now = nowNs();
+        if (now < nextReportNs.load(memory_order_relaxed) || !reportMutex.try_lock()) return;
+        if (now >= nextReportNs.load(memory_order_relaxed) && !cancelRequested.load()) {
+            EdlibProgress current = progress;
+            current.fraction = totalWork > 0 ? min(1.0, static_cast<double>(doneWork.load()) / totalWork) : 0;
+            // Results that callback computes are its own, so they are not taken from scratch.
+            ResultScratch* const scratch = resultScratch;
+            resultScratch = NULL;
+            if (callback(&current, context) != 0) {
+                cancelRequested.store(true);
+            }
+            resultScratch = scratch;
+            nextReportNs.store(nowNs() + intervalNs, memory_order_relaxed);
+        }
+        reportMutex.unlock();
+    }
+
+    bool isCancelRequested() const {
+        return cancelRequested.load(memory_order_relaxed);
+    }
+};
+
+/**
+ * State shared by scans that run concurrently as parts of one alignment.
+ */
+struct ScanControl {
+    // Each scan reads shared state every PERIOD columns.
+    static const int PERIOD = 1024;
+
+    // Lowest score found so far by any of scans. Scans use it to tighten their k,
+    // since scores worse than it can not be part of result.
+    atomic<int> k;
+    // If set, scans stop as soon as they notice it, without result.
+    // It is also set once cancellation from outside (token or deadline) is noticed.
+    mutable atomic<bool> cancelled;
+    // Control of scan that this scan is part of, it is cancelled together with it. NULL if there is none.
+    const ScanControl* parent;
+    // Cancels scan from outside of edlib, NULL if there is none.
+    const EdlibCancellationToken* token;
+    // Scan is cancelled once deadline is reached, if hasDeadline.
+    bool hasDeadline;
+    chrono::steady_clock::time_point deadline;
+    // Progress of scan is reported to it, NULL if there is none. Same as parent's.
+    ProgressReporter* progress;
+
+    explicit ScanControl(const int k_, const ScanControl* const parent_ = NULL)
+        : k(k_), cancelled(false), parent(parent_), token(NULL), hasDeadline(false),
+          progress(parent_ != NULL ? parent_->progress : NULL) {}
+
+    void tightenK(const int score) {
+        int current = k.load();
+        while (score < current && !k.compare_exchange_weak(current, score)) {}
+    }
+
+    void cancel() const {
+        cancelled.store(true, memory_order_relaxed);
+    }
+
+    bool isCancelled() const {
+        if (cancelled.load(memory_order_relaxed)) return true;
+        if ((token != NULL && token->cancelled.load(memory_order_relaxed))
+            || (progress != NULL && progress->isCancelRequested())
+            || (hasDeadline && chrono::steady_clock::now() >= deadline)
+            || (parent != NULL && parent->isCancelled())) {
+            cancel();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Called by scans every PERIOD columns.
+     * @param [in] columns  Number of columns computed since last call.
+     * @return True if scan is cancelled.
+     */
+    bool poll(const long long columns) const {
+        if (progress != NULL) progress->scanned(columns);
+        return isCancelled();
     }
 };
 
+template <class TargetSequence>
 static int myersCalcEditDistanceSemiGlobal(const Word* Peq, int W, int maxNumBlocks,
                                            int queryLength,
-                                           const unsigned char* target, int targetLength,
+                                           TargetSequence target, int targetLength,
                                            int k, EdlibAlignMode mode,
-                                           int* bestScore_, int** positions_, int* numPositions_);
-
+                                           int* bestScore_, int** positions_, int* numPositions_,
+                                           ScanControl* control = NULL);
+
+template <class TargetSequence>
+static int myersCalcEditDistanceSemiGlobalParallel(const Word* Peq, int W, int maxNumBlocks,
+                                                   int queryLength,
+                                                   TargetSequence target, int targetLength,
+                                                   int k, int numThreads, const EdlibExecutor* executor,
+                                                   int* bestScore_, int** positions_, int* numPositions_,
+                                                   const ScanControl* control);
+
+template <class TargetSequence>
 static int myersCalcEditDistanceNW(const Word* Peq, int W, int maxNumBlocks,
                                    int queryLength,
-                                   const unsigned char* target, int targetLength,
+                                   TargetSequence target, int targetLength,
                                    int k, int* bestScore_,
                                    int* position_, bool findAlignment,
-                                   AlignmentData** alignData, int targetStopPosition);
+                                   AlignmentData** alignData, int targetStopPosition,
+                                   const ScanControl* control = NULL);
+
+template <class TargetSequence>
+static int myersCalcEditDistanceNWPipelined(const Word* Peq, int W, int maxNumBlocks,
+                                            int queryLength,
+                                            TargetSequence target, int targetLength,
+                                            int k, int numThreads, const EdlibExecutor* executor,
+                                            int* bestScore_, int* position_,
+                                            const ScanControl* control);
+
+static void runInParallel(int numTasks, const function<void(int)>& task, const EdlibExecutor* executor,
+                          bool concurrently);
+
+static int resolveNumThreads(int numThreads);
 
 
 static int obtainAlignment(
         const unsigned char* query, const unsigned char* rQuery, int queryLength,
         const unsigned char* target, const unsigned char* rTarget, int targetLength,
         const EqualityDefinition& equalityDefinition, int alphabetLength, int bestScore,
-        unsigned char** alignment, int* alignmentLength);
+        unsigned char** alignment, int* alignmentLength, const ScanControl* control);
 
 static int obtainAlignmentHirschberg(
         const unsigned char* query, const unsigned char* rQuery, int queryLength,
         const unsigned char* target, const unsigned char* rTarget, int targetLength,
         const EqualityDefinition& equalityDefinition, int alphabetLength, int bestScore,
-        unsigned char** alignment, int* alignmentLength);
+        unsigned char** alignment, int* alignmentLength, const ScanControl* control);
 
 static int obtainAlignmentTraceback(int queryLength, int targetLength,
                                     int bestScore, const AlignmentData* alignData,
@@ -122,13 +728,32 @@ static int obtainAlignmentTraceback(int queryLength, int targetLength,
 
 static string transformSequences(const char* queryOriginal, int queryLength,
                                  const char* targetOriginal, int targetLength,
+                                 const EdlibEqualitySet* equalities,
                                  unsigned char** queryTransformed,
-                                 unsigned char** targetTransformed);
+                                 unsigned char* targetSymbols,
+                                 int* numDistinctChars);
+
+template <class TargetSequence>
+static EdlibAlignResult alignTransformed(const unsigned char* query, int queryLength,
+                                         TargetSequence target, int targetLength,
+                                         const string& alphabet, const EdlibEqualitySet* equalities,
+                                         const EdlibAlignConfig& config, const Word* prebuiltPeq = NULL);
 
 static inline int ceilDiv(int x, int y);
 
+static inline int countTrailingZeros(Word x);
+
+static inline int countOnes(Word x);
+
 static inline unsigned char* createReverseCopy(const unsigned char* seq, int length);
 
+static inline const unsigned char* contiguousRange(const unsigned char* seq, int start, int length,
+                                                   vector<unsigned char>& buffer);
+
+template <class Sequence>
+static inline const unsigned char* contiguousRange(const Sequence& seq, int start, int length,
+                                                   vector<unsigned char>& buffer);
+
 static inline Word* buildPeq(const int alphabetLength,
                              const unsigned char* query,
                              const int queryLength,
@@ -141,6 +766,109 @@ static inline Word* buildPeq(const int alphabetLength,
 extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const int queryLength,
                                        const char* const targetOriginal, const int targetLength,
                                        const EdlibAlignConfig config) {
+    /*------------ TRANSFORM SEQUENCES AND RECOGNIZE ALPHABET -----------*/
+    unsigned char* query;
+    unsigned char targetSymbols[MAX_UCHAR + 1];
+    int numDistinctChars;
+    const shared_ptr<const EdlibEqualitySet> equalities = configEqualitySet(config);
+    string alphabet = transformSequences(queryOriginal, queryLength, targetOriginal, targetLength,
+                                         equalities.get(), &query, targetSymbols, &numDistinctChars);
+    /*-------------------------------------------------------*/
+
+    // Target is not transformed, its characters are mapped to symbols while it is scanned.
+    EdlibAlignResult result = alignTransformed(query, queryLength,
+                                               MappedSequence(targetOriginal, targetSymbols), targetLength,
+                                               alphabet, equalities.get(), config);
+    result.alphabetLength = numDistinctChars;
+    free(query);
+    return result;
+}
+
+extern "C" EdlibAlignResult edlibAlignPacked(const EdlibPackedSequence query, const EdlibPackedSequence target,
+                                             const EdlibAlignConfig config) {
+    if (!isValidPackedSequence(query) || !isValidPackedSequence(target)) {
+        EdlibAlignResult result;
+        result.status = EDLIB_STATUS_ERROR;
+        result.editDistance = -1;
+        result.endLocations = result.startLocations = NULL;
+        result.numLocations = 0;
+        result.alignment = NULL;
+        result.alignmentLength = 0;
+        result.alphabetLength = 0;
+        return result;
+    }
+
+    // Query is unpacked since it is needed only to build Peq, while target is read directly from packed data.
+    const PackedSequence packedQuery(query);
+    unsigned char* queryTransformed = static_cast<unsigned char *>(malloc(sizeof(unsigned char) * query.length));
+    for (int i = 0; i < query.length; i++) {
+        queryTransformed[i] = packedQuery[i];
+    }
+
+    EdlibAlignResult result = alignTransformed(queryTransformed, query.length,
+                                               PackedSequence(target), target.length,
+                                               string(PACKED_ALPHABET), configEqualitySet(config).get(), config);
+    if ((query.nIntervals == NULL || query.nIntervalsLength == 0)
+        && (target.nIntervals == NULL || target.nIntervalsLength == 0)) {
+        result.alphabetLength = PACKED_N;  // There can be no N.
+    }
+    free(queryTransformed);
+    return result;
+}
+
+struct EdlibQueryProfile {
+    int queryLength;
+    int maxNumBlocks;
+    int W;  // Number of redundant cells in last level blocks.
+    // symbols[c] is alphabet symbol of target character c.
+    unsigned char symbols[MAX_UCHAR + 1];
+    Word* Peq;
+};
+
+extern "C" EdlibQueryProfile* edlibNewQueryProfile(const char* const query, const int queryLength,
+                                                   const EdlibAlignConfig config) {
+    // Target is not known yet, so alphabet is built as if target contained all characters.
+    char allChars[MAX_UCHAR + 1];
+    for (int c = 0; c <= MAX_UCHAR; c++) allChars[c] = static_cast<char>(c);
+
+    EdlibQueryProfile* profile = new EdlibQueryProfile();
+    const shared_ptr<const EdlibEqualitySet> equalities = configEqualitySet(config);
+    unsigned char* queryTransformed;
+    int numDistinctChars;
+    const string alphabet = transformSequences(query, queryLength, allChars, MAX_UCHAR + 1, equalities.get(),
+                                               &queryTransformed, profile->symbols, &numDistinctChars);
+    profile->queryLength = queryLength;
+    profile->maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
+    profile->W = profile->maxNumBlocks * WORD_SIZE - queryLength;
+    profile->Peq = buildPeq(static_cast<int>(alphabet.size()), queryTransformed, queryLength,
+                            EqualityDefinition(alphabet, equalities.get()));
+    free(queryTransformed);
+    return profile;
+}
+
+extern "C" void edlibFreeQueryProfile(EdlibQueryProfile* const profile) {
+    delete[] profile->Peq;
+    delete profile;
+}
+
+/**
+ * Aligns already transformed query and target (see transformSequences()).
+ * Target can be any sequence whose elements are accessed with operator[], which allows
+ * computation directly on special representations of target, like packed one.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] alphabet  Alphabet which was used to transform query and target.
+ * @param [in] equalities  Equality set that extends equality, NULL if there is none.
+ * @param [in] config
+ * @return Result of alignment, as described for edlibAlign().
+ */
+template <class TargetSequence>
+static EdlibAlignResult alignTransformed(const unsigned char* const query, const int queryLength,
+                                         const TargetSequence target, const int targetLength,
+                                         const string& alphabet, const EdlibEqualitySet* const equalities,
+                                         const EdlibAlignConfig& config, const Word* const prebuiltPeq) {
     EdlibAlignResult result;
     result.status = EDLIB_STATUS_OK;
     result.editDistance = -1;
@@ -148,41 +876,57 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
     result.numLocations = 0;
     result.alignment = NULL;
     result.alignmentLength = 0;
-    result.alphabetLength = 0;
-
-    /*------------ TRANSFORM SEQUENCES AND RECOGNIZE ALPHABET -----------*/
-    unsigned char* query, * target;
-    string alphabet = transformSequences(queryOriginal, queryLength, targetOriginal, targetLength,
-                                         &query, &target);
     result.alphabetLength = static_cast<int>(alphabet.size());
-    /*-------------------------------------------------------*/
-
     // Handle special situation when at least one of the sequences has length 0.
     if (queryLength == 0 || targetLength == 0) {
         if (config.mode == EDLIB_MODE_NW) {
             result.editDistance = std::max(queryLength, targetLength);
-            result.endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
+            result.endLocations = allocateResultArray<int>(1);
             result.endLocations[0] = targetLength - 1;
             result.numLocations = 1;
         } else if (config.mode == EDLIB_MODE_SHW || config.mode == EDLIB_MODE_HW) {
             result.editDistance = queryLength;
-            result.endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
+            result.endLocations = allocateResultArray<int>(1);
             result.endLocations[0] = -1;
             result.numLocations = 1;
         } else {
             result.status = EDLIB_STATUS_ERROR;
         }
 
-        free(query);
-        free(target);
         return result;
     }
 
     /*--------------------- INITIALIZATION ------------------*/
     int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE); // bmax in Myers
     int W = maxNumBlocks * WORD_SIZE - queryLength; // number of redundant cells in last level blocks
-    EqualityDefinition equalityDefinition(alphabet, config.additionalEqualities, config.additionalEqualitiesLength);
-    Word* Peq = buildPeq(static_cast<int>(alphabet.size()), query, queryLength, equalityDefinition);
+    EqualityDefinition equalityDefinition(alphabet, equalities);
+    // Peq is built here unless caller already has it (built for the same alphabet).
+    Word* const ownPeq = prebuiltPeq ? NULL
+                                     : buildPeq(static_cast<int>(alphabet.size()), query, queryLength,
+                                                equalityDefinition);
+    const Word* const Peq = prebuiltPeq ? prebuiltPeq : ownPeq;
+
+    // Control through which alignment is cancelled from outside and reports its progress.
+    // There is none if alignment can not be cancelled and is not reported, so then there is no checking at all.
+    unique_ptr<ProgressReporter> progress;
+    if (config.progressCallback != NULL) {
+        progress.reset(new ProgressReporter(config.progressCallback, config.progressContext,
+                                            config.progressIntervalMs));
+    }
+    unique_ptr<ScanControl> cancellation;
+    if (config.cancellationToken != NULL || config.timeoutMs > 0 || progress) {
+        cancellation.reset(new ScanControl(INT_MAX));
+        cancellation->progress = progress.get();
+        cancellation->token = config.cancellationToken;
+        if (config.timeoutMs > 0) {
+            cancellation->hasDeadline = true;
+            cancellation->deadline = chrono::steady_clock::now() + chrono::milliseconds(config.timeoutMs);
+        }
+    }
+    const ScanControl* const cancellationControl = cancellation.get();
+    auto isCancelled = [&]() {
+        return cancellationControl != NULL && cancellationControl->isCancelled();
+    };
     /*-------------------------------------------------------*/
 
     /*------------------ MAIN CALCULATION -------------------*/
@@ -196,37 +940,126 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
         k = WORD_SIZE; // Gives better results than smaller k.
     }
 
-    do {
-        if (config.mode == EDLIB_MODE_HW || config.mode == EDLIB_MODE_SHW) {
+    // Computes edit distance with given k (one round of dynamic k).
+    // Each round gets its own roundAlignData, since rounds may run concurrently.
+    auto computeWithK = [&](const int roundK, ScanControl* const control, int* const editDistance,
+                            int** const endLocations, int* const numLocations, int* const position,
+                            AlignmentData** const roundAlignData) {
+        if (config.mode == EDLIB_MODE_HW && resolveNumThreads(config.numThreads) != 1) {
+            myersCalcEditDistanceSemiGlobalParallel(Peq, W, maxNumBlocks,
+                                                    queryLength, target, targetLength,
+                                                    roundK, config.numThreads, config.executor, editDistance,
+                                                    endLocations, numLocations, control);
+        } else if (config.mode == EDLIB_MODE_HW || config.mode == EDLIB_MODE_SHW) {
             myersCalcEditDistanceSemiGlobal(Peq, W, maxNumBlocks,
                                             queryLength, target, targetLength,
-                                            k, config.mode, &(result.editDistance),
-                                            &(result.endLocations), &(result.numLocations));
+                                            roundK, config.mode, editDistance,
+                                            endLocations, numLocations, control);
+        } else if (resolveNumThreads(config.numThreads) != 1) {  // mode == EDLIB_MODE_NW
+            myersCalcEditDistanceNWPipelined(Peq, W, maxNumBlocks,
+                                             queryLength, target, targetLength,
+                                             roundK, config.numThreads, config.executor, editDistance, position,
+                                             control);
         } else {  // mode == EDLIB_MODE_NW
             myersCalcEditDistanceNW(Peq, W, maxNumBlocks,
                                     queryLength, target, targetLength,
-                                    k, &(result.editDistance), &positionNW,
-                                    false, &alignData, -1);
+                                    roundK, editDistance, position,
+                                    false, roundAlignData, -1, control);
+        }
+    };
+
+    if (dynamicK && config.speculativeRounds > 1) {
+        // Several rounds are computed concurrently. All rounds that find solution find the same one,
+        // so as soon as one of them does, others are cancelled.
+        const int maxK = max(queryLength, targetLength);  // Solution is certainly found with this k.
+        bool maxKReached = false;
+        int numRounds = 0;
+        while (result.editDistance == -1 && !maxKReached && !isCancelled()) {
+            vector<int> roundKs;
+            for (int i = 0; i < config.speculativeRounds && !maxKReached; i++) {
+                roundKs.push_back(k);
+                maxKReached = k >= maxK;
+                k = k > maxK / 2 ? maxK : k * 2;
+            }
+            if (progress) {
+                progress->startPhase(EDLIB_PHASE_DISTANCE, numRounds, roundKs[0],
+                                     static_cast<long long>(targetLength) * roundKs.size(), true);
+            }
+            numRounds += static_cast<int>(roundKs.size());
+
+            struct RoundResult {
+                int editDistance;
+                int* endLocations;
+                int numLocations;
+                int position;
+                AlignmentData* alignData;
+            };
+            vector<RoundResult> rounds(roundKs.size());
+            ScanControl control(INT_MAX, cancellationControl);
+            atomic<int> solvedRound(-1);
+            runInParallel(static_cast<int>(roundKs.size()), [&](const int i) {
+                RoundResult& round = rounds[i];
+                round.endLocations = NULL;
+                round.numLocations = 0;
+                round.alignData = NULL;
+                computeWithK(roundKs[i], &control, &round.editDistance,
+                             &round.endLocations, &round.numLocations, &round.position, &round.alignData);
+                int noRound = -1;
+                if (round.editDistance != -1 && solvedRound.compare_exchange_strong(noRound, i)) {
+                    control.cancel();
+                }
+            }, config.executor, false);
+
+            for (int i = 0; i < static_cast<int>(rounds.size()); i++) {
+                if (i == solvedRound.load()) {
+                    result.editDistance = rounds[i].editDistance;
+                    result.endLocations = rounds[i].endLocations;
+                    result.numLocations = rounds[i].numLocations;
+                    positionNW = rounds[i].position;
+                    delete alignData;
+                    alignData = rounds[i].alignData;
+                } else {
+                    freeResultArray(rounds[i].endLocations);
+                    delete rounds[i].alignData;
+                }
+            }
         }
-        k *= 2;
-    } while(dynamicK && result.editDistance == -1);
+    } else {
+        int round = 0;
+        do {
+            if (progress) progress->startPhase(EDLIB_PHASE_DISTANCE, round++, k, targetLength, true);
+            computeWithK(k, cancellation.get(), &(result.editDistance), &(result.endLocations),
+                         &(result.numLocations), &positionNW, &alignData);
+            k *= 2;
+        } while(dynamicK && result.editDistance == -1 && !isCancelled());
+    }
+
+    if (result.editDistance == -1 && isCancelled()) {
+        result.status = EDLIB_STATUS_CANCELLED;
+    }
 
     if (result.editDistance >= 0) {  // If there is solution.
         // If NW mode, set end location explicitly.
         if (config.mode == EDLIB_MODE_NW) {
-            result.endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
+            result.endLocations = allocateResultArray<int>(1);
             result.endLocations[0] = targetLength - 1;
             result.numLocations = 1;
         }
 
         // Find starting locations.
         if (config.task == EDLIB_TASK_LOC || config.task == EDLIB_TASK_PATH) {
-            result.startLocations = static_cast<int *>(malloc(result.numLocations * sizeof(int)));
+            result.startLocations = allocateResultArray<int>(result.numLocations);
             if (config.mode == EDLIB_MODE_HW) {  // If HW, I need to calculate start locations.
-                const unsigned char* rTarget = createReverseCopy(target, targetLength);
                 const unsigned char* rQuery  = createReverseCopy(query, queryLength);
                 // Peq for reversed query.
                 Word* rPeq = buildPeq(static_cast<int>(alphabet.size()), rQuery, queryLength, equalityDefinition);
+                if (progress) {
+                    long long totalWork = 0;
+                    for (int i = 0; i < result.numLocations; i++) {
+                        totalWork += result.endLocations[i] + 1;
+                    }
+                    progress->startPhase(EDLIB_PHASE_START_LOCATIONS, 0, result.editDistance, totalWork, true);
+                }
                 for (int i = 0; i < result.numLocations; i++) {
                     int endLocation = result.endLocations[i];
                     if (endLocation == -1) {
@@ -247,16 +1080,21 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
                         int* positionsSHW;
                         myersCalcEditDistanceSemiGlobal(
                                 rPeq, W, maxNumBlocks,
-                                queryLength, rTarget + targetLength - endLocation - 1, endLocation + 1,
+                                queryLength, ReversedSequence<TargetSequence>(target, endLocation), endLocation + 1,
                                 result.editDistance, EDLIB_MODE_SHW,
-                                &bestScoreSHW, &positionsSHW, &numPositionsSHW);
+                                &bestScoreSHW, &positionsSHW, &numPositionsSHW, cancellation.get());
+                        if (bestScoreSHW == -1) {  // Computation was cancelled.
+                            freeResultArray(result.startLocations);
+                            result.startLocations = NULL;
+                            result.status = EDLIB_STATUS_CANCELLED;
+                            break;
+                        }
                         // Taking last location as start ensures that alignment will not start with insertions
                         // if it can start with mismatches instead.
                         result.startLocations[i] = endLocation - positionsSHW[numPositionsSHW - 1];
-                        free(positionsSHW);
+                        freeResultArray(positionsSHW);
                     }
                 }
-                delete[] rTarget;
                 delete[] rQuery;
                 delete[] rPeq;
             } else {  // If mode is SHW or NW
@@ -268,17 +1106,30 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
 
         // Find alignment -> all comes down to finding alignment for NW.
         // Currently we return alignment only for first pair of locations.
-        if (config.task == EDLIB_TASK_PATH) {
+        if (config.task == EDLIB_TASK_PATH && result.status == EDLIB_STATUS_OK) {
             int alnStartLocation = result.startLocations[0];
             int alnEndLocation = result.endLocations[0];
-            const unsigned char* alnTarget = target + alnStartLocation;
             const int alnTargetLength = alnEndLocation - alnStartLocation + 1;
+            vector<unsigned char> alnTargetBuffer;
+            const unsigned char* alnTarget = contiguousRange(target, alnStartLocation, alnTargetLength,
+                                                             alnTargetBuffer);
             const unsigned char* rAlnTarget = createReverseCopy(alnTarget, alnTargetLength);
             const unsigned char* rQuery  = createReverseCopy(query, queryLength);
-            obtainAlignment(query, rQuery, queryLength,
-                            alnTarget, rAlnTarget, alnTargetLength,
-                            equalityDefinition, static_cast<int>(alphabet.size()), result.editDistance,
-                            &(result.alignment), &(result.alignmentLength));
+            // Work of alignment is measured by columns of target whose alignment is completed.
+            if (progress) {
+                progress->startPhase(EDLIB_PHASE_ALIGNMENT, 0, result.editDistance, alnTargetLength, false);
+            }
+            const int statusCode = obtainAlignment(query, rQuery, queryLength,
+                                                   alnTarget, rAlnTarget, alnTargetLength,
+                                                   equalityDefinition, static_cast<int>(alphabet.size()),
+                                                   result.editDistance,
+                                                   &(result.alignment), &(result.alignmentLength),
+                                                   cancellationControl);
+            if (statusCode == EDLIB_STATUS_CANCELLED) {
+                result.status = EDLIB_STATUS_CANCELLED;
+                result.alignment = NULL;
+                result.alignmentLength = 0;
+            }
             delete[] rAlnTarget;
             delete[] rQuery;
         }
@@ -286,19 +1137,21 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
     /*-------------------------------------------------------*/
 
     //--- Free memory ---//
-    delete[] Peq;
-    free(query);
-    free(target);
+    delete[] ownPeq;
     if (alignData) delete alignData;
     //-------------------//
 
     return result;
 }
 
-extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, const int alignmentLength,
-                                       const EdlibCigarFormat cigarFormat) {
+/**
+ * Appends cigar of alignment (see edlibAlignmentToCigar()), with terminating zero, to the end of cigar.
+ * @return False if format or alignment is not valid, then cigar is not changed.
+ */
+static bool appendCigar(const unsigned char* const alignment, const int alignmentLength,
+                        const EdlibCigarFormat cigarFormat, vector<char>* const cigar) {
     if (cigarFormat != EDLIB_CIGAR_EXTENDED && cigarFormat != EDLIB_CIGAR_STANDARD) {
-        return 0;
+        return false;
     }
 
     // Maps move code from alignment to char in cigar.
@@ -308,7 +1161,7 @@ extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, con
         moveCodeToChar[0] = moveCodeToChar[3] = 'M';
     }
 
-    vector<char>* cigar = new vector<char>();
+    const size_t cigarStart = cigar->size();
     char lastMove = 0;  // Char of last move. 0 if there was no previous move.
     int numOfSameMoves = 0;
     for (int i = 0; i <= alignmentLength; i++) {
@@ -327,8 +1180,8 @@ extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, con
             if (i < alignmentLength) {
                 // Check if alignment has valid values.
                 if (alignment[i] > 3) {
-                    delete cigar;
-                    return 0;
+                    cigar->resize(cigarStart);
+                    return false;
                 }
                 numOfSameMoves = 0;
             }
@@ -339,10 +1192,17 @@ extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, con
         }
     }
     cigar->push_back(0);  // Null character termination.
-    char* cigar_ = static_cast<char *>(malloc(cigar->size() * sizeof(char)));
-    memcpy(cigar_, &(*cigar)[0], cigar->size() * sizeof(char));
-    delete cigar;
+    return true;
+}
 
+extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, const int alignmentLength,
+                                       const EdlibCigarFormat cigarFormat) {
+    vector<char> cigar;
+    if (!appendCigar(alignment, alignmentLength, cigarFormat, &cigar)) {
+        return 0;
+    }
+    char* cigar_ = static_cast<char *>(malloc(cigar.size() * sizeof(char)));
+    memcpy(cigar_, cigar.data(), cigar.size() * sizeof(char));
     return cigar_;
 }
 
@@ -359,23 +1219,31 @@ static inline Word* buildPeq(const int alphabetLength,
     int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
     // table of dimensions alphabetLength+1 x maxNumBlocks. Last symbol is wildcard.
     Word* Peq = new Word[(alphabetLength + 1) * maxNumBlocks];
-
-    // Build Peq (1 is match, 0 is mismatch). NOTE: last column is wildcard(symbol that matches anything) with just 1s
-    for (int symbol = 0; symbol <= alphabetLength; symbol++) {
-        for (int b = 0; b < maxNumBlocks; b++) {
-            if (symbol < alphabetLength) {
-                Peq[symbol * maxNumBlocks + b] = 0;
-                for (int r = (b+1) * WORD_SIZE - 1; r >= b * WORD_SIZE; r--) {
-                    Peq[symbol * maxNumBlocks + b] <<= 1;
-                    // NOTE: We pretend like query is padded at the end with W wildcard symbols
-                    if (r >= queryLength || equalityDefinition.areEqual(query[r], symbol))
-                        Peq[symbol * maxNumBlocks + b] += 1;
-                }
-            } else { // Last symbol is wildcard, so it is all 1s
-                Peq[symbol * maxNumBlocks + b] = static_cast<Word>(-1);
+    memset(Peq, 0, sizeof(Word) * alphabetLength * maxNumBlocks);
+
+    // Build Peq (1 is match, 0 is mismatch) by setting bit of each query element for all symbols equal to it.
+    for (int r = 0; r < queryLength; r++) {
+        const CharMask& equalSymbols = equalityDefinition.equalTo(query[r]);
+        const Word rowBit = WORD_1 << (r % WORD_SIZE);
+        Word* const Peq_r = Peq + r / WORD_SIZE;
+        for (int w = 0; w * WORD_SIZE < alphabetLength; w++) {
+            for (Word symbols = equalSymbols.words[w]; symbols; symbols &= symbols - 1) {
+                Peq_r[(w * WORD_SIZE + countTrailingZeros(symbols)) * maxNumBlocks] |= rowBit;
             }
         }
     }
+    // NOTE: We pretend like query is padded at the end with W wildcard symbols
+    const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    if (W > 0) {
+        const Word padding = static_cast<Word>(-1) << (WORD_SIZE - W);
+        for (int symbol = 0; symbol < alphabetLength; symbol++) {
+            Peq[symbol * maxNumBlocks + maxNumBlocks - 1] |= padding;
+        }
+    }
+    // NOTE: last column is wildcard(symbol that matches anything) with just 1s
+    for (int b = 0; b < maxNumBlocks; b++) {
+        Peq[alphabetLength * maxNumBlocks + b] = static_cast<Word>(-1);
+    }
 
     return Peq;
 }
@@ -393,6 +1261,25 @@ static inline unsigned char* createReverseCopy(const unsigned char* const seq, c
     return rSeq;
 }
 
+/**
+ * Returns part of sequence, [start, start + length), as contiguous array of transformed symbols.
+ * Plain array is returned directly, while other sequences are copied into given buffer.
+ */
+static inline const unsigned char* contiguousRange(const unsigned char* const seq, const int start, const int,
+                                                   vector<unsigned char>&) {
+    return seq + start;
+}
+
+template <class Sequence>
+static inline const unsigned char* contiguousRange(const Sequence& seq, const int start, const int length,
+                                                   vector<unsigned char>& buffer) {
+    buffer.resize(length);
+    for (int i = 0; i < length; i++) {
+        buffer[i] = seq[start + i];
+    }
+    return buffer.data();
+}
+
 /**
  * Corresponds to Advance_Block function from Myers.
  * Calculates one word(block), which is part of a column.
@@ -451,6 +1338,33 @@ static inline int ceilDiv(const int x, const int y) {
     return x % y ? x / y + 1 : x / y;
 }
 
+/**
+ * @return Index of lowest set bit in x. x must not be 0.
+ */
+static inline int countTrailingZeros(Word x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    int count = 0;
+    for (; !(x & WORD_1); x >>= 1) count++;
+    return count;
+#endif
+}
+
+static inline int countOnes(Word x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int count = 0;
+    for (; x; x &= x - 1) count++;
+    return count;
+#endif
+}
+
 static inline int min(const int x, const int y) {
     return x < y ? x : y;
 }
@@ -525,6 +1439,109 @@ static inline bool allBlockCellsLarger(const Block block, const int k) {
     return true;
 }
 
+// Each STRONG_REDUCE_NUM column, band is reduced in more expensive way (see allBlockCellsLarger()).
+// This gives speed up of about 2 times for small k.
+// TODO: Choose this number dinamically (based on query and target lengths?), so it does not affect speed of computation
+static const int STRONG_REDUCE_NUM = 2048;
+
+/**
+ * @param [in] lastBlock  Last block of band, already computed in current column.
+ * @param [in] hout  Horizontal output of last block.
+ * @param [in] nextPeq  Peq of block below last block, for symbol of current column.
+ * @param [in] k
+ * @return True if block below last block may have cells with value <= k in current column,
+ *         so it has to be added to band (Ukkonen).
+ */
+static inline bool blockEntersBand(const Block& lastBlock, const int hout, const Word nextPeq, const int k) {
+    return lastBlock.score - hout <= k && ((nextPeq & WORD_1) || hout < 0);
+}
+
+/**
+ * @return Block that is added to band below given last block in current column (see blockEntersBand()).
+ */
+static inline Block enteringBlock(const Block& lastBlock, const int hout, const Word Peq) {
+    Block block(static_cast<Word>(-1), static_cast<Word>(0), 0); // P is all 1s
+    block.score = lastBlock.score - hout + WORD_SIZE + calculateBlock(block.P, block.M, Peq, hout, block.P, block.M);
+    return block;
+}
+
+/**
+ * @param [in] strongReduce  If true, cells of block are also checked one by one, which is more expensive.
+ * @return True if block can be removed from edge of band, since all of its cells are larger than k.
+ */
+static inline bool blockLeavesBand(const Block& block, const int k, const bool strongReduce) {
+    return block.score >= k + WORD_SIZE || (strongReduce && allBlockCellsLarger(block, k));
+}
+
+/**
+ * Computes next column of semi-global alignment (or of NW, if first block is not removed from band there)
+ * in Ukkonen band of blocks, and adjusts band to it: block below band is added if its cells may be <= k,
+ * while blocks at edges of band whose cells are all > k are removed.
+ * Band may become empty (lastBlock < firstBlock), except in EDLIB_MODE_HW, where first block is always
+ * in band, since starting conditions at upper boundary are 0, so there may be solution in any column.
+ * @param [in,out] blocks  Blocks of column, only those in band are valid.
+ * @param [in,out] firstBlock_  Index of first block in band, band must not be empty.
+ * @param [in,out] lastBlock_  Index of last block in band.
+ * @param [in] Peq_c  Peq of all blocks for symbol of column.
+ * @param [in] k
+ * @param [in] maxNumBlocks
+ * @param [in] mode
+ * @param [in] strongReduce  True every STRONG_REDUCE_NUM columns, when band is reduced in more expensive way.
+ */
+static EDLIB_FORCE_INLINE void advanceColumn(Block* const blocks, int* const firstBlock_, int* const lastBlock_,
+                                             const Word* const Peq_c, const int k, const int maxNumBlocks,
+                                             const EdlibAlignMode mode, const bool strongReduce) {
+    int firstBlock = *firstBlock_;
+    int lastBlock = *lastBlock_;
+
+    //----------------------- Calculate column -------------------------//
+    int hout = mode == EDLIB_MODE_HW ? 0 : 1; // If 0 then gap before query is not penalized;
+    for (int b = firstBlock; b <= lastBlock; b++) {
+        hout = calculateBlock(blocks[b].P, blocks[b].M, Peq_c[b], hout, blocks[b].P, blocks[b].M);
+        blocks[b].score += hout;
+    }
+    //------------------------------------------------------------------//
+
+    //---------- Adjust number of blocks according to Ukkonen ----------//
+    if (lastBlock < maxNumBlocks - 1 && blockEntersBand(blocks[lastBlock], hout, Peq_c[lastBlock + 1], k)) {
+        // If score of left block is not too big, calculate one more block
+        blocks[lastBlock + 1] = enteringBlock(blocks[lastBlock], hout, Peq_c[lastBlock + 1]);
+        lastBlock++;
+    } else {
+        while (lastBlock >= firstBlock && blockLeavesBand(blocks[lastBlock], k, false)) {
+            lastBlock--;
+        }
+    }
+
+    // Every some columns, do some expensive but also more efficient block reducing.
+    // This is important!
+    //
+    // Reduce the band by decreasing last block if possible.
+    if (strongReduce) {
+        while (lastBlock >= 0 && lastBlock >= firstBlock && allBlockCellsLarger(blocks[lastBlock], k)) {
+            lastBlock--;
+        }
+    }
+    // For HW, even if all cells are > k, there still may be solution in next
+    // column because starting conditions at upper boundary are 0.
+    // That means that first block is always candidate for solution,
+    // and we can never end calculation before last column.
+    if (mode == EDLIB_MODE_HW && lastBlock == -1) {
+        lastBlock++;
+    }
+
+    // Reduce band by increasing first block if possible. Not applicable to HW.
+    if (mode != EDLIB_MODE_HW) {
+        while (firstBlock <= lastBlock && blockLeavesBand(blocks[firstBlock], k, strongReduce)) {
+            firstBlock++;
+        }
+    }
+    //------------------------------------------------------------------//
+
+    *firstBlock_ = firstBlock;
+    *lastBlock_ = lastBlock;
+}
+
 
 /**
  * Uses Myers' bit-vector algorithm to find edit distance for one of semi-global alignment methods.
@@ -542,14 +1559,17 @@ static inline bool allBlockCellsLarger(const Block block, const int k) {
  * @param [out] positions_  Array of 0-indexed positions in target at which best score was found.
                             Make sure to free this array with free().
  * @param [out] numPositions_  Number of positions in the positions_ array.
+ * @param [in] control  State shared with other scans that run concurrently, NULL if there are none.
  * @return Status.
  */
+template <class TargetSequence>
 static int myersCalcEditDistanceSemiGlobal(
         const Word* const Peq, const int W, const int maxNumBlocks,
         const int queryLength,
-        const unsigned char* const target, const int targetLength,
+        const TargetSequence target, const int targetLength,
         int k, const EdlibAlignMode mode,
-        int* const bestScore_, int** const positions_, int* const numPositions_) {
+        int* const bestScore_, int** const positions_, int* const numPositions_,
+        ScanControl* const control) {
     *positions_ = NULL;
     *numPositions_ = 0;
 
@@ -557,7 +1577,6 @@ static int myersCalcEditDistanceSemiGlobal(
     // lastBlock is 0-based index of last block in Ukkonen band.
     int firstBlock = 0;
     int lastBlock = min(ceilDiv(k + 1, WORD_SIZE), maxNumBlocks) - 1; // y in Myers
-    Block *bl; // Current block
 
     Block* blocks = new Block[maxNumBlocks];
 
@@ -566,86 +1585,75 @@ static int myersCalcEditDistanceSemiGlobal(
         k = min(queryLength, k);
     }
 
-    // Each STRONG_REDUCE_NUM column is reduced in more expensive way.
-    // This gives speed up of about 2 times for small k.
-    const int STRONG_REDUCE_NUM = 2048;
-
     // Initialize P, M and score
-    bl = blocks;
     for (int b = 0; b <= lastBlock; b++) {
-        bl->score = (b + 1) * WORD_SIZE;
-        bl->P = static_cast<Word>(-1); // All 1s
-        bl->M = static_cast<Word>(0);
-        bl++;
+        blocks[b] = Block(static_cast<Word>(-1), static_cast<Word>(0), (b + 1) * WORD_SIZE); // P is all 1s
     }
 
     int bestScore = -1;
     vector<int> positions; // TODO: Maybe put this on heap?
-    const int startHout = mode == EDLIB_MODE_HW ? 0 : 1; // If 0 then gap before query is not penalized;
-    const unsigned char* targetChar = target;
-    for (int c = 0; c < targetLength; c++) { // for each column
-        const Word* Peq_c = Peq + (*targetChar) * maxNumBlocks;
-
-        //----------------------- Calculate column -------------------------//
-        int hout = startHout;
-        bl = blocks + firstBlock;
-        Peq_c += firstBlock;
-        for (int b = firstBlock; b <= lastBlock; b++) {
-            hout = calculateBlock(bl->P, bl->M, *Peq_c, hout, bl->P, bl->M);
-            bl->score += hout;
-            bl++; Peq_c++;
-        }
-        bl--; Peq_c--;
-        //------------------------------------------------------------------//
 
-        //---------- Adjust number of blocks according to Ukkonen ----------//
-        if ((lastBlock < maxNumBlocks - 1) && (bl->score - hout <= k) // bl is pointing to last block
-            && ((*(Peq_c + 1) & WORD_1) || hout < 0)) { // Peq_c is pointing to last block
-            // If score of left block is not too big, calculate one more block
-            lastBlock++; bl++; Peq_c++;
-            bl->P = static_cast<Word>(-1); // All 1s
-            bl->M = static_cast<Word>(0);
-            bl->score = (bl - 1)->score - hout + WORD_SIZE + calculateBlock(bl->P, bl->M, *Peq_c, hout, bl->P, bl->M);
-        } else {
-            while (lastBlock >= firstBlock && bl->score >= k + WORD_SIZE) {
-                lastBlock--; bl--; Peq_c--;
-            }
-        }
+    // In HW, long runs of "foreign" symbols (those that match nothing in query, like N in scaffold gaps,
+    // or any mix of characters absent from query) are fast-forwarded. Once run is at least queryLength long,
+    // column is same as initial one (cell in row i has value i), so the rest of run can be skipped by resetting
+    // blocks to initial state.
+    // That does not change result as long as no score <= k is skipped: scores in last row are > k after
+    // first k + 1 columns of run, and W columns more are needed since scores are found W columns later.
+    // foreign[symbol] is 1 if symbol is foreign, 0 if not, -1 if not yet known.
+    signed char foreign[MAX_UCHAR + 1];
+    memset(foreign, -1, sizeof(foreign));
+    const Word queryBitsMask = W == 0 ? static_cast<Word>(-1) : (WORD_1 << (WORD_SIZE - W)) - 1;
+    int runEnd = 0; // End of last detected run of foreign symbols.
+    int fastForwardColumn = -1; // Column at which to skip to runEnd, -1 if there is none.
+    int polledColumn = 0; // Column at which control was polled last time.
 
-        // Every some columns, do some expensive but also more efficient block reducing.
-        // This is important!
-        //
-        // Reduce the band by decreasing last block if possible.
-        if (c % STRONG_REDUCE_NUM == 0) {
-            while (lastBlock >= 0 && lastBlock >= firstBlock && allBlockCellsLarger(*bl, k)) {
-                lastBlock--; bl--; Peq_c--;
+    for (int c = 0; c < targetLength; c++) { // for each column
+        if (control != NULL && c % ScanControl::PERIOD == 0) {
+            const int columns = c - polledColumn;  // Columns can be skipped by fast-forwarding.
+            polledColumn = c;
+            if (control->poll(columns)) {
+                *bestScore_ = -1;
+                delete[] blocks;
+                return EDLIB_STATUS_OK;
             }
+            k = min(k, control->k.load(memory_order_relaxed));
         }
-        // For HW, even if all cells are > k, there still may be solution in next
-        // column because starting conditions at upper boundary are 0.
-        // That means that first block is always candidate for solution,
-        // and we can never end calculation before last column.
-        if (mode == EDLIB_MODE_HW && lastBlock == -1) {
-            lastBlock++; bl++; Peq_c++;
-        }
-
-        // Reduce band by increasing first block if possible. Not applicable to HW.
-        if (mode != EDLIB_MODE_HW) {
-            while (firstBlock <= lastBlock && blocks[firstBlock].score >= k + WORD_SIZE) {
-                firstBlock++;
+        if (mode == EDLIB_MODE_HW) {
+            if (c == fastForwardColumn) {
+                fastForwardColumn = -1;
+                c = runEnd;
+                lastBlock = min(ceilDiv(k + 1, WORD_SIZE), maxNumBlocks) - 1;
+                for (int b = 0; b <= lastBlock; b++) {
+                    blocks[b] = Block(static_cast<Word>(-1), static_cast<Word>(0), (b + 1) * WORD_SIZE);
+                }
+                if (c == targetLength) break;
             }
-            if (c % STRONG_REDUCE_NUM == 0) { // Do strong reduction every some blocks
-                while (firstBlock <= lastBlock && allBlockCellsLarger(blocks[firstBlock], k)) {
-                    firstBlock++;
+            if (c >= runEnd && k < queryLength) {
+                const unsigned char symbol = target[c];
+                if (foreign[symbol] == -1) {
+                    const Word* const Peq_s = Peq + symbol * maxNumBlocks;
+                    foreign[symbol] = (Peq_s[maxNumBlocks - 1] & queryBitsMask) == 0;
+                    for (int b = 0; b < maxNumBlocks - 1 && foreign[symbol]; b++) {
+                        foreign[symbol] = Peq_s[b] == 0;
+                    }
+                }
+                if (foreign[symbol]) {
+                    runEnd = target.runEnd(c, targetLength);
+                    const int numCalculatedColumns = k + 1 + W;
+                    if (runEnd - c > max(queryLength, numCalculatedColumns)) {
+                        fastForwardColumn = c + numCalculatedColumns;
+                    }
                 }
             }
         }
+        advanceColumn(blocks, &firstBlock, &lastBlock, Peq + target[c] * maxNumBlocks, k, maxNumBlocks, mode,
+                      c % STRONG_REDUCE_NUM == 0);
 
         // If band stops to exist finish
         if (lastBlock < firstBlock) {
             *bestScore_ = bestScore;
             if (bestScore != -1) {
-                *positions_ = static_cast<int *>(malloc(sizeof(int) * static_cast<int>(positions.size())));
+                *positions_ = allocateResultArray<int>(positions.size());
                 *numPositions_ = static_cast<int>(positions.size());
                 copy(positions.begin(), positions.end(), *positions_);
             }
@@ -656,7 +1664,7 @@ static int myersCalcEditDistanceSemiGlobal(
 
         //------------------------- Update best score ----------------------//
         if (lastBlock == maxNumBlocks - 1) {
-            int colScore = bl->score;
+            int colScore = blocks[lastBlock].score;
             if (colScore <= k) { // Scores > k dont have correct values (so we cannot use them), but are certainly > k.
                 // NOTE: Score that I find in column c is actually score from column c-W
                 if (bestScore == -1 || colScore <= bestScore) {
@@ -666,20 +1674,19 @@ static int myersCalcEditDistanceSemiGlobal(
                         // Change k so we will look only for equal or better
                         // scores then the best found so far.
                         k = bestScore;
+                        if (control != NULL) control->tightenK(bestScore);
                     }
                     positions.push_back(c - W);
                 }
             }
         }
         //------------------------------------------------------------------//
-
-        targetChar++;
     }
 
 
     // Obtain results for last W columns from last column.
     if (lastBlock == maxNumBlocks - 1) {
-        vector<int> blockScores = getBlockCellValues(*bl);
+        vector<int> blockScores = getBlockCellValues(blocks[lastBlock]);
         for (int i = 0; i < W; i++) {
             int colScore = blockScores[i + 1];
             if (colScore <= k && (bestScore == -1 || colScore <= bestScore)) {
@@ -694,7 +1701,7 @@ static int myersCalcEditDistanceSemiGlobal(
 
     *bestScore_ = bestScore;
     if (bestScore != -1) {
-        *positions_ = static_cast<int *>(malloc(sizeof(int) * static_cast<int>(positions.size())));
+        *positions_ = allocateResultArray<int>(positions.size());
         *numPositions_ = static_cast<int>(positions.size());
         copy(positions.begin(), positions.end(), *positions_);
     }
@@ -704,6 +1711,99 @@ static int myersCalcEditDistanceSemiGlobal(
 }
 
 
+/**
+ * Same as myersCalcEditDistanceSemiGlobal() with HW mode, but target is split into chunks which are scanned
+ * concurrently. Each chunk reports only end positions that it owns, and it also scans queryLength + k
+ * columns before them, since that is the longest part of target that alignment with score <= k can span.
+ * Scores found in owned positions are therefore exact, which makes merged result same as result of serial scan.
+ * Chunks share lowest score found so far, so they can tighten their k.
+ * @param [in] numThreads  Maximal number of threads to use, negative for number of hardware threads.
+ *                         Fewer threads are used if target is too short to give each of them a large enough chunk.
+ * @param [in] executor  Executor that runs chunks, NULL for built-in one.
+ * @param [in] parentControl  Control of scan that this scan is part of, NULL if there is none.
+ * Other parameters and return value are same as for myersCalcEditDistanceSemiGlobal().
+ */
+template <class TargetSequence>
+static int myersCalcEditDistanceSemiGlobalParallel(
+        const Word* const Peq, const int W, const int maxNumBlocks,
+        const int queryLength,
+        const TargetSequence target, const int targetLength,
+        int k, int numThreads, const EdlibExecutor* const executor,
+        int* const bestScore_, int** const positions_, int* const numPositions_,
+        const ScanControl* const parentControl) {
+    k = min(queryLength, k);
+    const int overlap = queryLength + k;
+    // Chunks shorter than this are not worth a thread, compared to the overlap they have to scan again.
+    const int minChunkLength = max(4 * overlap, 1 << 16);
+    const int numChunks = min(resolveNumThreads(numThreads), targetLength / minChunkLength);
+    ScanControl control(k, parentControl);
+    if (numChunks <= 1) {
+        return myersCalcEditDistanceSemiGlobal(Peq, W, maxNumBlocks, queryLength, target, targetLength,
+                                               k, EDLIB_MODE_HW, bestScore_, positions_, numPositions_,
+                                               &control);
+    }
+
+    struct ChunkResult {
+        int bestScore;
+        vector<int> positions;
+    };
+    vector<ChunkResult> chunkResults(numChunks);
+
+    auto scanChunk = [&](const int chunk) {
+        const int ownStart = static_cast<int>(static_cast<int64_t>(targetLength) * chunk / numChunks);
+        const int ownEnd = static_cast<int>(static_cast<int64_t>(targetLength) * (chunk + 1) / numChunks);
+        const int scanStart = max(0, ownStart - overlap);
+        int bestScore, numPositions;
+        int* positions;
+        myersCalcEditDistanceSemiGlobal(Peq, W, maxNumBlocks, queryLength,
+                                        OffsetSequence<TargetSequence>(target, scanStart), ownEnd - scanStart,
+                                        k, EDLIB_MODE_HW, &bestScore, &positions, &numPositions, &control);
+        // First chunk also owns negative positions, same as serial scan can report them.
+        ChunkResult& chunkResult = chunkResults[chunk];
+        for (int i = 0; i < numPositions; i++) {
+            const int position = scanStart + positions[i];
+            if ((chunk == 0 || position >= ownStart) && position < ownEnd) {
+                chunkResult.positions.push_back(position);
+            }
+        }
+        chunkResult.bestScore = chunkResult.positions.empty() ? -1 : bestScore;
+        freeResultArray(positions);
+    };
+
+    runInParallel(numChunks, scanChunk, executor, false);
+    if (control.isCancelled()) {
+        *bestScore_ = -1;
+        *positions_ = NULL;
+        *numPositions_ = 0;
+        return EDLIB_STATUS_OK;
+    }
+
+    // Merge: best score is lowest score of all chunks, positions are collected in order from chunks that have it.
+    int bestScore = -1;
+    for (int chunk = 0; chunk < numChunks; chunk++) {
+        const int chunkScore = chunkResults[chunk].bestScore;
+        if (chunkScore != -1 && (bestScore == -1 || chunkScore < bestScore)) bestScore = chunkScore;
+    }
+    vector<int> positions;
+    for (int chunk = 0; chunk < numChunks; chunk++) {
+        if (chunkResults[chunk].bestScore == bestScore && bestScore != -1) {
+            positions.insert(positions.end(), chunkResults[chunk].positions.begin(),
+                             chunkResults[chunk].positions.end());
+        }
+    }
+
+    *bestScore_ = bestScore;
+    *positions_ = NULL;
+    *numPositions_ = 0;
+    if (bestScore != -1) {
+        *positions_ = allocateResultArray<int>(positions.size());
+        *numPositions_ = static_cast<int>(positions.size());
+        copy(positions.begin(), positions.end(), *positions_);
+    }
+    return EDLIB_STATUS_OK;
+}
+
+
 /**
  * Uses Myers' bit-vector algorithm to find edit distance for global(NW) alignment method.
  * @param [in] Peq  Query profile.
@@ -725,22 +1825,22 @@ static int myersCalcEditDistanceSemiGlobal(
  * @param [out] targetStopPosition  If set to -1, whole calculation is performed normally, as expected.
  *         If set to p, calculation is performed up to position p in target (inclusive)
  *         and column p is returned as the only column in alignData.
+ * @param [in] control  If given, calculation stops without result once it is cancelled.
  * @return Status.
  */
+template <class TargetSequence>
 static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int maxNumBlocks,
                                    const int queryLength,
-                                   const unsigned char* const target, const int targetLength,
+                                   const TargetSequence target, const int targetLength,
                                    int k, int* const bestScore_,
                                    int* const position_, const bool findAlignment,
-                                   AlignmentData** const alignData, const int targetStopPosition) {
+                                   AlignmentData** const alignData, const int targetStopPosition,
+                                   const ScanControl* const control) {
     if (targetStopPosition > -1 && findAlignment) {
         // They can not be both set at the same time!
         return EDLIB_STATUS_ERROR;
     }
 
-    // Each STRONG_REDUCE_NUM column is reduced in more expensive way.
-    const int STRONG_REDUCE_NUM = 2048; // TODO: Choose this number dinamically (based on query and target lengths?), so it does not affect speed of computation
-
     if (k < abs(targetLength - queryLength)) {
         *bestScore_ = *position_ = -1;
         return EDLIB_STATUS_OK;
@@ -774,9 +1874,15 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
     else
         *alignData = NULL;
 
-    const unsigned char* targetChar = target;
     for (int c = 0; c < targetLength; c++) { // for each column
-        const Word* Peq_c = Peq + *targetChar * maxNumBlocks;
+        if (control != NULL && c % ScanControl::PERIOD == 0 && control->poll(c == 0 ? 0 : ScanControl::PERIOD)) {
+            *bestScore_ = *position_ = -1;
+            delete *alignData;
+            *alignData = NULL;
+            delete[] blocks;
+            return EDLIB_STATUS_OK;
+        }
+        const Word* Peq_c = Peq + target[c] * maxNumBlocks;
 
         //----------------------- Calculate column -------------------------//
         int hout = 1;
@@ -910,8 +2016,6 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
             return EDLIB_STATUS_OK;
         }
         //----------------------------------------------------//
-
-        targetChar++;
     }
 
     if (lastBlock == maxNumBlocks - 1) { // If last block of last column was calculated
@@ -931,6 +2035,401 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
 }
 
 
+/**
+ * Message that thread sends to thread below it in pipelined NW, one for each column of a tile.
+ */
+struct PipelineMessage {
+    int hout;  // Hout of last block of group.
+    int score;  // Score of last block of group.
+    bool active;  // True if last block of group is in band, otherwise hout and score are not set.
+};
+
+/**
+ * Lock-free single-producer/single-consumer ring of tiles of pipeline messages.
+ */
+class PipelineRing {
+private:
+    vector<PipelineMessage> messages;
+    int tileSize;
+    int64_t numSlots;
+    atomic<int64_t> numWritten;
+    atomic<int64_t> numRead;
+public:
+    PipelineRing(const int tileSize_, const int numSlots_)
+        : messages(static_cast<size_t>(tileSize_) * numSlots_), tileSize(tileSize_), numSlots(numSlots_),
+          numWritten(0), numRead(0) {}
+
+    /**
+     * Waits until there is free slot and returns it. Call endWrite() once it is filled.
+     * @return Free slot, or NULL if control was cancelled while waiting.
+     */
+    PipelineMessage* beginWrite(const ScanControl* const control) {
+        const int64_t slot = numWritten.load(memory_order_relaxed);
+        while (slot - numRead.load(memory_order_acquire) == numSlots) {
+            if (control != NULL && control->isCancelled()) return NULL;
+            this_thread::yield();
+        }
+        return &messages[static_cast<size_t>(slot % numSlots) * tileSize];
+    }
+
+    void endWrite() {
+        numWritten.store(numWritten.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    /**
+     * Waits until there is filled slot and returns it. Call endRead() once it is not needed any more.
+     * @return Filled slot, or NULL if control was cancelled while waiting.
+     */
+    const PipelineMessage* beginRead(const ScanControl* const control) {
+        const int64_t slot = numRead.load(memory_order_relaxed);
+        while (numWritten.load(memory_order_acquire) == slot) {
+            if (control != NULL && control->isCancelled()) return NULL;
+            this_thread::yield();
+        }
+        return &messages[static_cast<size_t>(slot % numSlots) * tileSize];
+    }
+
+    void endRead() {
+        numRead.store(numRead.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+};
+
+/**
+ * Same as myersCalcEditDistanceNW() without alignment data, but computation is pipelined across threads.
+ *
+ * Blocks are divided into groups of PIPELINE_GROUP_SIZE blocks, which are assigned to threads in round robin,
+ * and target is divided into tiles of PIPELINE_TILE_SIZE columns. Computing a group over a tile needs
+ * the same group over previous tile and the group above over same tile, so thread computes its
+ * (tile, group) pairs in order of tile + group (a diagonal wavefront) and hands hout and score of
+ * last block of group over each column of the tile to the thread below it, through PipelineRing.
+ *
+ * Since band can not adapt to scores without serializing threads, static Ukkonen band is used instead:
+ * cell can be on path with score <= k only if |d| + |d - (queryLength - targetLength)| <= k,
+ * where d is its diagonal. Values in band are computed same as in myersCalcEditDistanceNW() (values out of band
+ * are overestimated), so score is the same if it is <= k.
+ *
+ * If band is too narrow to keep all threads busy, or numThreads is 1, myersCalcEditDistanceNW() is used instead.
+ * @param [in] numThreads  Number of threads to use, negative for number of hardware threads.
+ * @param [in] executor  Executor that runs threads of pipeline, NULL for built-in one.
+ *                       Threads wait for each other, so they must all run concurrently.
+ * @param [in] control  If given, calculation stops without result once it is cancelled.
+ * Other parameters and return value are same as for myersCalcEditDistanceNW().
+ */
+template <class TargetSequence>
+static int myersCalcEditDistanceNWPipelined(const Word* const Peq, const int W, const int maxNumBlocks,
+                                            const int queryLength,
+                                            const TargetSequence target, const int targetLength,
+                                            int k, int numThreads, const EdlibExecutor* const executor,
+                                            int* const bestScore_, int* const position_,
+                                            const ScanControl* const control) {
+    const int PIPELINE_GROUP_SIZE = 8;
+    const int PIPELINE_TILE_SIZE = 256;
+
+    if (k < abs(targetLength - queryLength)) {
+        *bestScore_ = *position_ = -1;
+        return EDLIB_STATUS_OK;
+    }
+    k = min(k, max(queryLength, targetLength));  // Upper bound for k
+
+    // Band contains diagonals (row - column) from minDiagonal to maxDiagonal.
+    const int lengthDiff = queryLength - targetLength;
+    const int slack = (k - abs(lengthDiff)) / 2;
+    const int minDiagonal = min(0, lengthDiff) - slack;
+    const int maxDiagonal = max(0, lengthDiff) + slack;
+
+    numThreads = resolveNumThreads(numThreads);
+    const int numGroups = ceilDiv(maxNumBlocks, PIPELINE_GROUP_SIZE);
+    const int numTiles = ceilDiv(targetLength, PIPELINE_TILE_SIZE);
+    const int bandNumBlocks = (maxDiagonal - minDiagonal) / WORD_SIZE + 2;
+    if (numThreads == 1 || bandNumBlocks < 2 * numThreads * PIPELINE_GROUP_SIZE || numTiles < 4 * numThreads) {
+        AlignmentData* alignData = NULL;
+        return myersCalcEditDistanceNW(Peq, W, maxNumBlocks, queryLength, target, targetLength,
+                                       k, bestScore_, position_, false, &alignData, -1, control);
+    }
+
+    // First and last block in band in column c (rows and columns in band are 1-based, blocks 0-based).
+    auto firstBlockAt = [&](const int c) {
+        return (max(1, c + 1 + minDiagonal) - 1) / WORD_SIZE;
+    };
+    auto lastBlockAt = [&](const int c) {
+        return (min(queryLength, c + 1 + maxDiagonal) - 1) / WORD_SIZE;
+    };
+    // Since band goes down with each column, groups in band in each tile form a range, and both ends of
+    // range do not decrease with tile.
+    vector<int> tileFirstGroup(numTiles), tileLastGroup(numTiles);
+    int maxTileNumGroups = 0;
+    for (int tile = 0; tile < numTiles; tile++) {
+        tileFirstGroup[tile] = firstBlockAt(tile * PIPELINE_TILE_SIZE) / PIPELINE_GROUP_SIZE;
+        tileLastGroup[tile] = lastBlockAt(min(targetLength, (tile + 1) * PIPELINE_TILE_SIZE) - 1)
+            / PIPELINE_GROUP_SIZE;
+        maxTileNumGroups = max(maxTileNumGroups, tileLastGroup[tile] - tileFirstGroup[tile] + 1);
+    }
+    auto isActive = [&](const int tile, const int group) {
+        return group >= tileFirstGroup[tile] && group <= tileLastGroup[tile];
+    };
+
+    // Ring i goes from thread i to thread i + 1 (and last one to thread 0).
+    // Rings must hold more tiles than thread computes in two steps of wavefront, otherwise threads could
+    // wait for each other in circle.
+    const int numSlots = 4 * (maxTileNumGroups / numThreads + 2);
+    vector<unique_ptr<PipelineRing>> rings(numThreads);
+    for (int i = 0; i < numThreads; i++) {
+        rings[i].reset(new PipelineRing(PIPELINE_TILE_SIZE, numSlots));
+    }
+
+    vector<Block> blocks(maxNumBlocks);
+    // Last block of each group that was already in band.
+    vector<int> lastEnteredBlocks(numGroups);
+    for (int group = 0; group < numGroups; group++) {
+        lastEnteredBlocks[group] = group * PIPELINE_GROUP_SIZE - 1;
+    }
+
+    auto computeGroup = [&](const int tile, const int group, const PipelineMessage* const in,
+                            PipelineMessage* const out) {
+        const int groupFirstBlock = group * PIPELINE_GROUP_SIZE;
+        const int groupLastBlock = min(maxNumBlocks, groupFirstBlock + PIPELINE_GROUP_SIZE) - 1;
+        const int tileStart = tile * PIPELINE_TILE_SIZE;
+        const int tileEnd = min(targetLength, tileStart + PIPELINE_TILE_SIZE);
+        for (int c = tileStart; c < tileEnd; c++) {
+            const int firstBlock = firstBlockAt(c);
+            const int fromBlock = max(groupFirstBlock, firstBlock);
+            const int toBlock = min(groupLastBlock, lastBlockAt(c));
+            PipelineMessage* const message = out == NULL ? NULL : out + (c - tileStart);
+            if (fromBlock > toBlock) {
+                if (message != NULL) message->active = false;
+                continue;
+            }
+
+            // Block above is in band only if it is last block of group above, otherwise hin is 1 (top of band).
+            int hout = 1;
+            bool aboveInBand = false;
+            int aboveScore = 0; // Score of block above in previous column.
+            if (fromBlock > firstBlock) {
+                const PipelineMessage& above = in[c - tileStart];
+                hout = above.hout;
+                aboveScore = above.score - above.hout;
+                aboveInBand = true;
+            }
+
+            const Word* const Peq_c = Peq + target[c] * maxNumBlocks;
+            for (int b = fromBlock; b <= toBlock; b++) {
+                Block& bl = blocks[b];
+                if (b > lastEnteredBlocks[group]) {
+                    // Block enters band. If block above is not in band, score in previous column is overestimated
+                    // (cell can not have larger value than sum of its row and column).
+                    bl.P = static_cast<Word>(-1); // All 1s
+                    bl.M = static_cast<Word>(0);
+                    bl.score = (aboveInBand ? aboveScore : b * WORD_SIZE + c) + WORD_SIZE;
+                    lastEnteredBlocks[group] = b;
+                }
+                aboveScore = bl.score;
+                hout = calculateBlock(bl.P, bl.M, Peq_c[b], hout, bl.P, bl.M);
+                bl.score += hout;
+                aboveInBand = true;
+            }
+
+            if (message != NULL) {
+                message->active = toBlock == groupLastBlock;
+                message->hout = hout;
+                message->score = blocks[toBlock].score;
+            }
+        }
+    };
+
+    auto runThread = [&](const int threadIdx) {
+        PipelineRing& inRing = *rings[(threadIdx + numThreads - 1) % numThreads];
+        PipelineRing& outRing = *rings[threadIdx];
+        // Groups computed in step s are those that are in band in tile s - group. They form a range whose
+        // ends do not decrease with s, so lowest one is tracked from step to step.
+        int lowGroup = 0;
+        int polledTile = 0;  // Tile at which control was polled last time.
+        for (int step = 0; step < numTiles + numGroups - 1; step++) {
+            // First thread polls control (and reports progress of pipeline by tiles of first group),
+            // while others notice cancellation while waiting for each other.
+            if (threadIdx == 0 && control != NULL && step % (ScanControl::PERIOD / PIPELINE_TILE_SIZE) == 0) {
+                const int tile = min(step, numTiles);
+                const bool cancelled = control->poll(static_cast<long long>(tile - polledTile) * PIPELINE_TILE_SIZE);
+                polledTile = tile;
+                if (cancelled) return;
+            }
+            const int stepFirstGroup = max(0, step - numTiles + 1);
+            const int stepLastGroup = min(step, numGroups - 1);
+            while (lowGroup <= stepLastGroup
+                   && (lowGroup < stepFirstGroup || lowGroup < tileFirstGroup[step - lowGroup])) {
+                lowGroup++;
+            }
+            int group = lowGroup + ((threadIdx - lowGroup) % numThreads + numThreads) % numThreads;
+            for (; group <= stepLastGroup && group <= tileLastGroup[step - group]; group += numThreads) {
+                const int tile = step - group;
+                const bool hasIn = group > 0 && isActive(tile, group - 1);
+                const bool hasOut = group + 1 < numGroups && isActive(tile, group + 1);
+                const PipelineMessage* const in = hasIn ? inRing.beginRead(control) : NULL;
+                PipelineMessage* const out = hasOut ? outRing.beginWrite(control) : NULL;
+                if ((hasIn && in == NULL) || (hasOut && out == NULL)) return;  // Cancelled.
+                computeGroup(tile, group, in, out);
+                if (hasIn) inRing.endRead();
+                if (hasOut) outRing.endWrite();
+            }
+        }
+    };
+    runInParallel(numThreads, runThread, executor, true);
+    if (control != NULL && control->isCancelled()) {
+        *bestScore_ = *position_ = -1;
+        return EDLIB_STATUS_OK;
+    }
+
+    // Obtain best score from block -> it is complicated because query is padded with W cells
+    const int bestScore = getBlockCellValues(blocks[maxNumBlocks - 1])[W];
+    if (bestScore <= k) {
+        *bestScore_ = bestScore;
+        *position_ = targetLength - 1;
+    } else {
+        *bestScore_ = *position_ = -1;
+    }
+    return EDLIB_STATUS_OK;
+}
+
+/**
+ * Built-in executor: pool of threads that run submitted tasks in order of submission.
+ * Pool is never destroyed, so its threads do not have to be joined while program exits.
+ */
+class ThreadPool {
+private:
+    mutex queueMutex;
+    condition_variable queueNotEmpty;
+    deque<pair<EdlibTask, void*> > queue;
+
+    void work() {
+        while (true) {
+            pair<EdlibTask, void*> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                while (queue.empty()) queueNotEmpty.wait(lock);
+                task = queue.front();
+                queue.pop_front();
+            }
+            task.first(task.second);
+        }
+    }
+
+public:
+    explicit ThreadPool(const int numThreads) {
+        for (int i = 0; i < numThreads; i++) {
+            thread(&ThreadPool::work, this).detach();
+        }
+    }
+
+    static void submit(void* const pool, const EdlibTask task, void* const taskContext) {
+        ThreadPool* const threadPool = static_cast<ThreadPool*>(pool);
+        {
+            lock_guard<mutex> lock(threadPool->queueMutex);
+            threadPool->queue.push_back(make_pair(task, taskContext));
+        }
+        threadPool->queueNotEmpty.notify_one();
+    }
+};
+
+static const EdlibExecutor* builtInExecutor() {
+    static const EdlibExecutor executor = {
+        &ThreadPool::submit, new ThreadPool(max(1, static_cast<int>(thread::hardware_concurrency())))
+    };
+    return &executor;
+}
+
+/**
+ * State of one runInParallel() call, shared with its submitted tasks.
+ * Each task is run by whoever claims it first: submitted task or calling thread.
+ */
+struct ParallelRun {
+    const function<void(int)>* task;
+    int numTasks;
+    unique_ptr<atomic<bool>[]> claimed;
+    int numFinished;
+    mutex finishedMutex;
+    condition_variable allFinished;
+
+    ParallelRun(const function<void(int)>& task_, const int numTasks_)
+        : task(&task_), numTasks(numTasks_), claimed(new atomic<bool>[numTasks_]), numFinished(0) {
+        for (int i = 0; i < numTasks; i++) claimed[i] = false;
+    }
+
+    /**
+     * Runs task i, unless it was already claimed.
+     */
+    void tryRun(const int i) {
+        if (claimed[i].exchange(true)) return;
+        (*task)(i);
+        {
+            lock_guard<mutex> lock(finishedMutex);
+            numFinished++;
+        }
+        allFinished.notify_all();
+    }
+};
+
+struct ParallelTask {
+    shared_ptr<ParallelRun> run;
+    int index;
+
+    static void execute(void* const context) {
+        ParallelTask* const parallelTask = static_cast<ParallelTask*>(context);
+        parallelTask->run->tryRun(parallelTask->index);
+        delete parallelTask;
+    }
+};
+
+/**
+ * Runs task(0), ..., task(numTasks - 1) in parallel and waits for all of them to finish.
+ * Task 0 is run in calling thread, others are submitted to executor.
+ * @param [in] executor  Executor to submit tasks to, NULL for built-in one.
+ * @param [in] concurrently  If true, tasks wait for each other, so they must all run concurrently.
+ *     If false, calling thread also runs tasks that executor did not start yet, instead of waiting for them.
+ *     Built-in executor can not guarantee concurrency (it might be busy), so each task gets its own thread then.
+ */
+static void runInParallel(const int numTasks, const function<void(int)>& task, const EdlibExecutor* executor,
+                          const bool concurrently) {
+    if (executor == NULL && concurrently) {
+        vector<thread> threads;
+        for (int i = 1; i < numTasks; i++) {
+            threads.push_back(thread(task, i));
+        }
+        task(0);
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        return;
+    }
+    if (executor == NULL) executor = builtInExecutor();
+
+    // Submitted tasks may run after this call returns (finding their task already claimed),
+    // so they share state through shared pointer.
+    shared_ptr<ParallelRun> run(new ParallelRun(task, numTasks));
+    for (int i = 1; i < numTasks; i++) {
+        ParallelTask* const parallelTask = new ParallelTask();
+        parallelTask->run = run;
+        parallelTask->index = i;
+        executor->submit(executor->executorContext, &ParallelTask::execute, parallelTask);
+    }
+    run->tryRun(0);
+    if (!concurrently) {
+        for (int i = 1; i < numTasks; i++) {
+            run->tryRun(i);
+        }
+    }
+    unique_lock<mutex> lock(run->finishedMutex);
+    while (run->numFinished < numTasks) run->allFinished.wait(lock);
+}
+
+/**
+ * @return Number of threads to use for given EdlibAlignConfig.numThreads: hardware threads if it is negative,
+ *         one thread if it is 0.
+ */
+static int resolveNumThreads(const int numThreads) {
+    if (numThreads >= 0) return max(1, numThreads);
+    return max(1, static_cast<int>(thread::hardware_concurrency()));
+}
+
+
 /**
  * Finds one possible alignment that gives optimal score by moving back through the dynamic programming matrix,
  * that is stored in alignData. Consumes large amount of memory: O(queryLength * targetLength).
@@ -948,7 +2447,7 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
     const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
     const int W = maxNumBlocks * WORD_SIZE - queryLength;
 
-    *alignment = static_cast<unsigned char*>(malloc((queryLength + targetLength - 1) * sizeof(unsigned char)));
+    *alignment = allocateResultArray<unsigned char>(queryLength + targetLength - 1);
     *alignmentLength = 0;
     int c = targetLength - 1; // index of column
     int b = maxNumBlocks - 1; // index of block in column
@@ -1138,7 +2637,10 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
         //----------------------------------//
     }
 
-    *alignment = static_cast<unsigned char*>(realloc(*alignment, (*alignmentLength) * sizeof(unsigned char)));
+    // Array from scratch is not shrunk, it is reused anyway.
+    if (resultScratch == NULL || !resultScratch->owns(*alignment)) {
+        *alignment = static_cast<unsigned char*>(realloc(*alignment, (*alignmentLength) * sizeof(unsigned char)));
+    }
     reverse(*alignment, *alignment + (*alignmentLength));
     return EDLIB_STATUS_OK;
 }
@@ -1159,21 +2661,27 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
  * @param [in] bestScore  Best(optimal) score.
  * @param [out] alignment  Sequence of edit operations that make target equal to query.
  * @param [out] alignmentLength  Length of alignment.
- * @return Status code.
+ * @param [in] control  If given, computation stops once it is cancelled. Can be NULL.
+ * @return Status code, EDLIB_STATUS_CANCELLED if control was cancelled (then there is no alignment).
  */
 static int obtainAlignment(
         const unsigned char* const query, const unsigned char* const rQuery, const int queryLength,
         const unsigned char* const target, const unsigned char* const rTarget, const int targetLength,
         const EqualityDefinition& equalityDefinition, const int alphabetLength, const int bestScore,
-        unsigned char** const alignment, int* const alignmentLength) {
+        unsigned char** const alignment, int* const alignmentLength, const ScanControl* const control) {
+
+    if (control != NULL && control->isCancelled()) {
+        return EDLIB_STATUS_CANCELLED;
+    }
 
     // Handle special case when one of sequences has length of 0.
     if (queryLength == 0 || targetLength == 0) {
         *alignmentLength = targetLength + queryLength;
-        *alignment = static_cast<unsigned char*>(malloc((*alignmentLength) * sizeof(unsigned char)));
+        *alignment = allocateResultArray<unsigned char>(*alignmentLength);
         for (int i = 0; i < *alignmentLength; i++) {
             (*alignment)[i] = queryLength == 0 ? EDLIB_EDOP_DELETE : EDLIB_EDOP_INSERT;
         }
+        if (control != NULL && control->progress != NULL) control->progress->advance(targetLength);
         return EDLIB_STATUS_OK;
     }
 
@@ -1198,19 +2706,24 @@ static int obtainAlignment(
                                 queryLength,
                                 target, targetLength,
                                 bestScore,
-                                &score_, &endLocation_, true, &alignData, -1);
+                                &score_, &endLocation_, true, &alignData, -1, control);
         //assert(score_ == bestScore);
         //assert(endLocation_ == targetLength - 1);
 
-        statusCode = obtainAlignmentTraceback(queryLength, targetLength,
-                                              bestScore, alignData, alignment, alignmentLength);
+        if (alignData == NULL) {  // Computation was cancelled.
+            statusCode = EDLIB_STATUS_CANCELLED;
+        } else {
+            statusCode = obtainAlignmentTraceback(queryLength, targetLength,
+                                                  bestScore, alignData, alignment, alignmentLength);
+            if (control != NULL && control->progress != NULL) control->progress->advance(targetLength);
+        }
         delete alignData;
         delete[] Peq;
     } else {
         statusCode = obtainAlignmentHirschberg(query, rQuery, queryLength,
                                                target, rTarget, targetLength,
                                                equalityDefinition, alphabetLength, bestScore,
-                                               alignment, alignmentLength);
+                                               alignment, alignmentLength, control);
     }
     return statusCode;
 }
@@ -1229,13 +2742,14 @@ static int obtainAlignment(
  * @param [in] bestScore  Best(optimal) score.
  * @param [out] alignment  Sequence of edit operations that make target equal to query.
  * @param [out] alignmentLength  Length of alignment.
- * @return Status code.
+ * @param [in] control  If given, computation stops once it is cancelled. Can be NULL.
+ * @return Status code, EDLIB_STATUS_CANCELLED if control was cancelled (then there is no alignment).
  */
 static int obtainAlignmentHirschberg(
         const unsigned char* const query, const unsigned char* const rQuery, const int queryLength,
         const unsigned char* const target, const unsigned char* const rTarget, const int targetLength,
         const EqualityDefinition& equalityDefinition, const int alphabetLength, const int bestScore,
-        unsigned char** const alignment, int* const alignmentLength) {
+        unsigned char** const alignment, int* const alignmentLength, const ScanControl* const control) {
 
     const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
     const int W = maxNumBlocks * WORD_SIZE - queryLength;
@@ -1254,13 +2768,13 @@ static int obtainAlignmentHirschberg(
     AlignmentData* alignDataLeftHalf = NULL;
     int leftHalfCalcStatus = myersCalcEditDistanceNW(
             Peq, W, maxNumBlocks, queryLength, target, targetLength, bestScore,
-            &score_, &endLocation_, false, &alignDataLeftHalf, leftHalfWidth - 1);
+            &score_, &endLocation_, false, &alignDataLeftHalf, leftHalfWidth - 1, control);
 
     // Calculate right half.
     AlignmentData* alignDataRightHalf = NULL;
     int rightHalfCalcStatus = myersCalcEditDistanceNW(
             rPeq, W, maxNumBlocks, queryLength, rTarget, targetLength, bestScore,
-            &score_, &endLocation_, false, &alignDataRightHalf, rightHalfWidth - 1);
+            &score_, &endLocation_, false, &alignDataRightHalf, rightHalfWidth - 1, control);
 
     delete[] Peq;
     delete[] rPeq;
@@ -1270,6 +2784,11 @@ static int obtainAlignmentHirschberg(
         if (alignDataRightHalf) delete alignDataRightHalf;
         return EDLIB_STATUS_ERROR;
     }
+    if (alignDataLeftHalf == NULL || alignDataRightHalf == NULL) {  // Computation was cancelled.
+        if (alignDataLeftHalf) delete alignDataLeftHalf;
+        if (alignDataRightHalf) delete alignDataRightHalf;
+        return EDLIB_STATUS_CANCELLED;
+    }
 
     // Unwrap the left half.
     int firstBlockIdxLeft = alignDataLeftHalf->firstBlocks[0];
@@ -1371,66 +2890,82 @@ static int obtainAlignmentHirschberg(
     const int lrHeight = queryLength - ulHeight;
     const int ulWidth = leftHalfWidth;
     const int lrWidth = rightHalfWidth;
+    ProgressReporter* const progress = control != NULL ? control->progress : NULL;
+    if (progress != NULL) progress->enterLevel();
     unsigned char* ulAlignment = NULL; int ulAlignmentLength;
     int ulStatusCode = obtainAlignment(query, rQuery + lrHeight, ulHeight,
                                        target, rTarget + lrWidth, ulWidth,
                                        equalityDefinition, alphabetLength, leftScore,
-                                       &ulAlignment, &ulAlignmentLength);
+                                       &ulAlignment, &ulAlignmentLength, control);
     unsigned char* lrAlignment = NULL; int lrAlignmentLength;
     int lrStatusCode = obtainAlignment(query + ulHeight, rQuery, lrHeight,
                                        target + ulWidth, rTarget, lrWidth,
                                        equalityDefinition, alphabetLength, rightScore,
-                                       &lrAlignment, &lrAlignmentLength);
-    if (ulStatusCode == EDLIB_STATUS_ERROR || lrStatusCode == EDLIB_STATUS_ERROR) {
-        if (ulAlignment) free(ulAlignment);
-        if (lrAlignment) free(lrAlignment);
-        return EDLIB_STATUS_ERROR;
+                                       &lrAlignment, &lrAlignmentLength, control);
+    if (progress != NULL) progress->leaveLevel();
+    if (ulStatusCode != EDLIB_STATUS_OK || lrStatusCode != EDLIB_STATUS_OK) {
+        freeResultArray(ulAlignment);
+        freeResultArray(lrAlignment);
+        return ulStatusCode == EDLIB_STATUS_ERROR || lrStatusCode == EDLIB_STATUS_ERROR
+            ? EDLIB_STATUS_ERROR : EDLIB_STATUS_CANCELLED;
     }
 
     // Build alignment by concatenating upper left alignment with lower right alignment.
     *alignmentLength = ulAlignmentLength + lrAlignmentLength;
-    *alignment = static_cast<unsigned char*>(malloc((*alignmentLength) * sizeof(unsigned char)));
+    *alignment = allocateResultArray<unsigned char>(*alignmentLength);
     memcpy(*alignment, ulAlignment, ulAlignmentLength);
     memcpy(*alignment + ulAlignmentLength, lrAlignment, lrAlignmentLength);
 
-    free(ulAlignment);
-    free(lrAlignment);
+    freeResultArray(ulAlignment);
+    freeResultArray(lrAlignment);
     return EDLIB_STATUS_OK;
 }
 
 
 /**
- * Takes char query and char target, recognizes alphabet and transforms them into unsigned char sequences
- * where elements in sequences are not any more letters of alphabet, but their index in alphabet.
+ * Takes char query and char target, recognizes alphabet and transforms query into unsigned char sequence
+ * where elements in sequence are not any more letters of alphabet, but their index in alphabet.
+ * Target is not copied: instead, mapping from each of its characters to alphabet index is built,
+ * so it can be read through MappedSequence.
  * Most of internal edlib functions expect such transformed sequences.
- * This function will allocate queryTransformed and targetTransformed, so make sure to free them when done.
+ * This function will allocate queryTransformed, so make sure to free it when done.
  * Example:
- *   Original sequences: "ACT" and "CGT".
- *   Alphabet would be recognized as "ACTG". Alphabet length = 4.
- *   Transformed sequences: [0, 1, 2] and [1, 3, 2].
+ *   Original sequences: "ACT" and "CGTX", no additional equalities.
+ *   Alphabet would be recognized as "ACTG", where G is shared by all target characters that are not equal
+ *   to any query character (G and X). Number of distinct characters = 5.
+ *   Transformed query: [0, 1, 2], target mapped as [1, 3, 2, 3].
  * @param [in] queryOriginal
  * @param [in] queryLength
  * @param [in] targetOriginal
  * @param [in] targetLength
+ * @param [in] equalities  Equality set that extends equality, NULL if there is none. If it has
+ *                         EDLIB_EQUALITY_CASE_INSENSITIVE preset, lowercase letters are transformed into same
+ *                         values as uppercase ones, and only uppercase letters are put into alphabet.
  * @param [out] queryTransformed  It will contain values in range [0, alphabet length - 1].
- * @param [out] targetTransformed  It will contain values in range [0, alphabet length - 1].
+ * @param [out] targetSymbols  Array of length 256, targetSymbols[c] will be set to alphabet index of
+ *                             target character c.
+ * @param [out] numDistinctChars  Number of distinct characters in query and target.
  * @return  Alphabet as a string of unique characters, where index of each character is its value in transformed
  *          sequences.
  */
 static string transformSequences(const char* const queryOriginal, const int queryLength,
                                  const char* const targetOriginal, const int targetLength,
+                                 const EdlibEqualitySet* const equalities,
                                  unsigned char** const queryTransformed,
-                                 unsigned char** const targetTransformed) {
-    // Alphabet is constructed from letters that are present in sequences.
+                                 unsigned char* const targetSymbols,
+                                 int* const numDistinctChars) {
+    // Alphabet is constructed from letters that are present in query.
     // Each letter is assigned an ordinal number, starting from 0 up to alphabetLength - 1,
-    // and new query and target are created in which letters are replaced with their ordinal numbers.
-    // This query and target are used in all the calculations later.
+    // and new query is created in which letters are replaced with their ordinal numbers.
+    // Target is not transformed, instead each of its characters is mapped to a symbol through targetSymbols.
+    // Target characters that are not in query get their own symbol only if they are equal to some query character,
+    // all the others share one "foreign" symbol, since they all match nothing in query.
+    const bool caseInsensitive = equalities != NULL && (equalities->presets & EDLIB_EQUALITY_CASE_INSENSITIVE);
     *queryTransformed = static_cast<unsigned char *>(malloc(sizeof(unsigned char) * queryLength));
-    *targetTransformed = static_cast<unsigned char *>(malloc(sizeof(unsigned char) * targetLength));
 
     string alphabet = "";
 
-    // Alphabet information, it is constructed on fly while transforming sequences.
+    // Alphabet information, it is constructed on fly while transforming query.
     // letterIdx[c] is index of letter c in alphabet.
     unsigned char letterIdx[MAX_UCHAR + 1];
     bool inAlphabet[MAX_UCHAR + 1]; // inAlphabet[c] is true if c is in alphabet
@@ -1438,26 +2973,2710 @@ static string transformSequences(const char* const queryOriginal, const int quer
 
     for (int i = 0; i < queryLength; i++) {
         unsigned char c = static_cast<unsigned char>(queryOriginal[i]);
+        if (caseInsensitive) c = foldCase(c);
         if (!inAlphabet[c]) {
             inAlphabet[c] = true;
             letterIdx[c] = static_cast<unsigned char>(alphabet.size());
-            alphabet += queryOriginal[i];
+            alphabet += static_cast<char>(c);
         }
         (*queryTransformed)[i] = letterIdx[c];
     }
-    for (int i = 0; i < targetLength; i++) {
-        unsigned char c = static_cast<unsigned char>(targetOriginal[i]);
-        if (!inAlphabet[c]) {
-            inAlphabet[c] = true;
-            letterIdx[c] = static_cast<unsigned char>(alphabet.size());
-            alphabet += targetOriginal[i];
+    const int queryAlphabetLength = static_cast<int>(alphabet.size());
+
+    // Characters that are equal to at least one query character.
+    CharMask equalToQuery;
+    memset(&equalToQuery, 0, sizeof(equalToQuery));
+    for (int i = 0; i < queryAlphabetLength; i++) {
+        const unsigned char c = static_cast<unsigned char>(alphabet[i]);
+        if (equalities == NULL) {
+            equalToQuery.add(c);
+        } else {
+            for (int w = 0; w < (MAX_UCHAR + 1) / WORD_SIZE; w++) {
+                equalToQuery.words[w] |= equalities->masks[c].words[w];
+            }
         }
-        (*targetTransformed)[i] = letterIdx[c];
     }
 
-    return alphabet;
-}
-
+    bool inTarget[MAX_UCHAR + 1];
+    for (int i = 0; i < MAX_UCHAR + 1; i++) inTarget[i] = false;
+    const unsigned char* const target = reinterpret_cast<const unsigned char*>(targetOriginal);
+    for (int i = 0; i < targetLength; i++) {
+        inTarget[target[i]] = true;
+    }
+
+    *numDistinctChars = queryAlphabetLength;
+    int foreignSymbol = -1;
+    for (int i = 0; i < MAX_UCHAR + 1; i++) {
+        targetSymbols[i] = 0;
+        if (!inTarget[i]) continue;
+        const unsigned char c = caseInsensitive ? foldCase(static_cast<unsigned char>(i))
+                                                : static_cast<unsigned char>(i);
+        if (!inAlphabet[c]) {
+            inAlphabet[c] = true;
+            (*numDistinctChars)++;
+            if (equalToQuery.contains(c)) {
+                letterIdx[c] = static_cast<unsigned char>(alphabet.size());
+                alphabet += static_cast<char>(c);
+            } else {
+                if (foreignSymbol == -1) {
+                    foreignSymbol = static_cast<int>(alphabet.size());
+                    alphabet += static_cast<char>(c);
+                }
+                letterIdx[c] = static_cast<unsigned char>(foreignSymbol);
+            }
+        }
+        targetSymbols[i] = letterIdx[c];
+    }
+
+    return alphabet;
+}
+
+
+/**
+ * State of alignment after some columns of target: blocks of last column, which are computed with Ukkonen's
+ * banding same as in myersCalcEditDistanceSemiGlobal(), but column by column as target is given.
+ * In EDLIB_MODE_NW, band can not be narrowed by using target length as NW kernel does, since it is not known.
+ */
+struct EdlibColumnState {
+    const EdlibQueryProfile* profile;
+    EdlibAlignMode mode;
+    int k;
+    long long position;  // Number of target characters that state is computed for.
+    // Band of blocks in last column, it is empty (and stays empty) if lastBlock < firstBlock.
+    int firstBlock;
+    int lastBlock;
+    vector<Block> blocks;
+    // Best score found so far and positions where it was found, only in semi-global modes.
+    // Scores of last W positions are not included, since they are found W columns later.
+    int bestScore;
+    vector<long long> positions;
+    // If true, k is lowered to best score once it is found, otherwise band depends only on target.
+    bool tightenK;
+};
+
+// Used instead of k in EDLIB_MODE_NW if there is no limit, it is low enough that k + WORD_SIZE does not overflow.
+static const int NO_K_LIMIT = INT_MAX / 2;
+
+extern "C" EdlibColumnState* edlibColumnStateBegin(const EdlibQueryProfile* const profile,
+                                                   const EdlibAlignMode mode, const int k) {
+    EdlibColumnState* state = new EdlibColumnState();
+    state->profile = profile;
+    state->mode = mode;
+    const int queryLength = profile->queryLength;
+    if (mode == EDLIB_MODE_NW) {
+        state->k = k < 0 ? NO_K_LIMIT : k;
+    } else {  // Best score is never larger than queryLength.
+        state->k = k < 0 ? queryLength : min(k, queryLength);
+    }
+    state->position = 0;
+    state->firstBlock = 0;
+    state->lastBlock = min(ceilDiv(state->k + 1, WORD_SIZE), profile->maxNumBlocks) - 1;
+    state->blocks.resize(profile->maxNumBlocks);
+    for (int b = 0; b <= state->lastBlock; b++) {
+        state->blocks[b] = Block(static_cast<Word>(-1), static_cast<Word>(0), (b + 1) * WORD_SIZE);
+    }
+    state->bestScore = -1;
+    state->tightenK = true;
+    return state;
+}
+
+extern "C" int edlibColumnStateAdvance(EdlibColumnState* const state, const char* const target,
+                                       const int targetLength) {
+    if (targetLength < 0) return EDLIB_STATUS_ERROR;
+    const EdlibQueryProfile& profile = *state->profile;
+    const int maxNumBlocks = profile.maxNumBlocks;
+    const int W = profile.W;
+    Block* const blocks = state->blocks.data();
+    int k = state->k;
+    int firstBlock = state->firstBlock;
+    int lastBlock = state->lastBlock;
+
+    // Loop is same as in myersCalcEditDistanceSemiGlobal(), except that best score is kept in state.
+    for (int i = 0; i < targetLength && firstBlock <= lastBlock; i++) {
+        const long long c = state->position + i;
+        const Word* const Peq_c = profile.Peq + profile.symbols[static_cast<unsigned char>(target[i])] * maxNumBlocks;
+        advanceColumn(blocks, &firstBlock, &lastBlock, Peq_c, k, maxNumBlocks, state->mode,
+                      c % STRONG_REDUCE_NUM == 0);
+
+        //------------------------- Update best score ----------------------//
+        if (state->mode != EDLIB_MODE_NW && firstBlock <= lastBlock && lastBlock == maxNumBlocks - 1) {
+            const int colScore = blocks[lastBlock].score;
+            if (colScore <= k && (state->bestScore == -1 || colScore <= state->bestScore)) {
+                if (colScore != state->bestScore) {
+                    state->positions.clear();
+                    state->bestScore = colScore;
+                    if (state->tightenK) k = colScore;
+                }
+                state->positions.push_back(c - W);
+            }
+        }
+        //------------------------------------------------------------------//
+    }
+
+    state->k = k;
+    state->firstBlock = firstBlock;
+    state->lastBlock = lastBlock;
+    state->position += targetLength;
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" EdlibColumnState* edlibColumnStateCopy(const EdlibColumnState* const state) {
+    return new EdlibColumnState(*state);
+}
+
+extern "C" int edlibColumnStateSetK(EdlibColumnState* const state, const int k) {
+    const int newK = k < 0 ? (state->mode == EDLIB_MODE_NW ? NO_K_LIMIT : state->profile->queryLength) : k;
+    if (newK > state->k) return EDLIB_STATUS_ERROR;
+    state->k = newK;
+    if (state->bestScore > newK) {
+        state->bestScore = -1;
+        state->positions.clear();
+    }
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" long long edlibColumnStatePosition(const EdlibColumnState* const state) {
+    return state->position;
+}
+
+/**
+ * @param [in] state  State at end of target.
+ * @param [in] bestScore  Best score found in semi-global modes, -1 if none.
+ * @param [in] bestPositions  Positions where best score was found, in semi-global modes.
+ *                            Scores of last W positions are obtained from state.
+ * @return Result as described for edlibColumnStateResult().
+ */
+static EdlibStreamResult columnStateResult(const EdlibColumnState& state, const int bestScore_,
+                                           const vector<long long>& bestPositions) {
+    EdlibStreamResult result;
+    result.status = EDLIB_STATUS_OK;
+    result.editDistance = -1;
+    result.endLocations = NULL;
+    result.numLocations = 0;
+
+    const int queryLength = state.profile->queryLength;
+    const int W = state.profile->W;
+    const int maxNumBlocks = state.profile->maxNumBlocks;
+    const bool lastBlockInBand = state.firstBlock <= state.lastBlock && state.lastBlock == maxNumBlocks - 1;
+    vector<long long> positions;
+    if (queryLength == 0 || state.position == 0) {
+        // Same as in alignTransformed().
+        result.editDistance = state.mode == EDLIB_MODE_NW
+            ? static_cast<int>(max(static_cast<long long>(queryLength), state.position)) : queryLength;
+        positions.push_back(state.mode == EDLIB_MODE_NW ? state.position - 1 : -1);
+    } else if (state.mode == EDLIB_MODE_NW) {
+        if (lastBlockInBand) {
+            const int score = getBlockCellValues(state.blocks[maxNumBlocks - 1])[W];
+            if (score <= state.k) {
+                result.editDistance = score;
+                positions.push_back(state.position - 1);
+            }
+        }
+    } else {
+        // Scores of last W positions are obtained from last column, same as in myersCalcEditDistanceSemiGlobal().
+        int k = state.k;
+        int bestScore = bestScore_;
+        positions = bestPositions;
+        if (lastBlockInBand) {
+            const vector<int> blockScores = getBlockCellValues(state.blocks[maxNumBlocks - 1]);
+            for (int i = 0; i < W; i++) {
+                const int colScore = blockScores[i + 1];
+                if (colScore <= k && (bestScore == -1 || colScore <= bestScore)) {
+                    if (colScore != bestScore) {
+                        positions.clear();
+                        k = bestScore = colScore;
+                    }
+                    positions.push_back(state.position - W + i);
+                }
+            }
+        }
+        result.editDistance = bestScore;
+    }
+
+    if (result.editDistance != -1) {
+        result.numLocations = static_cast<int>(positions.size());
+        result.endLocations = allocateResultArray<long long>(result.numLocations);
+        copy(positions.begin(), positions.end(), result.endLocations);
+    }
+    return result;
+}
+
+extern "C" EdlibStreamResult edlibColumnStateResult(const EdlibColumnState* const state) {
+    return columnStateResult(*state, state->bestScore, state->positions);
+}
+
+extern "C" void edlibFreeColumnState(EdlibColumnState* const state) {
+    delete state;
+}
+
+/**
+ * Search over target that is given in chunks. Each chunk advances column state right away, so characters are
+ * computed once and none of them are kept. In SHW mode, band becomes empty after first queryLength + k
+ * characters, so rest of target costs nothing.
+ */
+struct EdlibStream {
+    EdlibColumnState* state;
+};
+
+extern "C" EdlibStream* edlibStreamBegin(const EdlibQueryProfile* const profile, const EdlibAlignMode mode,
+                                         const int k) {
+    if (mode != EDLIB_MODE_HW && mode != EDLIB_MODE_SHW) return NULL;
+    EdlibStream* stream = new EdlibStream();
+    stream->state = edlibColumnStateBegin(profile, mode, k);
+    return stream;
+}
+
+extern "C" int edlibStreamFeed(EdlibStream* const stream, const char* const chunk, const int chunkLength) {
+    return edlibColumnStateAdvance(stream->state, chunk, chunkLength);
+}
+
+extern "C" EdlibStreamResult edlibStreamEnd(EdlibStream* const stream) {
+    const EdlibStreamResult result = edlibColumnStateResult(stream->state);
+    edlibFreeColumnState(stream->state);
+    delete stream;
+    return result;
+}
+
+extern "C" void edlibFreeStreamResult(EdlibStreamResult result) {
+    freeResultArray(result.endLocations);
+}
+
+/**
+ * Completes result of aligning query to target, whose edit distance and end locations are already found,
+ * with start locations and alignment path if task asks for them, same as alignTransformed() does.
+ * Start locations are found same as in alignTransformed(), but only in part of target that alignment
+ * ending at end location can span.
+ * @param [in] targetRange  targetRange(start, end, &scratch) returns pointer to characters [start, end) of target,
+ *                          which it may copy to scratch.
+ */
+template <class TargetRange>
+static void findStartLocationsAndAlignment(const char* const query, const int queryLength,
+                                           const TargetRange& targetRange, const int targetLength,
+                                           const EdlibAlignConfig& config, EdlibAlignResult* const result) {
+    // Same as in alignTransformed(), nothing else is found if one of sequences is empty.
+    if (result->editDistance == -1 || config.task == EDLIB_TASK_DISTANCE || queryLength == 0 || targetLength == 0) {
+        return;
+    }
+
+    result->startLocations = allocateResultArray<int>(result->numLocations);
+    vector<char> rQuery(query, query + queryLength);
+    reverse(rQuery.begin(), rQuery.end());
+    vector<char> scratch;
+    for (int i = 0; i < result->numLocations; i++) {
+        const int endLocation = result->endLocations[i];
+        result->startLocations[i] = 0;
+        if (config.mode != EDLIB_MODE_HW || endLocation == -1) continue;
+        const int windowStart = max(0, endLocation - (queryLength + result->editDistance) + 1);
+        const char* const window = targetRange(windowStart, endLocation + 1, &scratch);
+        vector<char> rWindow(window, window + endLocation + 1 - windowStart);
+        reverse(rWindow.begin(), rWindow.end());
+        EdlibAlignConfig shwConfig = config;
+        shwConfig.k = result->editDistance;
+        shwConfig.mode = EDLIB_MODE_SHW;
+        shwConfig.task = EDLIB_TASK_DISTANCE;
+        EdlibAlignResult shwResult = edlibAlign(rQuery.data(), queryLength,
+                                                rWindow.data(), static_cast<int>(rWindow.size()), shwConfig);
+        // Taking last location as start ensures that alignment will not start with insertions
+        // if it can start with mismatches instead.
+        result->startLocations[i] = endLocation - shwResult.endLocations[shwResult.numLocations - 1];
+        edlibFreeAlignResult(shwResult);
+    }
+
+    if (config.task == EDLIB_TASK_PATH) {
+        const int alnStart = result->startLocations[0];
+        if (result->endLocations[0] < alnStart) {
+            // Empty part of target is aligned, which edlibAlign() does not handle, so all of query is inserted.
+            result->alignmentLength = queryLength;
+            result->alignment = allocateResultArray<unsigned char>(queryLength);
+            memset(result->alignment, EDLIB_EDOP_INSERT, queryLength);
+            return;
+        }
+        EdlibAlignConfig nwConfig = config;
+        nwConfig.k = result->editDistance;
+        nwConfig.mode = EDLIB_MODE_NW;
+        EdlibAlignResult nwResult = edlibAlign(query, queryLength,
+                                               targetRange(alnStart, result->endLocations[0] + 1, &scratch),
+                                               result->endLocations[0] - alnStart + 1, nwConfig);
+        result->alignment = nwResult.alignment;
+        result->alignmentLength = nwResult.alignmentLength;
+        nwResult.alignment = NULL;
+        edlibFreeAlignResult(nwResult);
+    }
+}
+
+/**
+ * Text with gap at position of last edit, so that edit moves only characters between it and previous edit,
+ * instead of all characters after it.
+ */
+class GapBuffer {
+private:
+    vector<char> buffer;
+    size_t gapStart;
+    size_t gapEnd;  // Gap is [gapStart, gapEnd) of buffer.
+
+    void moveGap(const size_t position) {
+        const size_t gapLength = gapEnd - gapStart;
+        if (position < gapStart) {
+            memmove(buffer.data() + position + gapLength, buffer.data() + position, gapStart - position);
+        } else if (position > gapStart) {
+            memmove(buffer.data() + gapStart, buffer.data() + gapEnd, position - gapStart);
+        }
+        gapStart = position;
+        gapEnd = position + gapLength;
+    }
+
+public:
+    GapBuffer() : gapStart(0), gapEnd(0) {}
+
+    void assign(const char* const text, const size_t length) {
+        buffer.assign(text, text + length);
+        gapStart = gapEnd = length;
+    }
+
+    size_t size() const {
+        return buffer.size() - (gapEnd - gapStart);
+    }
+
+    /**
+     * Replaces deletedLength characters starting at position with insertedLength given characters.
+     */
+    void replace(const size_t position, const size_t deletedLength,
+                 const char* const inserted, const size_t insertedLength) {
+        moveGap(position);
+        gapEnd += deletedLength;
+        if (gapEnd - gapStart < insertedLength) {  // Gap is grown together with text, so that it rarely grows.
+            const size_t newGapLength = insertedLength + max<size_t>(1 << 12, size() / 8);
+            const size_t tailLength = buffer.size() - gapEnd;
+            buffer.resize(gapStart + newGapLength + tailLength);
+            memmove(buffer.data() + gapStart + newGapLength, buffer.data() + gapEnd, tailLength);
+            gapEnd = gapStart + newGapLength;
+        }
+        if (insertedLength > 0) memcpy(buffer.data() + gapStart, inserted, insertedLength);
+        gapStart += insertedLength;
+    }
+
+    /**
+     * Calls visit(chunk, chunkLength) for each contiguous part of characters [start, end) of text, in order.
+     */
+    template <class Visit>
+    void forEachChunk(const size_t start, const size_t end, Visit visit) const {
+        if (start < min(end, gapStart)) visit(buffer.data() + start, min(end, gapStart) - start);
+        if (end > max(start, gapStart)) {
+            visit(buffer.data() + max(start, gapStart) + (gapEnd - gapStart), end - max(start, gapStart));
+        }
+    }
+
+    /**
+     * @return Pointer to characters [start, end) of text, which are copied to scratch if gap is among them.
+     */
+    const char* range(const size_t start, const size_t end, vector<char>* const scratch) const {
+        if (end <= gapStart) return buffer.data() + start;
+        if (start >= gapStart) return buffer.data() + start + (gapEnd - gapStart);
+        scratch->clear();
+        forEachChunk(start, end, [scratch](const char* const chunk, const size_t chunkLength) {
+            scratch->insert(scratch->end(), chunk, chunk + chunkLength);
+        });
+        return scratch->data();
+    }
+};
+
+/**
+ * Part of target between two checkpoints of incremental alignment.
+ */
+struct IncrementalSegment {
+    EdlibColumnState start;  // State before first column of segment, without best score.
+    // Best score found in columns of segment (-1 if none) and positions where it was found.
+    int bestScore;
+    vector<long long> positions;
+};
+
+/**
+ * Alignment is computed column by column with column states whose k is not lowered, so that state at any
+ * column depends only on target before it. Target is divided into segments, and state at start of each one
+ * is remembered, together with best score found inside it. After edit, segments are computed again from
+ * the one that contains edit, until state at start of some old segment after edit is computed again
+ * and it is the same as before, up to offset of all scores (in NW and SHW, edit usually raises all scores after it
+ * by same amount): from there on, old segments are reused (moved by change in target length, scores raised by offset).
+ */
+struct EdlibIncrementalAlignment {
+    vector<char> query;
+    GapBuffer target;
+    long long targetCharCounts[MAX_UCHAR + 1];  // Number of occurrences of each character in target.
+    EdlibAlignConfig config;  // Its equalities are replaced with equalitySet.
+    unique_ptr<EdlibEqualitySet> equalitySet;
+    EdlibQueryProfile* profile;
+    int k;  // k that alignment is computed with. If config.k is negative, it is doubled until result is found.
+    int segmentLength;  // Maximal length of segment.
+    vector<IncrementalSegment> segments;
+    EdlibColumnState end;  // State at end of target.
+
+    ~EdlibIncrementalAlignment() {
+        edlibFreeQueryProfile(profile);
+    }
+};
+
+/**
+ * Checks if column of new state is same as column of old state, up to score offset: in NW and SHW, edit before
+ * column raises or lowers all cells of it by same amount, and columns after it stay different by that amount.
+ * Offset must not be negative, since cells that are larger than k in old state (and were not kept by its band)
+ * may be <= k in new one. Since scores of new state are larger, its band may be narrower than that of old one,
+ * which is fine as long as cells that only old band has are larger than k even without offset, so they do not
+ * lead to any cell <= k later.
+ * @param [in] a  New state.
+ * @param [in] b  Old state.
+ * @param [out] offset  Set to amount by which cells of a are larger than those of b.
+ * @return True if differences between cells (P and M) are same in both states in band of a, cells of a are larger
+ *         than those of b by same non-negative offset, and cells of b outside of band of a are larger than k - offset.
+ */
+static bool isSameColumn(const EdlibColumnState& a, const EdlibColumnState& b, int* const offset) {
+    if (a.firstBlock > a.lastBlock || b.firstBlock > b.lastBlock) {
+        *offset = 0;
+        return a.firstBlock > a.lastBlock && b.firstBlock > b.lastBlock;
+    }
+    if (a.firstBlock < b.firstBlock || a.lastBlock > b.lastBlock) return false;
+    *offset = a.blocks[a.firstBlock].score - b.blocks[a.firstBlock].score;
+    if (*offset < 0) return false;
+    for (int i = a.firstBlock; i <= a.lastBlock; i++) {
+        const Block& blockA = a.blocks[i];
+        const Block& blockB = b.blocks[i];
+        if (blockA.P != blockB.P || blockA.M != blockB.M) return false;
+    }
+    for (int i = b.firstBlock; i <= b.lastBlock; i++) {
+        if ((i < a.firstBlock || i > a.lastBlock) && !allBlockCellsLarger(b.blocks[i], b.k - *offset)) return false;
+    }
+    return true;
+}
+
+/**
+ * Raises scores of cells in band of state by offset, and moves it by shift along target.
+ */
+static void moveColumnState(EdlibColumnState* const state, const int offset, const long long shift) {
+    for (int i = state->firstBlock; i <= state->lastBlock; i++) state->blocks[i].score += offset;
+    state->position += shift;
+}
+
+/**
+ * Computes segments of incremental alignment again from segment with given index on.
+ * @param [in] firstSegment  Index of first segment whose start state is still valid, but whose columns changed.
+ * @param [in] oldSegments  Segments before target was changed.
+ * @param [in] oldEnd  State at end of target before it was changed.
+ * @param [in] oldReuseStart  Old segments can be reused only if they start at or after this position (in old
+ *                            target), which is first position after changed part of target.
+ * @param [in] shift  Change of target length, by which positions of reused old segments are moved.
+ */
+static void recomputeIncremental(EdlibIncrementalAlignment* const alignment, const size_t firstSegment,
+                                 vector<IncrementalSegment>& oldSegments, EdlibColumnState& oldEnd,
+                                 const long long oldReuseStart, const long long shift) {
+    vector<IncrementalSegment>& segments = alignment->segments;
+    EdlibColumnState state = segments[firstSegment].start;
+    segments.resize(firstSegment);
+    const long long targetLength = static_cast<long long>(alignment->target.size());
+    size_t old = 0;  // First old segment that could still be reused.
+    while (true) {
+        while (old < oldSegments.size() && (oldSegments[old].start.position < oldReuseStart
+                                            || oldSegments[old].start.position + shift < state.position)) {
+            old++;
+        }
+        if (old < oldSegments.size() && oldSegments[old].start.position + shift == state.position) {
+            int offset;
+            if (isSameColumn(state, oldSegments[old].start, &offset)) {  // Rest of alignment is same up to offset.
+                for (; old < oldSegments.size(); old++) {
+                    IncrementalSegment& segment = oldSegments[old];
+                    moveColumnState(&segment.start, offset, shift);
+                    if (segment.bestScore != -1 && segment.bestScore + offset > alignment->k) {
+                        segment.bestScore = -1;
+                        segment.positions.clear();
+                    } else if (segment.bestScore != -1) {
+                        segment.bestScore += offset;
+                    }
+                    for (size_t i = 0; i < segment.positions.size(); i++) segment.positions[i] += shift;
+                    segments.push_back(std::move(segment));
+                }
+                alignment->end = std::move(oldEnd);
+                moveColumnState(&alignment->end, offset, shift);
+                return;
+            }
+            old++;
+        }
+        if (state.position == targetLength && !segments.empty()) break;
+
+        // Segment ends where next old segment starts, so that they can be compared.
+        long long segmentEnd = min(targetLength, state.position + alignment->segmentLength);
+        if (old < oldSegments.size()) segmentEnd = min(segmentEnd, oldSegments[old].start.position + shift);
+        IncrementalSegment segment;
+        segment.start = state;
+        alignment->target.forEachChunk(state.position, segmentEnd, [&state](const char* const chunk,
+                                                                            const size_t chunkLength) {
+            edlibColumnStateAdvance(&state, chunk, static_cast<int>(chunkLength));
+        });
+        segment.bestScore = state.bestScore;
+        segment.positions.swap(state.positions);
+        state.bestScore = -1;
+        segments.push_back(segment);
+        if (state.position == targetLength) break;
+    }
+    alignment->end = state;
+}
+
+/**
+ * @return Best score of incremental alignment (-1 if there is none) and positions where it is found.
+ */
+static EdlibStreamResult incrementalResult(const EdlibIncrementalAlignment& alignment) {
+    int bestScore = -1;
+    vector<long long> positions;
+    for (size_t i = 0; i < alignment.segments.size(); i++) {
+        const IncrementalSegment& segment = alignment.segments[i];
+        if (segment.bestScore == -1 || (bestScore != -1 && segment.bestScore > bestScore)) continue;
+        if (segment.bestScore != bestScore) {
+            bestScore = segment.bestScore;
+            positions.clear();
+        }
+        positions.insert(positions.end(), segment.positions.begin(), segment.positions.end());
+    }
+    return columnStateResult(alignment.end, bestScore, positions);
+}
+
+/**
+ * Computes incremental alignment from start, with k raised until result is found if k is not given.
+ */
+static void buildIncremental(EdlibIncrementalAlignment* const alignment) {
+    const int queryLength = static_cast<int>(alignment->query.size());
+    const int targetLength = static_cast<int>(alignment->target.size());
+    const EdlibAlignMode mode = alignment->config.mode;
+    // With this k, result is certainly found.
+    const int maxK = mode == EDLIB_MODE_NW ? max(queryLength, targetLength) : queryLength;
+    while (true) {
+        EdlibColumnState* state = edlibColumnStateBegin(alignment->profile, mode, alignment->k);
+        state->tightenK = false;
+        alignment->segments.assign(1, IncrementalSegment());
+        alignment->segments[0].start = *state;
+        edlibFreeColumnState(state);
+        vector<IncrementalSegment> noSegments;
+        EdlibColumnState noEnd;
+        recomputeIncremental(alignment, 0, noSegments, noEnd, 0, 0);
+
+        EdlibStreamResult result = incrementalResult(*alignment);
+        const bool found = result.editDistance != -1;
+        edlibFreeStreamResult(result);
+        if (found || alignment->config.k >= 0 || alignment->k >= maxK) return;
+        alignment->k = min(maxK, alignment->k * 2);
+    }
+}
+
+extern "C" EdlibIncrementalAlignment* edlibIncrementalBegin(const char* const query, const int queryLength,
+                                                            const char* const target, const int targetLength,
+                                                            const EdlibAlignConfig config) {
+    EdlibIncrementalAlignment* alignment = new EdlibIncrementalAlignment();
+    alignment->query.assign(query, query + queryLength);
+    alignment->target.assign(target, targetLength);
+    memset(alignment->targetCharCounts, 0, sizeof(alignment->targetCharCounts));
+    for (int i = 0; i < targetLength; i++) alignment->targetCharCounts[static_cast<unsigned char>(target[i])]++;
+    // Equalities are copied, since config does not own them.
+    const shared_ptr<const EdlibEqualitySet> equalities = configEqualitySet(config);
+    if (equalities != NULL) alignment->equalitySet.reset(new EdlibEqualitySet(*equalities));
+    alignment->config = config;
+    alignment->config.additionalEqualities = NULL;
+    alignment->config.additionalEqualitiesLength = 0;
+    alignment->config.equalityPresets = 0;
+    alignment->config.equalitySet = alignment->equalitySet.get();
+    alignment->profile = edlibNewQueryProfile(query, queryLength, alignment->config);
+    alignment->k = config.k >= 0 ? config.k : WORD_SIZE;
+    // There are at most about 64 segments (plus those split by edits), to limit memory for their states.
+    alignment->segmentLength = max(1 << 12, targetLength / 64);
+    buildIncremental(alignment);
+    return alignment;
+}
+
+extern "C" int edlibIncrementalEdit(EdlibIncrementalAlignment* const alignment, const int position,
+                                    const int deletedLength, const char* const inserted, const int insertedLength) {
+    GapBuffer& target = alignment->target;
+    if (position < 0 || deletedLength < 0 || insertedLength < 0
+        || position > static_cast<int>(target.size()) - deletedLength) {
+        return EDLIB_STATUS_ERROR;
+    }
+    target.forEachChunk(position, position + deletedLength, [alignment](const char* const chunk,
+                                                                        const size_t chunkLength) {
+        for (size_t i = 0; i < chunkLength; i++) alignment->targetCharCounts[static_cast<unsigned char>(chunk[i])]--;
+    });
+    for (int i = 0; i < insertedLength; i++) alignment->targetCharCounts[static_cast<unsigned char>(inserted[i])]++;
+    target.replace(position, deletedLength, inserted, insertedLength);
+
+    // Last segment that starts at or before edit is still valid at its start.
+    size_t firstSegment = 0;
+    while (firstSegment + 1 < alignment->segments.size()
+           && alignment->segments[firstSegment + 1].start.position <= position) {
+        firstSegment++;
+    }
+    vector<IncrementalSegment> oldSegments(make_move_iterator(alignment->segments.begin() + firstSegment + 1),
+                                           make_move_iterator(alignment->segments.end()));
+    EdlibColumnState oldEnd = std::move(alignment->end);
+    recomputeIncremental(alignment, firstSegment, oldSegments, oldEnd, position + deletedLength,
+                         insertedLength - deletedLength);
+
+    EdlibStreamResult result = incrementalResult(*alignment);
+    if (result.editDistance == -1 && alignment->config.k < 0) {  // k is too small now.
+        buildIncremental(alignment);
+    }
+    edlibFreeStreamResult(result);
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" EdlibAlignResult edlibIncrementalResult(const EdlibIncrementalAlignment* const alignment) {
+    const EdlibAlignConfig& config = alignment->config;
+    const char* const query = alignment->query.data();
+    const int queryLength = static_cast<int>(alignment->query.size());
+    const GapBuffer& target = alignment->target;
+    const int targetLength = static_cast<int>(target.size());
+
+    EdlibAlignResult result;
+    result.status = EDLIB_STATUS_OK;
+    result.endLocations = result.startLocations = NULL;
+    result.numLocations = 0;
+    result.alignment = NULL;
+    result.alignmentLength = 0;
+    // Alphabet depends only on which characters target contains, so they are given instead of whole target.
+    string targetChars;
+    for (int c = 0; c <= MAX_UCHAR; c++) {
+        if (alignment->targetCharCounts[c] > 0) targetChars += static_cast<char>(c);
+    }
+    unsigned char* queryTransformed;
+    unsigned char targetSymbols[MAX_UCHAR + 1];
+    transformSequences(query, queryLength, targetChars.data(), static_cast<int>(targetChars.size()),
+                       alignment->equalitySet.get(), &queryTransformed, targetSymbols, &result.alphabetLength);
+    free(queryTransformed);
+
+    EdlibStreamResult locations = incrementalResult(*alignment);
+    result.editDistance = locations.editDistance;
+    if (locations.editDistance != -1) {
+        result.numLocations = locations.numLocations;
+        result.endLocations = static_cast<int *>(malloc(sizeof(int) * result.numLocations));
+        for (int i = 0; i < result.numLocations; i++) {
+            result.endLocations[i] = static_cast<int>(locations.endLocations[i]);
+        }
+    }
+    edlibFreeStreamResult(locations);
+    findStartLocationsAndAlignment(query, queryLength,
+                                   [&target](const int start, const int end, vector<char>* const scratch) {
+                                       return target.range(start, end, scratch);
+                                   },
+                                   targetLength, config, &result);
+    return result;
+}
+
+extern "C" void edlibFreeIncrementalAlignment(EdlibIncrementalAlignment* const alignment) {
+    delete alignment;
+}
+
+/**
+ * Block of rows of queries that are aligned together (see alignQueryTrie()).
+ */
+struct QueryTrieNode {
+    int parent;  // -1 if block is first block of queries.
+    int depth;  // Index of block in queries.
+    vector<int> children;
+    vector<int> queries;  // Queries whose last block this is.
+    // Peq[symbol] of rows of block, last block of query is padded with wildcards same as in buildPeq().
+    vector<Word> Peq;
+    int k;  // Largest k of queries that contain block.
+    // State of block in current column, valid only while block is in band.
+    bool inBand;
+    long long leftBandAt;  // Column in which block last left band, -1 if never.
+    Block block;
+    int hout;
+};
+
+/**
+ * Query that is aligned in trie of queries.
+ */
+struct QueryTrieQuery {
+    int length;
+    int lastNode;  // -1 if query is empty.
+    int k;
+    int bestScore;
+    vector<long long> positions;
+};
+
+/**
+ * Computes edit distance and end locations of each query, same as edlibColumnStateResult() would after
+ * whole target is given to column state of query with its k.
+ * Queries are sorted and put into trie of blocks of WORD_SIZE rows, so that queries which start with
+ * the same rows share blocks of them, and each block is computed only once per column of target.
+ * Blocks in band of query are always prefix of its blocks, so band is adjusted same as in
+ * advanceColumn(), with block whose children are not in band taking role of last block.
+ * Band of shared block is computed with largest k of queries that contain it, which only makes it wider.
+ * @param [in] queries  Transformed queries.
+ * @param [in] queryLengths
+ * @param [in] ks  k of each query, not larger than queryLength in semi-global modes.
+ * @return Result of each query, free them with edlibFreeStreamResult().
+ */
+static vector<EdlibStreamResult> alignQueryTrie(const vector<const unsigned char*>& queries,
+                                                const vector<int>& queryLengths, const vector<int>& ks,
+                                                const char* const target, const int targetLength,
+                                                const unsigned char* const targetSymbols,
+                                                const int alphabetLength,
+                                                const EqualityDefinition& equalityDefinition,
+                                                const EdlibAlignMode mode) {
+    const int numQueries = static_cast<int>(queries.size());
+
+    //----------------------------- Build trie -----------------------------//
+    // Queries that share first blocks are next to each other once sorted, so each query shares blocks
+    // only with previous one.
+    vector<int> order(numQueries);
+    for (int q = 0; q < numQueries; q++) order[q] = q;
+    sort(order.begin(), order.end(), [&](const int a, const int b) {
+        return lexicographical_compare(queries[a], queries[a] + queryLengths[a],
+                                       queries[b], queries[b] + queryLengths[b]);
+    });
+    vector<QueryTrieNode> nodes;
+    vector<QueryTrieQuery> trieQueries(numQueries);
+    vector<int> path, previousPath;
+    int previous = -1;
+    for (const int q : order) {
+        const int queryLength = queryLengths[q];
+        const int numBlocks = ceilDiv(queryLength, WORD_SIZE);
+        path.clear();
+        for (int b = 0; b < numBlocks; b++) {
+            const int start = b * WORD_SIZE;
+            const int blockLength = min(WORD_SIZE, queryLength - start);
+            const bool shared = previous != -1 && b < static_cast<int>(previousPath.size())
+                && (b == 0 || path[b - 1] == previousPath[b - 1])
+                && min(WORD_SIZE, queryLengths[previous] - start) == blockLength
+                && equal(queries[q] + start, queries[q] + start + blockLength, queries[previous] + start);
+            if (shared) {
+                path.push_back(previousPath[b]);
+            } else {
+                QueryTrieNode node;
+                node.parent = b == 0 ? -1 : path[b - 1];
+                node.depth = b;
+                Word* const Peq = buildPeq(alphabetLength, queries[q] + start, blockLength, equalityDefinition);
+                node.Peq.assign(Peq, Peq + alphabetLength);
+                delete[] Peq;
+                node.k = 0;
+                node.inBand = false;
+                node.leftBandAt = -1;
+                path.push_back(static_cast<int>(nodes.size()));
+                if (node.parent != -1) nodes[node.parent].children.push_back(path.back());
+                nodes.push_back(node);
+            }
+            nodes[path[b]].k = max(nodes[path[b]].k, ks[q]);
+        }
+        if (numBlocks > 0) nodes[path.back()].queries.push_back(q);
+        trieQueries[q].length = queryLength;
+        trieQueries[q].lastNode = numBlocks > 0 ? path.back() : -1;
+        trieQueries[q].k = ks[q];
+        trieQueries[q].bestScore = -1;
+        path.swap(previousPath);
+        previous = q;
+    }
+    //----------------------------------------------------------------------//
+
+    // Nodes in band, parents always come before their children (same as in nodes).
+    vector<int> inBand, entered, nextInBand;
+    for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+        QueryTrieNode& node = nodes[i];
+        if (node.depth < ceilDiv(node.k + 1, WORD_SIZE)) {
+            node.inBand = true;
+            node.block = Block(static_cast<Word>(-1), static_cast<Word>(0), (node.depth + 1) * WORD_SIZE);
+            inBand.push_back(i);
+        }
+    }
+
+    const int startHout = mode == EDLIB_MODE_HW ? 0 : 1; // If 0 then gap before query is not penalized;
+    for (int c = 0; c < targetLength && !inBand.empty(); c++) {
+        const unsigned char symbol = targetSymbols[static_cast<unsigned char>(target[c])];
+
+        //----------------------- Calculate column -------------------------//
+        for (const int i : inBand) {
+            QueryTrieNode& node = nodes[i];
+            const int hin = node.parent == -1 ? startHout : nodes[node.parent].hout;
+            node.hout = calculateBlock(node.block.P, node.block.M, node.Peq[symbol], hin,
+                                       node.block.P, node.block.M);
+            node.block.score += node.hout;
+        }
+        //------------------------------------------------------------------//
+
+        //---------- Adjust number of blocks according to Ukkonen ----------//
+        // Children are visited before parents, so that parent knows if it is last block in band of its queries.
+        entered.clear();
+        for (int j = static_cast<int>(inBand.size()) - 1; j >= 0; j--) {
+            QueryTrieNode& node = nodes[inBand[j]];
+            bool isLast = true;
+            for (const int child : node.children) {
+                QueryTrieNode& childNode = nodes[child];
+                if (childNode.inBand) {
+                    isLast = false;
+                } else if (childNode.leftBandAt != c
+                           && blockEntersBand(node.block, node.hout, childNode.Peq[symbol], childNode.k)) {
+                    childNode.block = enteringBlock(node.block, node.hout, childNode.Peq[symbol]);
+                    childNode.inBand = true;
+                    entered.push_back(child);
+                    isLast = false;
+                }
+            }
+            if (isLast && (mode != EDLIB_MODE_HW || node.parent != -1)
+                && blockLeavesBand(node.block, node.k, c % STRONG_REDUCE_NUM == 0)) {
+                node.inBand = false;
+                node.leftBandAt = c;
+            }
+        }
+        nextInBand.clear();
+        sort(entered.begin(), entered.end());
+        vector<int>::const_iterator enteredIt = entered.begin();
+        for (const int i : inBand) {
+            for (; enteredIt != entered.end() && *enteredIt < i; ++enteredIt) nextInBand.push_back(*enteredIt);
+            if (nodes[i].inBand) nextInBand.push_back(i);
+        }
+        nextInBand.insert(nextInBand.end(), enteredIt, entered.cend());
+        inBand.swap(nextInBand);
+        //------------------------------------------------------------------//
+
+        //------------------------- Update best score ----------------------//
+        if (mode != EDLIB_MODE_NW) {
+            for (const int i : inBand) {
+                const QueryTrieNode& node = nodes[i];
+                for (const int q : node.queries) {
+                    QueryTrieQuery& query = trieQueries[q];
+                    const int colScore = node.block.score;
+                    if (colScore <= query.k && (query.bestScore == -1 || colScore <= query.bestScore)) {
+                        if (colScore != query.bestScore) {
+                            query.positions.clear();
+                            query.k = query.bestScore = colScore;
+                        }
+                        const int W = ceilDiv(query.length, WORD_SIZE) * WORD_SIZE - query.length;
+                        query.positions.push_back(c - W);
+                    }
+                }
+            }
+        }
+        //------------------------------------------------------------------//
+    }
+
+    // Result is obtained from column state made of blocks of query.
+    vector<EdlibStreamResult> results(numQueries);
+    for (int q = 0; q < numQueries; q++) {
+        const QueryTrieQuery& query = trieQueries[q];
+        EdlibQueryProfile profile;
+        profile.queryLength = query.length;
+        profile.maxNumBlocks = ceilDiv(query.length, WORD_SIZE);
+        profile.W = profile.maxNumBlocks * WORD_SIZE - query.length;
+        profile.Peq = NULL;
+        EdlibColumnState state;
+        state.profile = &profile;
+        state.mode = mode;
+        state.k = query.k;
+        state.position = targetLength;
+        state.firstBlock = 0;
+        state.blocks.resize(profile.maxNumBlocks);
+        state.lastBlock = -1;
+        for (int i = query.lastNode; i != -1; i = nodes[i].parent) {
+            state.blocks[nodes[i].depth] = nodes[i].block;
+            if (nodes[i].inBand && state.lastBlock == -1) state.lastBlock = nodes[i].depth;
+        }
+        results[q] = columnStateResult(state, query.bestScore, query.positions);
+    }
+    return results;
+}
+
+/**
+ * Implements edlibAlignQueries(), but gives each result to storeResult(query, &result) as soon as it is found,
+ * in no particular order of queries. storeResult takes over arrays of result.
+ * @param [in] useScratch  If true, arrays of results are taken from scratch, which is reset after each round
+ *                         of results is stored, so storeResult must copy them.
+ */
+template <class StoreResult>
+static int alignQueries(const char* const* const queries, const int* const queryLengths,
+                        const int numQueries, const char* const target, const int targetLength,
+                        const EdlibAlignConfig& config, const bool useScratch, const StoreResult& storeResult) {
+    if (numQueries < 0 || targetLength < 0) return EDLIB_STATUS_ERROR;
+    for (int q = 0; q < numQueries; q++) {
+        if (queryLengths[q] < 0) return EDLIB_STATUS_ERROR;
+    }
+
+    // Alphabet depends only on which characters target contains, so only they are given instead of target.
+    bool inTarget[MAX_UCHAR + 1];
+    for (int i = 0; i <= MAX_UCHAR; i++) inTarget[i] = false;
+    for (int i = 0; i < targetLength; i++) inTarget[static_cast<unsigned char>(target[i])] = true;
+    string targetChars;
+    for (int i = 0; i <= MAX_UCHAR; i++) {
+        if (inTarget[i]) targetChars += static_cast<char>(i);
+    }
+    const int numTargetChars = static_cast<int>(targetChars.size());
+
+    // All queries are transformed together, so that they have the same alphabet.
+    string allQueries;
+    vector<int> queryStarts(numQueries);
+    for (int q = 0; q < numQueries; q++) {
+        queryStarts[q] = static_cast<int>(allQueries.size());
+        allQueries.append(queries[q], queryLengths[q]);
+    }
+    const shared_ptr<const EdlibEqualitySet> equalities = configEqualitySet(config);
+    unsigned char* allTransformed;
+    unsigned char targetSymbols[MAX_UCHAR + 1];
+    int numDistinctChars;
+    const string alphabet = transformSequences(allQueries.data(), static_cast<int>(allQueries.size()),
+                                               targetChars.data(), numTargetChars, equalities.get(),
+                                               &allTransformed, targetSymbols, &numDistinctChars);
+    const EqualityDefinition equalityDefinition(alphabet, equalities.get());
+    unique_ptr<ResultScratch> scratch(useScratch ? new ResultScratch() : NULL);
+
+    // Same as in alignTransformed(), if k is not given it starts small and is doubled for queries
+    // whose result is not found yet, until it is large enough that result is always found.
+    vector<int> pending(numQueries);
+    for (int q = 0; q < numQueries; q++) pending[q] = q;
+    int k = config.k < 0 ? WORD_SIZE : config.k;
+    while (!pending.empty()) {
+        vector<const unsigned char*> pendingQueries;
+        vector<int> pendingLengths, ks, maxKs;
+        for (const int q : pending) {
+            pendingQueries.push_back(allTransformed + queryStarts[q]);
+            pendingLengths.push_back(queryLengths[q]);
+            // Edit distance is never larger than these.
+            maxKs.push_back(config.mode == EDLIB_MODE_NW ? min(max(queryLengths[q], targetLength), NO_K_LIMIT)
+                                                         : queryLengths[q]);
+            ks.push_back(min(k, maxKs.back()));
+        }
+        vector<EdlibStreamResult> found = alignQueryTrie(pendingQueries, pendingLengths, ks,
+                                                         target, targetLength, targetSymbols,
+                                                         static_cast<int>(alphabet.size()), equalityDefinition,
+                                                         config.mode);
+        vector<int> stillPending;
+        for (int j = 0; j < static_cast<int>(pending.size()); j++) {
+            const int q = pending[j];
+            if (found[j].editDistance == -1 && config.k < 0 && ks[j] < maxKs[j]) {
+                stillPending.push_back(q);
+                edlibFreeStreamResult(found[j]);
+                continue;
+            }
+            EdlibAlignResult result;
+            result.status = EDLIB_STATUS_OK;
+            result.editDistance = found[j].editDistance;
+            result.endLocations = result.startLocations = NULL;
+            result.numLocations = 0;
+            result.alignment = NULL;
+            result.alignmentLength = 0;
+            if (found[j].editDistance != -1) {
+                result.numLocations = found[j].numLocations;
+                result.endLocations = allocateResultArray<int>(result.numLocations);
+                for (int i = 0; i < result.numLocations; i++) {
+                    result.endLocations[i] = static_cast<int>(found[j].endLocations[i]);
+                }
+            }
+            edlibFreeStreamResult(found[j]);
+            unsigned char* queryTransformed;
+            unsigned char querySymbols[MAX_UCHAR + 1];
+            transformSequences(queries[q], queryLengths[q], targetChars.data(), numTargetChars, equalities.get(),
+                               &queryTransformed, querySymbols, &result.alphabetLength);
+            free(queryTransformed);
+            findStartLocationsAndAlignment(queries[q], queryLengths[q],
+                                           [target](const int start, int, vector<char>*) { return target + start; },
+                                           targetLength, config, &result);
+            storeResult(q, &result);
+        }
+        if (scratch) scratch->reset();
+        pending.swap(stillPending);
+        k = k > INT_MAX / 2 ? INT_MAX : 2 * k;
+    }
+    free(allTransformed);
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" int edlibAlignQueries(const char* const* const queries, const int* const queryLengths,
+                                 const int numQueries, const char* const target, const int targetLength,
+                                 const EdlibAlignConfig config, EdlibAlignResult* const results) {
+    return alignQueries(queries, queryLengths, numQueries, target, targetLength, config, false,
+                        [results](const int q, EdlibAlignResult* const result) { results[q] = *result; });
+}
+
+/**
+ * Splits sequences into tiles of consecutive sequences, each with at least one sequence and,
+ * unless it has only one, with sizes that sum to at most maxTileSize.
+ * @return Index of first sequence of each tile, followed by number of sequences.
+ */
+static vector<int> splitIntoTiles(const vector<size_t>& sizes, const size_t maxTileSize) {
+    vector<int> tileStarts;
+    size_t tileSize = 0;
+    for (int i = 0; i < static_cast<int>(sizes.size()); i++) {
+        if (tileStarts.empty() || tileSize + sizes[i] > maxTileSize) {
+            tileStarts.push_back(i);
+            tileSize = 0;
+        }
+        tileSize += sizes[i];
+    }
+    tileStarts.push_back(static_cast<int>(sizes.size()));
+    return tileStarts;
+}
+
+/**
+ * Implements edlibAlignAllPairs(), but gives result of each pair to storeResult(task, pair, &result)
+ * as soon as it is computed, where pair is index of result in results of edlibAlignAllPairs() and task is
+ * index (smaller than number of threads) of task that computed it. Tasks run concurrently, each on its own thread.
+ * storeResult takes over arrays of result.
+ * @param [in] useScratch  If true, arrays of results are taken from scratch of each task, which is reset after
+ *                         each result is stored, so storeResult must copy them.
+ */
+template <class StoreResult>
+static int alignAllPairs(const char* const* const queries, const int* const queryLengths, const int numQueries,
+                         const char* const* const targets, const int* const targetLengths, const int numTargets,
+                         const EdlibAlignConfig& config, const bool useScratch, const StoreResult& storeResult) {
+    if (numQueries < 0 || numTargets < 0) return EDLIB_STATUS_ERROR;
+    for (int q = 0; q < numQueries; q++) {
+        if (queryLengths[q] < 0) return EDLIB_STATUS_ERROR;
+    }
+    for (int t = 0; t < numTargets; t++) {
+        if (targetLengths[t] < 0) return EDLIB_STATUS_ERROR;
+    }
+    const shared_ptr<const EdlibEqualitySet> equalities = configEqualitySet(config);
+    const bool caseInsensitive = equalities != NULL && (equalities->presets & EDLIB_EQUALITY_CASE_INSENSITIVE);
+
+    // Characters of each sequence (folded if alignment is case insensitive), so that alphabet length
+    // of each pair is the same as edlibAlign() reports: number of distinct characters of both sequences.
+    CharMask allTargetChars;
+    memset(&allTargetChars, 0, sizeof(allTargetChars));
+    const auto charsOf = [&](const char* const sequence, const int length, CharMask* const all) {
+        CharMask chars;
+        memset(&chars, 0, sizeof(chars));
+        for (int i = 0; i < length; i++) chars.add(static_cast<unsigned char>(sequence[i]));
+        if (all) {
+            for (int w = 0; w < (MAX_UCHAR + 1) / WORD_SIZE; w++) all->words[w] |= chars.words[w];
+        }
+        if (!caseInsensitive) return chars;
+        CharMask folded;
+        memset(&folded, 0, sizeof(folded));
+        for (int w = 0; w < (MAX_UCHAR + 1) / WORD_SIZE; w++) {
+            for (Word c = chars.words[w]; c; c &= c - 1) {
+                folded.add(foldCase(static_cast<unsigned char>(w * WORD_SIZE + countTrailingZeros(c))));
+            }
+        }
+        return folded;
+    };
+    vector<CharMask> queryChars(numQueries), targetChars(numTargets);
+    for (int q = 0; q < numQueries; q++) queryChars[q] = charsOf(queries[q], queryLengths[q], NULL);
+    for (int t = 0; t < numTargets; t++) targetChars[t] = charsOf(targets[t], targetLengths[t], &allTargetChars);
+
+    // All queries are transformed together and all targets are mapped with the same symbols, so that all
+    // sequences have the same alphabet. Alphabet depends only on which characters targets contain.
+    string allQueries;
+    vector<int> queryStarts(numQueries);
+    for (int q = 0; q < numQueries; q++) {
+        queryStarts[q] = static_cast<int>(allQueries.size());
+        allQueries.append(queries[q], queryLengths[q]);
+    }
+    string allTargetCharsString;
+    for (int c = 0; c <= MAX_UCHAR; c++) {
+        if (allTargetChars.contains(static_cast<unsigned char>(c))) allTargetCharsString += static_cast<char>(c);
+    }
+    unsigned char* allTransformed;
+    unsigned char targetSymbols[MAX_UCHAR + 1];
+    int numDistinctChars;
+    const string alphabet = transformSequences(allQueries.data(), static_cast<int>(allQueries.size()),
+                                               allTargetCharsString.data(),
+                                               static_cast<int>(allTargetCharsString.size()), equalities.get(),
+                                               &allTransformed, targetSymbols, &numDistinctChars);
+    const int alphabetLength = static_cast<int>(alphabet.size());
+    const EqualityDefinition equalityDefinition(alphabet, equalities.get());
+
+    // Peq of each query is built once, and all of them are stored one after another.
+    vector<size_t> peqStarts(numQueries + 1, 0);
+    for (int q = 0; q < numQueries; q++) {
+        peqStarts[q + 1] = peqStarts[q]
+            + static_cast<size_t>(alphabetLength + 1) * ceilDiv(queryLengths[q], WORD_SIZE);
+    }
+    vector<Word> peqs(peqStarts[numQueries]);
+    for (int q = 0; q < numQueries; q++) {
+        if (queryLengths[q] == 0) continue;
+        Word* const Peq = buildPeq(alphabetLength, allTransformed + queryStarts[q], queryLengths[q],
+                                   equalityDefinition);
+        memcpy(peqs.data() + peqStarts[q], Peq, sizeof(Word) * (peqStarts[q + 1] - peqStarts[q]));
+        delete[] Peq;
+    }
+
+    // Tile is sized by what its pairs read: Peqs and transformed queries of its queries and its targets.
+    // Each side takes at most half of L2 cache (which is at least 256KB on most machines), but tiles are made
+    // smaller if there would be too few of them to keep all threads busy.
+    const size_t ALL_PAIRS_TILE_SIZE = 1 << 17;
+    const int numThreads = resolveNumThreads(config.numThreads);
+    vector<size_t> querySizes(numQueries), targetSizes(numTargets);
+    size_t totalQuerySize = 0, totalTargetSize = 0;
+    for (int q = 0; q < numQueries; q++) {
+        querySizes[q] = sizeof(Word) * (peqStarts[q + 1] - peqStarts[q]) + queryLengths[q];
+        totalQuerySize += querySizes[q];
+    }
+    for (int t = 0; t < numTargets; t++) {
+        targetSizes[t] = targetLengths[t];
+        totalTargetSize += targetSizes[t];
+    }
+    const vector<int> queryTiles = splitIntoTiles(
+            querySizes, min(ALL_PAIRS_TILE_SIZE, max<size_t>(1, totalQuerySize / (2 * numThreads))));
+    const vector<int> targetTiles = splitIntoTiles(
+            targetSizes, min(ALL_PAIRS_TILE_SIZE, max<size_t>(1, totalTargetSize / (2 * numThreads))));
+    const int numQueryTiles = static_cast<int>(queryTiles.size()) - 1;
+    const int numTargetTiles = static_cast<int>(targetTiles.size()) - 1;
+    const int numTiles = numQueryTiles * numTargetTiles;
+
+    // Each pair is computed on its own thread, while threads share tiles.
+    EdlibAlignConfig pairConfig = config;
+    pairConfig.numThreads = 1;
+    pairConfig.progressCallback = NULL;
+    atomic<int> nextTile(0);
+    const function<void(int)> task = [&](const int taskIdx) {
+        unique_ptr<ResultScratch> scratch(useScratch ? new ResultScratch() : NULL);
+        for (int tile = nextTile++; tile < numTiles; tile = nextTile++) {
+            const int queryTile = tile / numTargetTiles;
+            const int targetTile = tile % numTargetTiles;
+            for (int q = queryTiles[queryTile]; q < queryTiles[queryTile + 1]; q++) {
+                for (int t = targetTiles[targetTile]; t < targetTiles[targetTile + 1]; t++) {
+                    EdlibAlignResult result = alignTransformed(allTransformed + queryStarts[q], queryLengths[q],
+                                                               MappedSequence(targets[t], targetSymbols),
+                                                               targetLengths[t], alphabet, equalities.get(),
+                                                               pairConfig, peqs.data() + peqStarts[q]);
+                    result.alphabetLength = 0;
+                    for (int w = 0; w < (MAX_UCHAR + 1) / WORD_SIZE; w++) {
+                        result.alphabetLength += countOnes(queryChars[q].words[w] | targetChars[t].words[w]);
+                    }
+                    storeResult(taskIdx, static_cast<size_t>(q) * numTargets + t, &result);
+                    if (scratch) scratch->reset();
+                }
+            }
+        }
+    };
+    const int numTasks = min(numThreads, numTiles);
+    if (numTasks <= 1) {
+        task(0);
+    } else {
+        runInParallel(numTasks, task, config.executor, false);
+    }
+    free(allTransformed);
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" int edlibAlignAllPairs(const char* const* const queries, const int* const queryLengths,
+                                  const int numQueries,
+                                  const char* const* const targets, const int* const targetLengths,
+                                  const int numTargets,
+                                  const EdlibAlignConfig config, EdlibAlignResult* const results) {
+    return alignAllPairs(queries, queryLengths, numQueries, targets, targetLengths, numTargets, config, false,
+                         [results](int, const size_t pair, EdlibAlignResult* const result) {
+                             results[pair] = *result;
+                         });
+}
+
+/**
+ * Words sorted lexicographically, so that words which share a prefix are next to each other.
+ */
+struct EdlibDictionary {
+    vector<char> characters;  // Words one after another, in original order.
+    vector<size_t> starts;  // Word i is characters[starts[i], starts[i + 1]).
+    vector<int> order;  // Indices of words in sorted order.
+    vector<int> lcp;  // lcp[i] is length of common prefix of sorted words i - 1 and i (0 for i = 0).
+
+    int wordLength(const int word) const {
+        return static_cast<int>(starts[word + 1] - starts[word]);
+    }
+
+    const char* word(const int word) const {
+        return characters.data() + starts[word];
+    }
+};
+
+extern "C" EdlibDictionary* edlibNewDictionary(const char* const* const words, const int* const wordLengths,
+                                               const int numWords) {
+    if (numWords < 0) return NULL;
+    for (int i = 0; i < numWords; i++) {
+        if (wordLengths[i] < 0) return NULL;
+    }
+    EdlibDictionary* dictionary = new EdlibDictionary();
+    dictionary->starts.push_back(0);
+    for (int i = 0; i < numWords; i++) {
+        dictionary->characters.insert(dictionary->characters.end(), words[i], words[i] + wordLengths[i]);
+        dictionary->starts.push_back(dictionary->characters.size());
+    }
+    vector<int>& order = dictionary->order;
+    order.resize(numWords);
+    for (int i = 0; i < numWords; i++) order[i] = i;
+    sort(order.begin(), order.end(), [dictionary](const int a, const int b) {
+        const char* const wordA = dictionary->word(a);
+        const char* const wordB = dictionary->word(b);
+        return lexicographical_compare(wordA, wordA + dictionary->wordLength(a),
+                                       wordB, wordB + dictionary->wordLength(b));
+    });
+    dictionary->lcp.resize(numWords);
+    for (int i = 0; i < numWords; i++) {
+        int common = 0;
+        if (i > 0) {
+            const char* const previous = dictionary->word(order[i - 1]);
+            const char* const current = dictionary->word(order[i]);
+            const int maxCommon = min(dictionary->wordLength(order[i - 1]), dictionary->wordLength(order[i]));
+            while (common < maxCommon && previous[common] == current[common]) common++;
+        }
+        dictionary->lcp[i] = common;
+    }
+    return dictionary;
+}
+
+/**
+ * @return True if all cells of state are larger than its k, in which case also all cells in next columns are.
+ *         Cells of block are at least its score minus number of +1 vertical deltas in it.
+ */
+static inline bool allStateCellsLarger(const EdlibColumnState& state) {
+    for (int b = state.firstBlock; b <= state.lastBlock; b++) {
+        if (state.blocks[b].score - countOnes(state.blocks[b].P) <= state.k) return false;
+    }
+    return true;
+}
+
+extern "C" EdlibDictionaryResult edlibDictionarySearch(const EdlibDictionary* const dictionary,
+                                                       const char* const query, const int queryLength,
+                                                       const EdlibAlignConfig config) {
+    EdlibDictionaryResult result;
+    result.status = EDLIB_STATUS_OK;
+    result.matches = NULL;
+    result.numMatches = 0;
+    if (queryLength < 0) {
+        result.status = EDLIB_STATUS_ERROR;
+        return result;
+    }
+
+    // Words are targets that query is aligned to. Sorted words are visited as in depth first search
+    // of their trie: states[d] is column state after first d characters of current word, and when moving
+    // to next word only states after its common prefix with previous word are computed again.
+    EdlibQueryProfile* const profile = edlibNewQueryProfile(query, queryLength, config);
+    EdlibColumnState* const initialState = edlibColumnStateBegin(profile, config.mode, config.k);
+    vector<EdlibColumnState> states(1, *initialState);
+    edlibFreeColumnState(initialState);
+    // Once all cells of state are larger than k, no cell of following columns is within k, so result of all
+    // words that start with its prefix is the same and their columns are not computed (prefix is pruned).
+    // In EDLIB_MODE_HW query can start in any column, so nothing is pruned. Empty query has no cells,
+    // so it is never pruned either.
+    const bool canPrune = config.mode != EDLIB_MODE_HW && queryLength > 0;
+    int prunedDepth = INT_MAX;
+    int prunedDistance = -1;
+    vector<EdlibDictionaryMatch> matches;
+    for (int i = 0; i < static_cast<int>(dictionary->order.size()); i++) {
+        const int word = dictionary->order[i];
+        const int wordLength = dictionary->wordLength(word);
+        const char* const wordChars = dictionary->word(word);
+        int editDistance;
+        if (prunedDepth <= dictionary->lcp[i]) {
+            editDistance = prunedDistance;
+        } else {
+            prunedDepth = INT_MAX;
+            if (static_cast<int>(states.size()) <= wordLength) states.resize(wordLength + 1, states[0]);
+            int depth = dictionary->lcp[i];
+            for (; depth < wordLength; depth++) {
+                states[depth + 1] = states[depth];
+                edlibColumnStateAdvance(&states[depth + 1], wordChars + depth, 1);
+                if (canPrune && allStateCellsLarger(states[depth + 1])) break;
+            }
+            EdlibStreamResult wordResult = edlibColumnStateResult(&states[min(depth + 1, wordLength)]);
+            if (depth < wordLength) {  // Result of pruned prefix is result of all words that start with it.
+                prunedDepth = depth + 1;
+                prunedDistance = wordResult.editDistance;
+            }
+            editDistance = wordResult.editDistance;
+            edlibFreeStreamResult(wordResult);
+        }
+        if (editDistance != -1) {
+            EdlibDictionaryMatch match;
+            match.word = word;
+            match.editDistance = editDistance;
+            matches.push_back(match);
+        }
+    }
+    edlibFreeQueryProfile(profile);
+
+    sort(matches.begin(), matches.end(), [](const EdlibDictionaryMatch& a, const EdlibDictionaryMatch& b) {
+        return a.editDistance != b.editDistance ? a.editDistance < b.editDistance : a.word < b.word;
+    });
+    result.numMatches = static_cast<int>(matches.size());
+    result.matches = static_cast<EdlibDictionaryMatch*>(malloc(sizeof(EdlibDictionaryMatch) * result.numMatches));
+    copy(matches.begin(), matches.end(), result.matches);
+    return result;
+}
+
+extern "C" void edlibFreeDictionaryResult(EdlibDictionaryResult result) {
+    if (result.matches) free(result.matches);
+}
+
+extern "C" void edlibFreeDictionary(EdlibDictionary* const dictionary) {
+    delete dictionary;
+}
+
+/**
+ * Entry of barcode index: barcode has deletion variant with given hash.
+ */
+struct BarcodeIndexEntry {
+    uint32_t hash;  // Low bits of hash, high bits of it determine bucket of entry.
+    int barcode;
+};
+
+/**
+ * Symmetric deletion index: if edit distance of two sequences is at most k, then deleting at most k characters
+ * from each of them gives the same sequence (matches of their alignment). Hashes of all such deletion variants
+ * of barcodes are kept, so candidates for read are barcodes that share hash of some deletion variant with it.
+ */
+struct EdlibBarcodeIndex {
+    int k;
+    vector<char> characters;  // Barcodes one after another.
+    vector<int> starts;  // Barcode i is characters[starts[i], starts[i + 1]).
+    int bucketBits;
+    vector<size_t> bucketStarts;  // Entries of bucket b are entries[bucketStarts[b], bucketStarts[b + 1]).
+    vector<BarcodeIndexEntry> entries;  // Sorted by hash inside of each bucket.
+};
+
+/**
+ * Calls visit(hash) for hash of each sequence that is obtained from given sequence by deleting at most
+ * k characters. The same sequence is visited more than once if it can be obtained in more than one way.
+ */
+template <class Visit>
+static void forEachDeletionVariant(const char* const sequence, const int length, const int k, Visit visit) {
+    vector<int> deleted;  // Positions of deleted characters, in increasing order.
+    for (int numDeleted = 0; numDeleted <= min(k, length); numDeleted++) {
+        deleted.resize(numDeleted);
+        for (int i = 0; i < numDeleted; i++) deleted[i] = i;
+        while (true) {
+            // FNV-1a hash of characters that are not deleted, mixed so that its high bits are good bucket index.
+            uint64_t hash = FNV1A_OFFSET_BASIS;
+            int keptStart = 0;  // Start of run of characters that are not deleted.
+            for (int d = 0; d < numDeleted; d++) {
+                hash = fnv1a(sequence + keptStart, deleted[d] - keptStart, hash);
+                keptStart = deleted[d] + 1;
+            }
+            hash = fnv1a(sequence + keptStart, length - keptStart, hash);
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdULL;
+            hash ^= hash >> 33;
+            visit(hash);
+
+            // Next combination of deleted positions.
+            int i = numDeleted - 1;
+            while (i >= 0 && deleted[i] == length - numDeleted + i) i--;
+            if (i < 0) break;
+            deleted[i]++;
+            for (int j = i + 1; j < numDeleted; j++) deleted[j] = deleted[j - 1] + 1;
+        }
+    }
+}
+
+extern "C" EdlibBarcodeIndex* edlibNewBarcodeIndex(const char* const* const barcodes, const int* const barcodeLengths,
+                                                   const int numBarcodes, const int k) {
+    if (numBarcodes < 0 || k < 0) return NULL;
+    for (int i = 0; i < numBarcodes; i++) {
+        if (barcodeLengths[i] < 0) return NULL;
+    }
+    EdlibBarcodeIndex* index = new EdlibBarcodeIndex();
+    index->k = k;
+    index->starts.push_back(0);
+    for (int i = 0; i < numBarcodes; i++) {
+        index->characters.insert(index->characters.end(), barcodes[i], barcodes[i] + barcodeLengths[i]);
+        index->starts.push_back(static_cast<int>(index->characters.size()));
+    }
+
+    // Entries are put into buckets in two passes, first one counts them so that they can be stored compactly.
+    size_t numVariants = 0;
+    for (int i = 0; i < numBarcodes; i++) {
+        forEachDeletionVariant(barcodes[i], barcodeLengths[i], k, [&numVariants](uint64_t) { numVariants++; });
+    }
+    index->bucketBits = 1;
+    while (index->bucketBits < 40 && (static_cast<size_t>(1) << index->bucketBits) * 4 < numVariants) {
+        index->bucketBits++;
+    }
+    const int bucketShift = 64 - index->bucketBits;
+    const size_t numBuckets = static_cast<size_t>(1) << index->bucketBits;
+    vector<size_t>& bucketStarts = index->bucketStarts;
+    bucketStarts.assign(numBuckets + 1, 0);
+    for (int i = 0; i < numBarcodes; i++) {
+        forEachDeletionVariant(barcodes[i], barcodeLengths[i], k, [&](const uint64_t hash) {
+            bucketStarts[(hash >> bucketShift) + 1]++;
+        });
+    }
+    for (size_t b = 0; b < numBuckets; b++) bucketStarts[b + 1] += bucketStarts[b];
+    vector<BarcodeIndexEntry>& entries = index->entries;
+    entries.resize(numVariants);
+    vector<size_t> bucketEnds(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (int i = 0; i < numBarcodes; i++) {
+        forEachDeletionVariant(barcodes[i], barcodeLengths[i], k, [&](const uint64_t hash) {
+            BarcodeIndexEntry& entry = entries[bucketEnds[hash >> bucketShift]++];
+            entry.hash = static_cast<uint32_t>(hash);
+            entry.barcode = i;
+        });
+    }
+
+    // Same entry is stored only once.
+    size_t numEntries = 0;
+    for (size_t b = 0; b < numBuckets; b++) {
+        BarcodeIndexEntry* const bucketBegin = entries.data() + bucketStarts[b];
+        BarcodeIndexEntry* const bucketEnd = entries.data() + bucketStarts[b + 1];
+        sort(bucketBegin, bucketEnd, [](const BarcodeIndexEntry& x, const BarcodeIndexEntry& y) {
+            return x.hash != y.hash ? x.hash < y.hash : x.barcode < y.barcode;
+        });
+        bucketStarts[b] = numEntries;
+        for (BarcodeIndexEntry* entry = bucketBegin; entry != bucketEnd; entry++) {
+            if (entry == bucketBegin || entry->hash != (entry - 1)->hash || entry->barcode != (entry - 1)->barcode) {
+                entries[numEntries++] = *entry;
+            }
+        }
+    }
+    bucketStarts[numBuckets] = numEntries;
+    entries.resize(numEntries);
+    entries.shrink_to_fit();
+    return index;
+}
+
+/**
+ * Builds Peq for single block query (see singleBlockDistance()).
+ * @param [in] query  Query of at most WORD_SIZE characters, they are compared exactly.
+ * @param [out] Peq  Peq[c] has bit of each row of query that is equal to character c, and bits of rows
+ *                   after query set (they are padded with wildcards, same as in buildPeq()).
+ */
+static inline void buildSingleBlockPeq(const char* const query, const int queryLength, Word* const Peq) {
+    const Word padding = queryLength == WORD_SIZE ? 0 : static_cast<Word>(-1) << queryLength;
+    for (int c = 0; c <= MAX_UCHAR; c++) Peq[c] = padding;
+    for (int r = 0; r < queryLength; r++) Peq[static_cast<unsigned char>(query[r])] |= WORD_1 << r;
+}
+
+/**
+ * Edit distance (NW) between query of at most WORD_SIZE characters and target, found with single block
+ * of Myers's algorithm.
+ * @param [in] Peq  Built with buildSingleBlockPeq().
+ * @return Edit distance, or -1 if it is larger than k.
+ */
+static inline int singleBlockDistance(const Word* const Peq, const int queryLength,
+                                      const char* const target, const int targetLength, const int k) {
+    Word P = static_cast<Word>(-1);
+    Word M = 0;
+    int score = WORD_SIZE;  // Score of last row of block.
+    for (int c = 0; c < targetLength; c++) {
+        score += calculateBlock(P, M, Peq[static_cast<unsigned char>(target[c])], 1, P, M);
+        // Cells of block are at least its score minus number of +1 vertical deltas in it.
+        if (score - countOnes(P) > k) return -1;
+    }
+    // Score of last row of query is obtained by subtracting vertical deltas of padding rows below it.
+    const int distance = queryLength == WORD_SIZE
+        ? score : score - countOnes(P >> queryLength) + countOnes(M >> queryLength);
+    return distance <= k ? distance : -1;
+}
+
+/**
+ * Edit distance (NW) between two sequences whose characters are compared exactly, if it is at most k.
+ * @param [in] Peq  Built with buildSingleBlockPeq() for query if it has at most WORD_SIZE characters.
+ * @return Edit distance, or -1 if it is larger than k.
+ */
+static int boundedDistance(const char* const query, const int queryLength, const Word* const Peq,
+                           const char* const target, const int targetLength, const int k) {
+    if (abs(targetLength - queryLength) > k) return -1;
+    if (queryLength == 0 || targetLength == 0) return max(queryLength, targetLength);
+    if (queryLength <= WORD_SIZE) return singleBlockDistance(Peq, queryLength, target, targetLength, k);
+    EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength,
+                                         edlibNewAlignConfig(k, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0));
+    const int distance = result.editDistance;
+    edlibFreeAlignResult(result);
+    return distance;
+}
+
+extern "C" EdlibBarcodeMatch edlibBarcodeIndexLookup(const EdlibBarcodeIndex* const index,
+                                                     const char* const read, const int readLength) {
+    EdlibBarcodeMatch match;
+    match.status = EDLIB_STATUS_OK;
+    match.barcode = -1;
+    match.editDistance = -1;
+    match.ambiguous = 0;
+    if (readLength < 0) {
+        match.status = EDLIB_STATUS_ERROR;
+        return match;
+    }
+
+    // Candidates are barcodes that share hash of deletion variant with read.
+    // Hashes are collected first and then looked up in order of buckets, so that memory accesses
+    // of different lookups can overlap.
+    vector<uint64_t> hashes;
+    forEachDeletionVariant(read, readLength, index->k, [&hashes](const uint64_t hash) { hashes.push_back(hash); });
+    sort(hashes.begin(), hashes.end());
+    hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+    const int bucketShift = 64 - index->bucketBits;
+    vector<int> candidates;
+    for (const uint64_t hash : hashes) {
+        const size_t bucket = hash >> bucketShift;
+        const BarcodeIndexEntry* const bucketEnd = index->entries.data() + index->bucketStarts[bucket + 1];
+        for (const BarcodeIndexEntry* entry = index->entries.data() + index->bucketStarts[bucket];
+             entry != bucketEnd && entry->hash <= static_cast<uint32_t>(hash); entry++) {
+            if (entry->hash == static_cast<uint32_t>(hash)) candidates.push_back(entry->barcode);
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Candidates are verified, with k lowered to best distance found so far.
+    Word readPeq[MAX_UCHAR + 1];
+    if (readLength <= WORD_SIZE) buildSingleBlockPeq(read, readLength, readPeq);
+    int k = index->k;
+    for (const int candidate : candidates) {
+        const char* const barcode = index->characters.data() + index->starts[candidate];
+        const int barcodeLength = index->starts[candidate + 1] - index->starts[candidate];
+        const int distance = boundedDistance(read, readLength, readPeq, barcode, barcodeLength, k);
+        if (distance == -1) continue;
+        if (distance == match.editDistance) {
+            match.ambiguous = 1;
+        } else {
+            match.editDistance = k = distance;
+            match.barcode = candidate;
+            match.ambiguous = 0;
+        }
+    }
+    if (match.ambiguous) match.barcode = -1;
+    return match;
+}
+
+extern "C" void edlibFreeBarcodeIndex(EdlibBarcodeIndex* const index) {
+    delete index;
+}
+
+/**
+ * @return Hash of q-gram that starts at given position. Strings are filtered by hashes of their q-grams
+ *         instead of by q-grams themselves, which is still correct, as strings that share q-gram share its hash.
+ */
+static inline uint64_t joinGram(const char* const string, const int q) {
+    return fnv1a(string, q);
+}
+
+/**
+ * Index of strings of set B for similarity join (see edlibSimilarityJoin() for description of filters).
+ */
+struct JoinIndex {
+    int k;
+    int q;
+    int prefixLength;  // kq + 1, number of q-grams in prefix of string.
+    int shortLength;  // Strings shorter than it have less than kq + 1 q-grams.
+    unordered_map<uint64_t, int> gramRanks;  // Global order of q-grams, rarest come first.
+    vector<int> order;  // Strings sorted by length, positions in it are used instead of indices of strings.
+    vector<int> sortedLengths;
+    int numShort;  // Short strings come first in order.
+    // Sorted ranks of q-grams of long string at position i are ranks[ranksStarts[i], ranksStarts[i + 1]).
+    vector<long long> ranksStarts;
+    vector<int> ranks;
+    // List of long strings that have q-gram of rank r in their prefix is lists[listStarts[r], listStarts[r + 1]),
+    // sorted by position.
+    vector<long long> listStarts;
+    vector<int> lists;
+
+    /**
+     * @param [out] stringRanks  Sorted ranks of q-grams of string, all its q-grams must have rank.
+     */
+    void gramRanksOf(const char* const string, const int length, vector<int>& stringRanks) const {
+        stringRanks.resize(max(0, length - q + 1));
+        for (int i = 0; i + q <= length; i++) stringRanks[i] = gramRanks.at(joinGram(string + i, q));
+        sort(stringRanks.begin(), stringRanks.end());
+    }
+};
+
+/**
+ * @return True if two sorted arrays have at least minCommon elements in common (as multisets).
+ */
+static bool haveCommon(const int* x, const int* const xEnd, const int* y, const int* const yEnd,
+                       const int minCommon) {
+    // Merge stops as soon as too many elements of either array were skipped.
+    int xSkips = static_cast<int>(xEnd - x) - minCommon;
+    int ySkips = static_cast<int>(yEnd - y) - minCommon;
+    while (xSkips >= 0 && ySkips >= 0) {
+        if (x == xEnd || y == yEnd) return true;
+        if (*x < *y) {
+            x++;
+            xSkips--;
+        } else if (*y < *x) {
+            y++;
+            ySkips--;
+        } else {
+            x++;
+            y++;
+        }
+    }
+    return false;
+}
+
+/**
+ * State of one task of similarity join, reused for strings that it joins.
+ */
+struct JoinTaskState {
+    vector<int> lastSeen;  // lastSeen[i] is last string of A that string of B at position i was candidate for.
+    vector<int> candidates;
+    vector<int> ranks;
+    vector<EdlibJoinPair> pairs;
+};
+
+/**
+ * Finds all strings of B whose edit distance to string a is at most k, and adds them to state.pairs.
+ */
+static void joinString(const JoinIndex& index, const char* const* const stringsB, const int* const lengthsB,
+                       const int aIndex, const char* const a, const int aLength, JoinTaskState& state) {
+    const int k = index.k;
+    // Positions of strings whose length differs by at most k.
+    const int lengthStart = static_cast<int>(lower_bound(index.sortedLengths.begin(), index.sortedLengths.end(),
+                                                         aLength - k) - index.sortedLengths.begin());
+    const int lengthEnd = static_cast<int>(upper_bound(index.sortedLengths.begin(), index.sortedLengths.end(),
+                                                       aLength + k) - index.sortedLengths.begin());
+    vector<int>& candidates = state.candidates;
+    candidates.clear();
+    if (aLength < index.shortLength) {
+        for (int i = lengthStart; i < lengthEnd; i++) candidates.push_back(i);
+    } else {
+        for (int i = lengthStart; i < min(lengthEnd, index.numShort); i++) candidates.push_back(i);
+        index.gramRanksOf(a, aLength, state.ranks);
+        const vector<int>& ranks = state.ranks;
+        for (int j = 0; j < index.prefixLength; j++) {
+            if (j > 0 && ranks[j] == ranks[j - 1]) continue;
+            const int* const listBegin = index.lists.data() + index.listStarts[ranks[j]];
+            const int* const listEnd = index.lists.data() + index.listStarts[ranks[j] + 1];
+            for (const int* it = lower_bound(listBegin, listEnd, lengthStart); it != listEnd && *it < lengthEnd; it++) {
+                const int i = *it;
+                if (state.lastSeen[i] == aIndex) continue;
+                state.lastSeen[i] = aIndex;
+                // Count filter, it is used only for strings that are not aligned with single block,
+                // as single block is about as fast as merge of their q-grams.
+                if (aLength <= WORD_SIZE) {
+                    candidates.push_back(i);
+                    continue;
+                }
+                const int* const ranksBegin = index.ranks.data() + index.ranksStarts[i];
+                const int* const ranksEnd = index.ranks.data() + index.ranksStarts[i + 1];
+                const int numGrams = max(static_cast<int>(ranks.size()), static_cast<int>(ranksEnd - ranksBegin));
+                if (haveCommon(ranks.data(), ranks.data() + ranks.size(), ranksBegin, ranksEnd,
+                               numGrams - (index.prefixLength - 1))) {
+                    candidates.push_back(i);
+                }
+            }
+        }
+    }
+
+    // Candidates are verified.
+    Word Peq[MAX_UCHAR + 1];
+    if (aLength <= WORD_SIZE) buildSingleBlockPeq(a, aLength, Peq);
+    const size_t firstPair = state.pairs.size();
+    for (const int i : candidates) {
+        const int b = index.order[i];
+        const int distance = boundedDistance(a, aLength, Peq, stringsB[b], lengthsB[b], k);
+        if (distance == -1) continue;
+        EdlibJoinPair pair;
+        pair.a = aIndex;
+        pair.b = b;
+        pair.editDistance = distance;
+        state.pairs.push_back(pair);
+    }
+    sort(state.pairs.begin() + firstPair, state.pairs.end(), [](const EdlibJoinPair& x, const EdlibJoinPair& y) {
+        return x.b < y.b;
+    });
+}
+
+extern "C" int edlibSimilarityJoin(const char* const* const stringsA, const int* const lengthsA, const int numA,
+                                   const char* const* const stringsB, const int* const lengthsB, const int numB,
+                                   const EdlibAlignConfig config,
+                                   const EdlibJoinCallback callback, void* const callbackContext) {
+    if (config.k < 0 || numA < 0 || numB < 0) return EDLIB_STATUS_ERROR;
+    for (int i = 0; i < numA; i++) {
+        if (lengthsA[i] < 0) return EDLIB_STATUS_ERROR;
+    }
+    for (int i = 0; i < numB; i++) {
+        if (lengthsB[i] < 0) return EDLIB_STATUS_ERROR;
+    }
+
+    // Filters are based on q-grams: each edit operation changes at most q q-grams, so if edit distance of
+    // strings a and b is at most k, they share at least max(|a|, |b|) - q + 1 - kq q-grams (count filter).
+    // If q-grams of each string are sorted in the same global order, it follows that first kq + 1 q-grams
+    // of a and of b share at least one q-gram (prefix filter), so candidates for a are found only through
+    // lists of strings that have its first kq + 1 q-grams in their first kq + 1 q-grams. Rarest q-grams
+    // come first, so that lists are short. Strings with less than kq + 1 q-grams can not be filtered this way,
+    // so they are candidates for all strings whose length differs by at most k (length filter).
+    // Longer q-grams are rarer, so lists are shorter, but they also make more strings short: q is chosen
+    // so that strings of average length have about 4/3 as many q-grams as are needed.
+    JoinIndex index;
+    index.k = config.k;
+    long long totalLength = 0;
+    for (int i = 0; i < numA; i++) totalLength += lengthsA[i];
+    for (int i = 0; i < numB; i++) totalLength += lengthsB[i];
+    const long long averageLength = numA + numB > 0 ? totalLength / (numA + numB) : 0;
+    index.q = static_cast<int>(max(1LL, min(16LL, 3 * averageLength / (4 * (config.k + 1LL)))));
+    if (static_cast<long long>(index.q) * (config.k + 1) > INT_MAX) return EDLIB_STATUS_ERROR;
+    index.prefixLength = index.q * config.k + 1;
+    index.shortLength = index.q * (config.k + 1);
+    const int q = index.q;
+    {
+        // Map of q-grams first holds their counts, which are then replaced with their ranks.
+        unordered_map<uint64_t, int>& gramRanks = index.gramRanks;
+        gramRanks.reserve(static_cast<size_t>(min(totalLength, 1LL << 24)));
+        const auto countGrams = [&gramRanks, q](const char* const* const strings, const int* const lengths,
+                                                const int numStrings) {
+            for (int i = 0; i < numStrings; i++) {
+                for (int j = 0; j + q <= lengths[i]; j++) {
+                    int& count = gramRanks[joinGram(strings[i] + j, q)];
+                    if (count < INT_MAX) count++;
+                }
+            }
+        };
+        countGrams(stringsA, lengthsA, numA);
+        if (stringsB != stringsA || lengthsB != lengthsA || numB > numA) countGrams(stringsB, lengthsB, numB);
+        vector<pair<int, uint64_t>> grams;  // (count, q-gram)
+        grams.reserve(gramRanks.size());
+        for (const pair<const uint64_t, int>& gramCount : gramRanks) {
+            grams.push_back(make_pair(gramCount.second, gramCount.first));
+        }
+        sort(grams.begin(), grams.end());
+        for (int r = 0; r < static_cast<int>(grams.size()); r++) gramRanks[grams[r].second] = r;
+    }
+    const int numRanks = static_cast<int>(index.gramRanks.size());
+
+    index.order.resize(numB);
+    for (int i = 0; i < numB; i++) index.order[i] = i;
+    stable_sort(index.order.begin(), index.order.end(), [lengthsB](const int x, const int y) {
+        return lengthsB[x] < lengthsB[y];
+    });
+    index.sortedLengths.resize(numB);
+    for (int i = 0; i < numB; i++) index.sortedLengths[i] = lengthsB[index.order[i]];
+    index.numShort = static_cast<int>(lower_bound(index.sortedLengths.begin(), index.sortedLengths.end(),
+                                                  index.shortLength) - index.sortedLengths.begin());
+    index.ranksStarts.assign(numB + 1, 0);
+    for (int i = 0; i < numB; i++) {
+        index.ranksStarts[i + 1] = index.ranksStarts[i] + (i < index.numShort ? 0 : index.sortedLengths[i] - q + 1);
+    }
+    index.ranks.resize(index.ranksStarts[numB]);
+    index.listStarts.assign(numRanks + 1, 0);
+    {
+        vector<int> ranks;
+        for (int i = index.numShort; i < numB; i++) {
+            index.gramRanksOf(stringsB[index.order[i]], index.sortedLengths[i], ranks);
+            copy(ranks.begin(), ranks.end(), index.ranks.begin() + index.ranksStarts[i]);
+            for (int j = 0; j < index.prefixLength; j++) {
+                if (j == 0 || ranks[j] != ranks[j - 1]) index.listStarts[ranks[j] + 1]++;
+            }
+        }
+    }
+    for (int r = 0; r < numRanks; r++) index.listStarts[r + 1] += index.listStarts[r];
+    index.lists.resize(index.listStarts[numRanks]);
+    {
+        vector<long long> listEnds(index.listStarts.begin(), index.listStarts.end() - 1);
+        for (int i = index.numShort; i < numB; i++) {
+            const int* const ranks = index.ranks.data() + index.ranksStarts[i];
+            for (int j = 0; j < index.prefixLength; j++) {
+                if (j == 0 || ranks[j] != ranks[j - 1]) index.lists[listEnds[ranks[j]]++] = i;
+            }
+        }
+    }
+
+    // Strings of A are joined in rounds, each round is split among tasks that run in parallel,
+    // and pairs found in round are given to callback once it finishes.
+    const int numTasks = resolveNumThreads(config.numThreads);
+    const int TASK_SIZE = 256;  // Number of strings of A that task joins in one round.
+    vector<JoinTaskState> states(numTasks);
+    for (JoinTaskState& state : states) state.lastSeen.assign(numB, -1);
+    for (long long roundStart = 0; roundStart < numA; roundStart += static_cast<long long>(numTasks) * TASK_SIZE) {
+        const function<void(int)> task = [&](const int t) {
+            const long long start = roundStart + static_cast<long long>(t) * TASK_SIZE;
+            const long long end = min(start + TASK_SIZE, static_cast<long long>(numA));
+            for (long long i = start; i < end; i++) {
+                joinString(index, stringsB, lengthsB, static_cast<int>(i), stringsA[i], lengthsA[i], states[t]);
+            }
+        };
+        const int roundTasks = static_cast<int>(min(static_cast<long long>(numTasks),
+                                                    (numA - roundStart + TASK_SIZE - 1) / TASK_SIZE));
+        if (roundTasks == 1) {
+            task(0);
+        } else {
+            runInParallel(roundTasks, task, config.executor, false);
+        }
+        for (int t = 0; t < roundTasks; t++) {
+            if (!states[t].pairs.empty()) {
+                callback(states[t].pairs.data(), static_cast<int>(states[t].pairs.size()), callbackContext);
+                states[t].pairs.clear();
+            }
+        }
+    }
+    return EDLIB_STATUS_OK;
+}
+
+/**
+ * Scans piece of text with query of at most WORD_SIZE characters (see scanPiece()).
+ * Single block is always computed, so there is no banding and no bookkeeping of blocks.
+ * @return Block of last column of piece.
+ */
+static Block scanSingleBlock(const EdlibQueryProfile& profile, const char* const piece, const long long pieceLength,
+                             const long long pieceStart, const int k,
+                             const EdlibScanCallback callback, void* const callbackContext) {
+    const int W = profile.W;
+    const Word* const Peq = profile.Peq;
+    const unsigned char* const symbols = profile.symbols;
+    Word P = static_cast<Word>(-1);
+    Word M = 0;
+    int score = WORD_SIZE;
+    for (long long c = 0; c < pieceLength; c++) {
+        score += calculateBlock(P, M, Peq[symbols[static_cast<unsigned char>(piece[c])]], 0, P, M);
+        // Score of last row of padded query is score of last row of query W columns before (see scanPiece()).
+        if (score <= k && c >= W) callback(pieceStart + c - W, score, callbackContext);
+    }
+    return Block(P, M, score);
+}
+
+/**
+ * Scans piece of text that contains no separator, see edlibScan().
+ * Columns are advanced same as in edlibColumnStateAdvance() in EDLIB_MODE_HW, except that k is never lowered.
+ * @param [in] pieceStart  Position of piece in text, it is added to reported positions.
+ */
+static void scanPiece(const EdlibQueryProfile& profile, const char* const piece, const long long pieceLength,
+                      const long long pieceStart, const int k, vector<Block>& blocks,
+                      const EdlibScanCallback callback, void* const callbackContext) {
+    if (profile.queryLength == 0) {
+        for (long long c = 0; c < pieceLength; c++) callback(pieceStart + c, 0, callbackContext);
+        return;
+    }
+    const int maxNumBlocks = profile.maxNumBlocks;
+    const int W = profile.W;
+    int firstBlock = 0;  // It is always 0 in EDLIB_MODE_HW.
+    int lastBlock = min(ceilDiv(k + 1, WORD_SIZE), maxNumBlocks) - 1;
+    if (maxNumBlocks == 1) {
+        blocks[0] = scanSingleBlock(profile, piece, pieceLength, pieceStart, k, callback, callbackContext);
+        lastBlock = 0;
+    } else {
+        for (int b = 0; b <= lastBlock; b++) {
+            blocks[b] = Block(static_cast<Word>(-1), static_cast<Word>(0), (b + 1) * WORD_SIZE);
+        }
+
+        for (long long c = 0; c < pieceLength; c++) {
+            const Word* const Peq_c = profile.Peq
+                + profile.symbols[static_cast<unsigned char>(piece[c])] * maxNumBlocks;
+            // Unlike in other loops, strong reduction is not done at first column, since pieces are often short
+            // (e.g. lines).
+            advanceColumn(blocks.data(), &firstBlock, &lastBlock, Peq_c, k, maxNumBlocks, EDLIB_MODE_HW,
+                          c % STRONG_REDUCE_NUM == STRONG_REDUCE_NUM - 1);
+
+            // Score of last row of padded query is score of last row of query W columns before
+            // (see columnStateResult()).
+            if (lastBlock == maxNumBlocks - 1 && blocks[lastBlock].score <= k && c >= W) {
+                callback(pieceStart + c - W, blocks[lastBlock].score, callbackContext);
+            }
+        }
+    }
+
+    // Scores of last W positions are obtained from last column, going up from its last row
+    // (same as getBlockCellValues() does, but without allocation).
+    if (lastBlock == maxNumBlocks - 1) {
+        const Block& bl = blocks[lastBlock];
+        int score = bl.score;
+        Word mask = HIGH_BIT_MASK;
+        for (int i = 0; i < W; i++) {
+            if (bl.P & mask) score--;
+            if (bl.M & mask) score++;
+            mask >>= 1;
+            const long long position = pieceLength - W + i;
+            if (position >= 0 && score <= k) callback(pieceStart + position, score, callbackContext);
+        }
+    }
+}
+
+extern "C" int edlibScan(const EdlibQueryProfile* const profile, const char* const text, const long long textLength,
+                         const int k, const int separator,
+                         const EdlibScanCallback callback, void* const callbackContext) {
+    if (k < 0 || textLength < 0 || separator < -1 || separator > MAX_UCHAR) return EDLIB_STATUS_ERROR;
+    // Score is never larger than queryLength, so larger k does not change anything.
+    const int boundedK = min(k, profile->queryLength);
+    vector<Block> blocks(profile->maxNumBlocks);
+    long long pieceStart = 0;
+    while (pieceStart < textLength) {
+        const void* const found = separator == -1 ? NULL
+            : memchr(text + pieceStart, separator, static_cast<size_t>(textLength - pieceStart));
+        const long long pieceEnd = found ? static_cast<const char*>(found) - text : textLength;
+        scanPiece(*profile, text + pieceStart, pieceEnd - pieceStart, pieceStart, boundedK, blocks,
+                  callback, callbackContext);
+        pieceStart = pieceEnd + 1;
+    }
+    return EDLIB_STATUS_OK;
+}
+
+/**
+ * Adapter whose last row is in some word of adapter panel (see EdlibAdapterPanel).
+ */
+struct AdapterEnding {
+    int adapter;
+    int bit;  // Bit of last row of adapter in word.
+    int length;  // Number of characters of adapter.
+    int maxEdits;  // Largest number of edits in full occurrence of adapter.
+};
+
+/**
+ * All adapters are rows of one bit-vector matrix that is split into words. Adapters of at most WORD_SIZE
+ * characters are packed into words (several per word), while longer ones take consecutive words of their own.
+ * Adapters are kept oriented so that trimmed end of read is its end: for EDLIB_TRIM_START, both adapters
+ * and reads are reversed.
+ */
+struct EdlibAdapterPanel {
+    EdlibTrimConfig trimConfig;
+    vector<char> characters;  // Oriented adapters one after another.
+    vector<int> starts;  // Adapter i is characters[starts[i], starts[i + 1]).
+    int numWords;
+    vector<Word> segmentStarts;  // Bits of first rows of adapters in each word.
+    vector<Word> segmentEnds;  // Bits of last rows of adapters (or of their parts) in each word.
+    vector<char> continues;  // True if first row of word continues adapter from previous word.
+    vector<int> lastRows;  // Row of matrix (word * WORD_SIZE + bit) of last character of each adapter.
+    // Adapters whose last row is in word w are endings[endingStarts[w], endingStarts[w + 1]).
+    vector<int> endingStarts;
+    vector<AdapterEnding> endings;
+    unsigned char symbols[MAX_UCHAR + 1];  // symbols[c] is symbol of read character c.
+    vector<Word> Peq;  // Peq[symbol * numWords + w] has bits of rows of word w that match symbol.
+    vector<CharMask> equalTo;  // equalTo[a] contains b if characters a and b are equal.
+};
+
+/**
+ * @return Largest number of edits allowed in occurrence with given number of characters of adapter.
+ */
+static inline int maxTrimEdits(const EdlibTrimConfig& trimConfig, const int adapterLength) {
+    return static_cast<int>(trimConfig.maxErrorRate * adapterLength + 1e-9);
+}
+
+extern "C" EdlibTrimConfig edlibDefaultTrimConfig(void) {
+    EdlibTrimConfig trimConfig;
+    trimConfig.end = EDLIB_TRIM_END;
+    trimConfig.maxErrorRate = 0.1;
+    trimConfig.minOverlap = 3;
+    trimConfig.searchLength = -1;
+    return trimConfig;
+}
+
+extern "C" EdlibAdapterPanel* edlibNewAdapterPanel(const char* const* const adapters, const int* const adapterLengths,
+                                                   const int numAdapters, const EdlibTrimConfig trimConfig,
+                                                   const EdlibAlignConfig config) {
+    if (numAdapters < 0 || trimConfig.maxErrorRate < 0 || trimConfig.minOverlap < 0
+        || trimConfig.searchLength < -1) {
+        return NULL;
+    }
+    for (int i = 0; i < numAdapters; i++) {
+        if (adapterLengths[i] < 0) return NULL;
+    }
+    EdlibAdapterPanel* panel = new EdlibAdapterPanel();
+    panel->trimConfig = trimConfig;
+    panel->starts.push_back(0);
+    for (int i = 0; i < numAdapters; i++) {
+        panel->characters.insert(panel->characters.end(), adapters[i], adapters[i] + adapterLengths[i]);
+        if (trimConfig.end == EDLIB_TRIM_START) {
+            reverse(panel->characters.end() - adapterLengths[i], panel->characters.end());
+        }
+        panel->starts.push_back(static_cast<int>(panel->characters.size()));
+    }
+
+    // Long adapters are placed first, each into its own words, and then short ones from longest to shortest
+    // into first word with enough free rows.
+    vector<int> order(numAdapters);
+    for (int i = 0; i < numAdapters; i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [adapterLengths](const int a, const int b) {
+        return adapterLengths[a] > adapterLengths[b];
+    });
+    vector<int> firstRows(numAdapters, -1);
+    vector<int> usedRows;  // Number of used rows in each word.
+    for (const int a : order) {
+        const int length = adapterLengths[a];
+        if (length == 0) continue;
+        int word = 0;
+        if (length > WORD_SIZE) {
+            word = static_cast<int>(usedRows.size());
+            usedRows.resize(usedRows.size() + ceilDiv(length, WORD_SIZE), WORD_SIZE);
+            usedRows.back() = length - (ceilDiv(length, WORD_SIZE) - 1) * WORD_SIZE;
+            firstRows[a] = word * WORD_SIZE;
+            continue;
+        }
+        while (word < static_cast<int>(usedRows.size()) && usedRows[word] + length > WORD_SIZE) word++;
+        if (word == static_cast<int>(usedRows.size())) usedRows.push_back(0);
+        firstRows[a] = word * WORD_SIZE + usedRows[word];
+        usedRows[word] += length;
+    }
+    const int numWords = panel->numWords = static_cast<int>(usedRows.size());
+    panel->segmentStarts.assign(numWords, 0);
+    panel->segmentEnds.assign(numWords, 0);
+    panel->continues.assign(numWords, 0);
+    panel->lastRows.assign(numAdapters, -1);
+    panel->endingStarts.assign(numWords + 1, 0);
+    for (int a = 0; a < numAdapters; a++) {
+        if (firstRows[a] == -1) continue;
+        const int lastRow = panel->lastRows[a] = firstRows[a] + adapterLengths[a] - 1;
+        panel->segmentStarts[firstRows[a] / WORD_SIZE] |= WORD_1 << (firstRows[a] % WORD_SIZE);
+        panel->segmentEnds[lastRow / WORD_SIZE] |= WORD_1 << (lastRow % WORD_SIZE);
+        for (int w = firstRows[a] / WORD_SIZE; w < lastRow / WORD_SIZE; w++) {
+            panel->segmentEnds[w] |= HIGH_BIT_MASK;
+            panel->continues[w + 1] = 1;
+        }
+        panel->endingStarts[lastRow / WORD_SIZE + 1]++;
+    }
+    for (int w = 0; w < numWords; w++) panel->endingStarts[w + 1] += panel->endingStarts[w];
+    panel->endings.resize(panel->endingStarts[numWords]);
+    vector<int> endingEnds(panel->endingStarts.begin(), panel->endingStarts.end() - 1);
+    for (int a = 0; a < numAdapters; a++) {
+        if (firstRows[a] == -1) continue;
+        AdapterEnding& ending = panel->endings[endingEnds[panel->lastRows[a] / WORD_SIZE]++];
+        ending.adapter = a;
+        ending.bit = panel->lastRows[a] % WORD_SIZE;
+        ending.length = adapterLengths[a];
+        ending.maxEdits = maxTrimEdits(trimConfig, adapterLengths[a]);
+    }
+
+    // Equality is defined on characters the same way as for edlibAlign(), with case folded if requested.
+    const shared_ptr<const EdlibEqualitySet> equalities = configEqualitySet(config);
+    const bool caseInsensitive = equalities != NULL && (equalities->presets & EDLIB_EQUALITY_CASE_INSENSITIVE);
+    panel->equalTo.resize(MAX_UCHAR + 1);
+    memset(panel->equalTo.data(), 0, sizeof(CharMask) * (MAX_UCHAR + 1));
+    for (int a = 0; a <= MAX_UCHAR; a++) {
+        const unsigned char foldedA = caseInsensitive ? foldCase(static_cast<unsigned char>(a))
+                                                      : static_cast<unsigned char>(a);
+        for (int b = 0; b <= MAX_UCHAR; b++) {
+            const unsigned char foldedB = caseInsensitive ? foldCase(static_cast<unsigned char>(b))
+                                                          : static_cast<unsigned char>(b);
+            if (foldedA == foldedB || (equalities != NULL && equalities->masks[foldedA].contains(foldedB))) {
+                panel->equalTo[a].add(static_cast<unsigned char>(b));
+            }
+        }
+    }
+
+    // Read characters with the same Peq column share symbol, so Peq has only a few columns (e.g. 5 for DNA).
+    vector<Word> column(numWords);
+    for (int c = 0; c <= MAX_UCHAR; c++) {
+        fill(column.begin(), column.end(), 0);
+        for (int a = 0; a < numAdapters; a++) {
+            for (int r = 0; r < adapterLengths[a]; r++) {
+                const unsigned char adapterChar = static_cast<unsigned char>(panel->characters[panel->starts[a] + r]);
+                if (panel->equalTo[adapterChar].contains(static_cast<unsigned char>(c))) {
+                    column[(firstRows[a] + r) / WORD_SIZE] |= WORD_1 << ((firstRows[a] + r) % WORD_SIZE);
+                }
+            }
+        }
+        const int numSymbols = numWords == 0 ? 0 : static_cast<int>(panel->Peq.size()) / numWords;
+        int symbol = 0;
+        while (symbol < numSymbols && !equal(column.begin(), column.end(), panel->Peq.begin() + symbol * numWords)) {
+            symbol++;
+        }
+        if (symbol == numSymbols) panel->Peq.insert(panel->Peq.end(), column.begin(), column.end());
+        panel->symbols[c] = static_cast<unsigned char>(symbol);
+    }
+    return panel;
+}
+
+/**
+ * Finds start of occurrence of oriented adapter prefix that ends at given position of oriented read,
+ * by aligning both backwards from there (EDLIB_MODE_SHW). Of alignments with given distance,
+ * the longest one is taken. Cell in row r and column t is at least |r - t|, so only cells in band
+ * of width 2 * distance + 1 around diagonal can be on such alignment, and only they are computed.
+ * @param [in] readAt  readAt(p) is character at position p of oriented read.
+ * @return Start of occurrence in oriented read.
+ */
+template <class ReadAt>
+static int trimOccurrenceStart(const EdlibAdapterPanel& panel, const char* const adapter, const int adapterLength,
+                               ReadAt readAt, const int searchStart, const int end, const int distance) {
+    const int maxLength = min(adapterLength + distance, end - searchStart + 1);
+    const int outside = adapterLength + maxLength + 1;  // Larger than any cell.
+    vector<int> column(adapterLength + 1);  // column[r] is distance of last r characters of adapter.
+    for (int r = 0; r <= adapterLength; r++) column[r] = r <= distance ? r : outside;
+    int bestLength = 0;
+    for (int t = 1; t <= maxLength; t++) {
+        const unsigned char c = static_cast<unsigned char>(readAt(end - t + 1));
+        const int firstRow = max(1, t - distance);
+        const int lastRow = min(adapterLength, t + distance);
+        int diagonal = column[firstRow - 1];
+        column[firstRow - 1] = firstRow == 1 && t <= distance ? t : outside;
+        for (int r = firstRow; r <= lastRow; r++) {
+            const bool match = panel.equalTo[static_cast<unsigned char>(adapter[adapterLength - r])].contains(c);
+            const int value = min(diagonal + (match ? 0 : 1), min(column[r - 1], column[r]) + 1);
+            diagonal = column[r];
+            column[r] = value;
+        }
+        if (column[adapterLength] == distance) bestLength = t;
+    }
+    return end - bestLength + 1;
+}
+
+extern "C" EdlibTrimResult edlibTrimRead(const EdlibAdapterPanel* const panel,
+                                         const char* const read, const int readLength) {
+    EdlibTrimResult result;
+    result.status = EDLIB_STATUS_OK;
+    result.adapter = result.editDistance = result.startLocation = result.endLocation = result.adapterLength = -1;
+    if (readLength < 0) {
+        result.status = EDLIB_STATUS_ERROR;
+        return result;
+    }
+    const EdlibTrimConfig& trimConfig = panel->trimConfig;
+    const bool reversed = trimConfig.end == EDLIB_TRIM_START;
+    const auto readAt = [read, readLength, reversed](const int p) {
+        return reversed ? read[readLength - 1 - p] : read[p];
+    };
+    const int numWords = panel->numWords;
+    const int numAdapters = static_cast<int>(panel->lastRows.size());
+    const int searchStart = trimConfig.searchLength == -1 ? 0 : max(0, readLength - trimConfig.searchLength);
+
+    // Best occurrence so far, in oriented read.
+    int bestAdapter = -1, bestLength = 0, bestDistance = 0, bestEnd = 0;
+    const auto offer = [&](const int adapter, const int length, const int distance, const int end) {
+        bool better;
+        if (bestAdapter == -1) better = true;
+        else if (length != bestLength) better = length > bestLength;
+        else if (distance != bestDistance) better = distance < bestDistance;
+        else if (end != bestEnd) better = end < bestEnd;
+        else better = adapter < bestAdapter;
+        if (better) {
+            bestAdapter = adapter;
+            bestLength = length;
+            bestDistance = distance;
+            bestEnd = end;
+        }
+    };
+
+    // Columns of matrix are computed same as in calculateBlock() for all words, except that addition does not
+    // carry between adapters and vertical deltas are not shifted between them. First row of each adapter gets
+    // horizontal delta 0 (EDLIB_MODE_HW), while first row of word that continues adapter gets it from previous word.
+    vector<Word> Ps(numWords, static_cast<Word>(-1)), Ms(numWords, 0);
+    const int numEndings = static_cast<int>(panel->endings.size());
+    vector<int> scores(numEndings);  // Scores of last rows of adapters, in order of endings.
+    for (int i = 0; i < numEndings; i++) scores[i] = panel->endings[i].length;
+    const Word* const segmentStarts = panel->segmentStarts.data();
+    const Word* const segmentEnds = panel->segmentEnds.data();
+    const char* const continues = panel->continues.data();
+    const int* const endingStarts = panel->endingStarts.data();
+    const AdapterEnding* const endings = panel->endings.data();
+    const char* column = reversed ? read + readLength - 1 - searchStart : read + searchStart;
+    const int step = reversed ? -1 : 1;
+    for (int c = searchStart; c < readLength; c++, column += step) {
+        const Word* const Peq_c = panel->Peq.data() + panel->symbols[static_cast<unsigned char>(*column)] * numWords;
+        int hout = 0;
+        for (int w = 0; w < numWords; w++) {
+            const int hin = continues[w] ? hout : 0;
+            const Word P = Ps[w], M = Ms[w], ends = segmentEnds[w];
+            const Word hinIsNeg = static_cast<Word>(hin >> 2) & WORD_1;
+            const Word Xv = Peq_c[w] | M;
+            const Word Eq = Peq_c[w] | hinIsNeg;
+            const Word X = Eq & P;
+            const Word sum = ((X & ~ends) + (P & ~ends)) ^ ((X ^ P) & ends);
+            const Word Xh = (sum ^ P) | Eq;
+            Word Ph = M | ~(Xh | P);
+            Word Mh = P & Xh;
+            for (int i = endingStarts[w]; i < endingStarts[w + 1]; i++) {
+                const AdapterEnding& ending = endings[i];
+                scores[i] += static_cast<int>((Ph >> ending.bit) & WORD_1)
+                    - static_cast<int>((Mh >> ending.bit) & WORD_1);
+                if (scores[i] <= ending.maxEdits) offer(ending.adapter, ending.length, scores[i], c);
+            }
+            hout = static_cast<int>(Ph >> (WORD_SIZE - 1)) - static_cast<int>(Mh >> (WORD_SIZE - 1));
+            Ph = ((Ph << 1) & ~segmentStarts[w]) | static_cast<Word>((hin + 1) >> 1);
+            Mh = ((Mh << 1) & ~segmentStarts[w]) | hinIsNeg;
+            Ps[w] = Mh | ~(Xv | Ph);
+            Ms[w] = Ph & Xv;
+        }
+    }
+
+    // Partial occurrences end at last column, score of each prefix of adapter is sum of vertical deltas above it.
+    if (searchStart < readLength) {
+        for (int a = 0; a < numAdapters; a++) {
+            const int adapterLength = panel->starts[a + 1] - panel->starts[a];
+            const int firstRow = panel->lastRows[a] - adapterLength + 1;
+            int score = 0;
+            for (int length = 1; length < adapterLength; length++) {
+                const int row = firstRow + length - 1;
+                const Word mask = WORD_1 << (row % WORD_SIZE);
+                score += ((Ps[row / WORD_SIZE] & mask) ? 1 : 0) - ((Ms[row / WORD_SIZE] & mask) ? 1 : 0);
+                if (length >= max(1, trimConfig.minOverlap) && score <= maxTrimEdits(trimConfig, length)) {
+                    offer(a, length, score, readLength - 1);
+                }
+            }
+        }
+    }
+    if (bestAdapter == -1) return result;
+
+    const int start = trimOccurrenceStart(*panel, panel->characters.data() + panel->starts[bestAdapter], bestLength,
+                                          readAt, searchStart, bestEnd, bestDistance);
+    result.adapter = bestAdapter;
+    result.editDistance = bestDistance;
+    result.adapterLength = bestLength;
+    result.startLocation = reversed ? readLength - 1 - bestEnd : start;
+    result.endLocation = reversed ? readLength - 1 - start : bestEnd;
+    return result;
+}
+
+extern "C" void edlibFreeAdapterPanel(EdlibAdapterPanel* const panel) {
+    delete panel;
+}
+
+extern "C" EdlibAllVsAllPlan edlibPlanAllVsAll(const int* const lengths, const int numSequences,
+                                               const int numShards) {
+    EdlibAllVsAllPlan plan;
+    plan.status = EDLIB_STATUS_OK;
+    plan.tiles = NULL;
+    plan.numTiles = 0;
+    plan.shardTiles = NULL;
+    plan.numShards = 0;
+    bool validLengths = numSequences >= 0;
+    for (int i = 0; validLengths && i < numSequences; i++) validLengths = lengths[i] >= 0;
+    if (!validLengths || numShards <= 0) {
+        plan.status = EDLIB_STATUS_ERROR;
+        return plan;
+    }
+
+    // Smallest number of blocks that gives at least 8 tiles per shard.
+    int numBlocks = 1;
+    while (numBlocks < numSequences && static_cast<long long>(numBlocks) * (numBlocks + 1) / 2 < 8LL * numShards) {
+        numBlocks++;
+    }
+    double totalLength = 0;
+    for (int i = 0; i < numSequences; i++) totalLength += max(lengths[i], 1);
+
+    // Block b consists of sequences from blockStarts[b] to blockStarts[b + 1] - 1, cut where prefix sum of
+    // lengths reaches b / numBlocks of total, while keeping each block non-empty.
+    vector<int> blockStarts(numBlocks + 1, numSequences);
+    vector<double> blockLengths(numBlocks, 0);  // Sum of lengths of sequences in block.
+    vector<double> blockSquares(numBlocks, 0);  // Sum of squares of lengths of sequences in block.
+    blockStarts[0] = 0;
+    double prefixLength = 0;
+    for (int b = 1, i = 0; b < numBlocks; b++) {
+        while (i < numSequences - (numBlocks - b) && (i < blockStarts[b - 1] + 1
+                                                     || prefixLength < totalLength * b / numBlocks)) {
+            prefixLength += max(lengths[i], 1);
+            i++;
+        }
+        blockStarts[b] = i;
+    }
+    for (int b = 0; b < numBlocks; b++) {
+        for (int i = blockStarts[b]; i < blockStarts[b + 1]; i++) {
+            const double length = max(lengths[i], 1);
+            blockLengths[b] += length;
+            blockSquares[b] += length * length;
+        }
+    }
+
+    vector<EdlibTile> tiles;
+    for (int r = 0; r < numBlocks; r++) {
+        for (int c = r; c < numBlocks; c++) {
+            EdlibTile tile;
+            tile.rowBegin = blockStarts[r];
+            tile.rowEnd = blockStarts[r + 1];
+            tile.columnBegin = blockStarts[c];
+            tile.columnEnd = blockStarts[c + 1];
+            if (r == c) {  // Only pairs above diagonal.
+                if (tile.rowEnd - tile.rowBegin < 2) continue;
+                tile.work = (blockLengths[r] * blockLengths[r] - blockSquares[r]) / 2;
+            } else {
+                tile.work = blockLengths[r] * blockLengths[c];
+            }
+            tiles.push_back(tile);
+        }
+    }
+    double totalWork = 0;
+    for (const EdlibTile& tile : tiles) totalWork += tile.work;
+
+    // Tile goes to shard that middle of its work falls into, so shards get consecutive tiles and
+    // each has at most one tile more work than its share.
+    plan.numTiles = static_cast<int>(tiles.size());
+    plan.numShards = numShards;
+    plan.tiles = static_cast<EdlibTile*>(malloc(sizeof(EdlibTile) * max(plan.numTiles, 1)));
+    plan.shardTiles = static_cast<int*>(malloc(sizeof(int) * (numShards + 1)));
+    int shard = 0;
+    double workBefore = 0;
+    plan.shardTiles[0] = 0;
+    for (int t = 0; t < plan.numTiles; t++) {
+        plan.tiles[t] = tiles[t];
+        const double middle = workBefore + tiles[t].work / 2;
+        const int tileShard = min(numShards - 1, static_cast<int>(middle / totalWork * numShards));
+        while (shard < tileShard) plan.shardTiles[++shard] = t;
+        workBefore += tiles[t].work;
+    }
+    while (shard < numShards) plan.shardTiles[++shard] = plan.numTiles;
+    return plan;
+}
+
+extern "C" void edlibFreeAllVsAllPlan(const EdlibAllVsAllPlan plan) {
+    if (plan.tiles) free(plan.tiles);
+    if (plan.shardTiles) free(plan.shardTiles);
+}
+
+/**
+ * Result in arena, arrays are given as offsets into buffers of arena (-1 if there is no array).
+ * It is also layout of results in arena file, so its size must not depend on platform.
+ */
+struct ArenaRecord {
+    int32_t status;
+    int32_t editDistance;
+    int32_t alphabetLength;
+    int32_t numLocations;
+    int32_t hasStartLocations;  // 1 if start locations follow end locations, 0 otherwise.
+    int32_t alignmentLength;
+    int64_t locations;  // Index of first end location in locations buffer.
+    int64_t alignment;  // Index of first byte of alignment in alignments buffer.
+    int64_t cigar;  // Index of first character of zero-terminated cigar in cigars buffer.
+};
+
+/**
+ * Header of arena file. It is followed by numResults records, numLocations locations (int32_t), alignmentsSize
+ * bytes of alignments and cigarsSize bytes of cigars, each padded to multiple of 8 bytes.
+ */
+struct ArenaFileHeader {
+    char magic[8];  // ARENA_MAGIC, without terminating zero.
+    uint32_t version;  // ARENA_VERSION.
+    uint32_t byteOrder;  // ARENA_BYTE_ORDER as written by machine that wrote the file.
+    uint64_t numResults;
+    uint64_t numLocations;
+    uint64_t alignmentsSize;
+    uint64_t cigarsSize;
+};
+
+static_assert(sizeof(ArenaRecord) == 48 && sizeof(ArenaFileHeader) == 48, "Arena file layout must not be padded");
+
+static const char ARENA_MAGIC[] = "EDLIBRES";
+static const uint32_t ARENA_VERSION = 1;
+static const uint32_t ARENA_BYTE_ORDER = 0x01020304;
+
+/**
+ * Records of results and buffers with their arrays, which offsets in records point into.
+ */
+struct ArenaBuffers {
+    vector<ArenaRecord> records;
+    vector<int32_t> locations;
+    vector<unsigned char> alignments;
+    vector<char> cigars;
+
+    /**
+     * Copies arrays of result (and its cigar if withCigars is true) to the end of buffers.
+     * @return Record of result, with offsets into buffers.
+     */
+    ArenaRecord store(const EdlibAlignResult& result, const bool withCigars, const EdlibCigarFormat cigarFormat) {
+        ArenaRecord record;
+        record.status = result.status;
+        record.editDistance = result.editDistance;
+        record.alphabetLength = result.alphabetLength;
+        record.numLocations = result.endLocations ? result.numLocations : 0;
+        record.hasStartLocations = result.endLocations && result.startLocations ? 1 : 0;
+        record.alignmentLength = result.alignment ? result.alignmentLength : 0;
+        record.locations = record.alignment = record.cigar = -1;
+        if (result.endLocations) {
+            record.locations = static_cast<int64_t>(locations.size());
+            locations.insert(locations.end(), result.endLocations, result.endLocations + record.numLocations);
+            if (record.hasStartLocations) {
+                locations.insert(locations.end(), result.startLocations, result.startLocations + record.numLocations);
+            }
+        }
+        if (result.alignment) {
+            record.alignment = static_cast<int64_t>(alignments.size());
+            alignments.insert(alignments.end(), result.alignment, result.alignment + record.alignmentLength);
+            const size_t cigarStart = cigars.size();
+            if (withCigars && appendCigar(result.alignment, result.alignmentLength, cigarFormat, &cigars)) {
+                record.cigar = static_cast<int64_t>(cigarStart);
+            }
+        }
+        return record;
+    }
+};
+
+struct EdlibResultArena {
+    bool withCigars;
+    EdlibCigarFormat cigarFormat;
+    // Buffers of arena that is being built, empty if arena was created from file or buffer.
+    ArenaBuffers buffers;
+    // Contents of file, if arena was loaded from it: memory mapped if possible, otherwise read into fileContents.
+    vector<uint64_t> fileContents;
+    void* mappedFile;
+    size_t mappedSize;
+    bool readOnly;
+    // Contents of arena, in its own buffers or in buffer that it was created from.
+    const ArenaRecord* records;
+    uint64_t numResults;
+    const int32_t* locations;
+    uint64_t numLocations;
+    const unsigned char* alignments;
+    uint64_t alignmentsSize;
+    const char* cigars;
+    uint64_t cigarsSize;
+
+    EdlibResultArena(const bool withCigars_, const EdlibCigarFormat cigarFormat_, const bool readOnly_)
+        : withCigars(withCigars_), cigarFormat(cigarFormat_), mappedFile(NULL), mappedSize(0),
+          readOnly(readOnly_) {
+        viewBuffers();
+    }
+
+    ~EdlibResultArena() {
+#if !defined(_WIN32)
+        if (mappedFile) munmap(mappedFile, mappedSize);
+#endif
+    }
+
+    // Points contents to own buffers, which move as they grow.
+    void viewBuffers() {
+        records = buffers.records.data();
+        numResults = buffers.records.size();
+        locations = buffers.locations.data();
+        numLocations = buffers.locations.size();
+        alignments = buffers.alignments.data();
+        alignmentsSize = buffers.alignments.size();
+        cigars = buffers.cigars.data();
+        cigarsSize = buffers.cigars.size();
+    }
+};
+
+static inline uint64_t paddedTo8(const uint64_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+extern "C" EdlibResultArena* edlibNewResultArena(const int withCigars, const EdlibCigarFormat cigarFormat) {
+    return new EdlibResultArena(withCigars != 0, cigarFormat, false);
+}
+
+extern "C" int edlibResultArenaAppend(EdlibResultArena* const arena, EdlibAlignResult* const results,
+                                      const int numResults) {
+    if (arena->readOnly || numResults < 0) return EDLIB_STATUS_ERROR;
+    for (int i = 0; i < numResults; i++) {
+        EdlibAlignResult& result = results[i];
+        arena->buffers.records.push_back(arena->buffers.store(result, arena->withCigars, arena->cigarFormat));
+        edlibFreeAlignResult(result);
+        result.endLocations = result.startLocations = NULL;
+        result.alignment = NULL;
+    }
+    arena->viewBuffers();
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" int edlibAlignQueriesToArena(const char* const* const queries, const int* const queryLengths,
+                                        const int numQueries, const char* const target, const int targetLength,
+                                        const EdlibAlignConfig config, EdlibResultArena* const arena) {
+    if (arena->readOnly) return EDLIB_STATUS_ERROR;
+    // Records are placed at once, and each is filled when its result is found.
+    ArenaBuffers& buffers = arena->buffers;
+    const size_t firstRecord = buffers.records.size();
+    buffers.records.resize(firstRecord + max(0, numQueries));
+    const int status = alignQueries(queries, queryLengths, numQueries, target, targetLength, config, true,
+                                    [&](const int q, EdlibAlignResult* const result) {
+        buffers.records[firstRecord + q] = buffers.store(*result, arena->withCigars, arena->cigarFormat);
+        edlibFreeAlignResult(*result);
+    });
+    if (status != EDLIB_STATUS_OK) buffers.records.resize(firstRecord);
+    arena->viewBuffers();
+    return status;
+}
+
+extern "C" int edlibAlignAllPairsToArena(const char* const* const queries, const int* const queryLengths,
+                                         const int numQueries,
+                                         const char* const* const targets, const int* const targetLengths,
+                                         const int numTargets,
+                                         const EdlibAlignConfig config, EdlibResultArena* const arena) {
+    if (arena->readOnly) return EDLIB_STATUS_ERROR;
+    // Each task stores arrays into its own part, while records are placed at once and each task fills
+    // records of its pairs. Once all are computed, parts are appended to arena and records moved to point there.
+    ArenaBuffers& buffers = arena->buffers;
+    const size_t firstRecord = buffers.records.size();
+    const size_t numPairs = numQueries > 0 && numTargets > 0 ? static_cast<size_t>(numQueries) * numTargets : 0;
+    buffers.records.resize(firstRecord + numPairs);
+    vector<ArenaBuffers> parts(resolveNumThreads(config.numThreads));
+    vector<int> pairParts(numPairs);
+    const int status = alignAllPairs(queries, queryLengths, numQueries, targets, targetLengths, numTargets, config,
+                                     true, [&](const int task, const size_t pair, EdlibAlignResult* const result) {
+        buffers.records[firstRecord + pair] = parts[task].store(*result, arena->withCigars, arena->cigarFormat);
+        pairParts[pair] = task;
+        edlibFreeAlignResult(*result);
+    });
+    if (status != EDLIB_STATUS_OK) {
+        buffers.records.resize(firstRecord);
+        arena->viewBuffers();
+        return status;
+    }
+    vector<int64_t> locationsStarts, alignmentsStarts, cigarsStarts;
+    for (const ArenaBuffers& part : parts) {
+        locationsStarts.push_back(static_cast<int64_t>(buffers.locations.size()));
+        alignmentsStarts.push_back(static_cast<int64_t>(buffers.alignments.size()));
+        cigarsStarts.push_back(static_cast<int64_t>(buffers.cigars.size()));
+        buffers.locations.insert(buffers.locations.end(), part.locations.begin(), part.locations.end());
+        buffers.alignments.insert(buffers.alignments.end(), part.alignments.begin(), part.alignments.end());
+        buffers.cigars.insert(buffers.cigars.end(), part.cigars.begin(), part.cigars.end());
+    }
+    for (size_t pair = 0; pair < numPairs; pair++) {
+        ArenaRecord& record = buffers.records[firstRecord + pair];
+        const int part = pairParts[pair];
+        if (record.locations >= 0) record.locations += locationsStarts[part];
+        if (record.alignment >= 0) record.alignment += alignmentsStarts[part];
+        if (record.cigar >= 0) record.cigar += cigarsStarts[part];
+    }
+    arena->viewBuffers();
+    return EDLIB_STATUS_OK;
+}
+
+extern "C" long long edlibResultArenaSize(const EdlibResultArena* const arena) {
+    return static_cast<long long>(arena->numResults);
+}
+
+extern "C" EdlibAlignResult edlibResultArenaGet(const EdlibResultArena* const arena, const long long index) {
+    EdlibAlignResult result;
+    result.endLocations = result.startLocations = NULL;
+    result.alignment = NULL;
+    result.numLocations = result.alignmentLength = 0;
+    if (index < 0 || static_cast<uint64_t>(index) >= arena->numResults) {
+        result.status = EDLIB_STATUS_ERROR;
+        result.editDistance = -1;
+        result.alphabetLength = 0;
+        return result;
+    }
+    const ArenaRecord& record = arena->records[index];
+    result.status = record.status;
+    result.editDistance = record.editDistance;
+    result.alphabetLength = record.alphabetLength;
+    if (record.locations >= 0) {
+        result.numLocations = record.numLocations;
+        result.endLocations = const_cast<int*>(arena->locations + record.locations);
+        if (record.hasStartLocations) result.startLocations = result.endLocations + record.numLocations;
+    }
+    if (record.alignment >= 0) {
+        result.alignmentLength = record.alignmentLength;
+        result.alignment = const_cast<unsigned char*>(arena->alignments + record.alignment);
+    }
+    return result;
+}
+
+extern "C" const char* edlibResultArenaCigar(const EdlibResultArena* const arena, const long long index) {
+    if (index < 0 || static_cast<uint64_t>(index) >= arena->numResults) return NULL;
+    const int64_t cigar = arena->records[index].cigar;
+    return cigar >= 0 ? arena->cigars + cigar : NULL;
+}
+
+extern "C" int edlibSaveResultArena(const EdlibResultArena* const arena, const char* const path) {
+    ArenaFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARENA_MAGIC, sizeof(header.magic));
+    header.version = ARENA_VERSION;
+    header.byteOrder = ARENA_BYTE_ORDER;
+    header.numResults = arena->numResults;
+    header.numLocations = arena->numLocations;
+    header.alignmentsSize = arena->alignmentsSize;
+    header.cigarsSize = arena->cigarsSize;
+
+    FILE* const file = fopen(path, "wb");
+    if (file == NULL) return EDLIB_STATUS_ERROR;
+    const char padding[8] = {0};
+    // Writes section and pads it to multiple of 8 bytes.
+    const auto writeSection = [&](const void* const data, const uint64_t size) {
+        const uint64_t paddingSize = paddedTo8(size) - size;
+        return (size == 0 || fwrite(data, 1, size, file) == size)
+            && (paddingSize == 0 || fwrite(padding, 1, paddingSize, file) == paddingSize);
+    };
+    bool written = writeSection(&header, sizeof(header))
+        && writeSection(arena->records, sizeof(ArenaRecord) * arena->numResults)
+        && writeSection(arena->locations, sizeof(int32_t) * arena->numLocations)
+        && writeSection(arena->alignments, arena->alignmentsSize)
+        && writeSection(arena->cigars, arena->cigarsSize);
+    written = fclose(file) == 0 && written;
+    return written ? EDLIB_STATUS_OK : EDLIB_STATUS_ERROR;
+}
+
+/**
+ * Points contents of arena into buffer with contents of arena file, if they are valid.
+ * @return False if buffer is not valid arena file.
+ */
+static bool viewArenaFile(const char* const buffer, const uint64_t size, EdlibResultArena* const arena) {
+    ArenaFileHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, buffer, sizeof(header));
+    if (memcmp(header.magic, ARENA_MAGIC, sizeof(header.magic)) || header.version != ARENA_VERSION
+        || header.byteOrder != ARENA_BYTE_ORDER) {
+        return false;
+    }
+    // Sizes are checked one by one against size of buffer, so that computing sections can not overflow.
+    uint64_t position = sizeof(header);
+    const auto section = [&](const uint64_t count, const uint64_t elementSize, uint64_t* const start) {
+        if (count > (size - position) / elementSize) return false;
+        *start = position;
+        position += paddedTo8(count * elementSize);
+        return position <= size;
+    };
+    uint64_t recordsStart, locationsStart, alignmentsStart, cigarsStart;
+    if (!section(header.numResults, sizeof(ArenaRecord), &recordsStart)
+        || !section(header.numLocations, sizeof(int32_t), &locationsStart)
+        || !section(header.alignmentsSize, 1, &alignmentsStart)
+        || !section(header.cigarsSize, 1, &cigarsStart)
+        || (header.cigarsSize > 0 && buffer[cigarsStart + header.cigarsSize - 1] != 0)) {
+        return false;
+    }
+    arena->records = reinterpret_cast<const ArenaRecord*>(buffer + recordsStart);
+    arena->numResults = header.numResults;
+    arena->locations = reinterpret_cast<const int32_t*>(buffer + locationsStart);
+    arena->numLocations = header.numLocations;
+    arena->alignments = reinterpret_cast<const unsigned char*>(buffer + alignmentsStart);
+    arena->alignmentsSize = header.alignmentsSize;
+    arena->cigars = buffer + cigarsStart;
+    arena->cigarsSize = header.cigarsSize;
+
+    // Each record must point inside of buffers, so that results can be read without checks.
+    for (uint64_t i = 0; i < arena->numResults; i++) {
+        const ArenaRecord& record = arena->records[i];
+        if (record.numLocations < 0 || record.alignmentLength < 0) return false;
+        const uint64_t numLocations = static_cast<uint64_t>(record.numLocations)
+            * (record.hasStartLocations ? 2 : 1);
+        if ((record.locations < 0 && (record.locations != -1 || record.numLocations != 0))
+            || (record.locations >= 0 && (static_cast<uint64_t>(record.locations) > arena->numLocations
+                                         || numLocations > arena->numLocations - record.locations))
+            || (record.alignment < 0 && (record.alignment != -1 || record.alignmentLength != 0))
+            || (record.alignment >= 0 && (static_cast<uint64_t>(record.alignment) > arena->alignmentsSize
+                                         || static_cast<uint64_t>(record.alignmentLength)
+                                            > arena->alignmentsSize - record.alignment))
+            || record.cigar < -1
+            || (record.cigar >= 0 && static_cast<uint64_t>(record.cigar) >= arena->cigarsSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" EdlibResultArena* edlibLoadResultArena(const char* const path) {
+    EdlibResultArena* const arena = new EdlibResultArena(false, EDLIB_CIGAR_STANDARD, true);
+    const char* contents = NULL;
+    uint64_t size = 0;
+#if !defined(_WIN32)
+    // File is memory mapped, so its pages are read only when results on them are used. Mapping starts
+    // at page boundary, so sections of file are aligned.
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        delete arena;
+        return NULL;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        void* const mapped = mmap(NULL, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            arena->mappedFile = mapped;
+            arena->mappedSize = static_cast<size_t>(fileStat.st_size);
+            contents = static_cast<const char*>(mapped);
+            size = arena->mappedSize;
+        }
+    }
+    close(fd);
+#else
+    FILE* const file = fopen(path, "rb");
+    if (file == NULL) {
+        delete arena;
+        return NULL;
+    }
+    // File is read in chunks into buffer of 8-byte words, so that its sections are aligned.
+    const size_t CHUNK_WORDS = 1 << 16;
+    while (true) {
+        arena->fileContents.resize(paddedTo8(size + CHUNK_WORDS * 8) / 8);
+        const size_t numRead = fread(reinterpret_cast<char*>(arena->fileContents.data()) + size, 1,
+                                     CHUNK_WORDS * 8, file);
+        size += numRead;
+        if (numRead < CHUNK_WORDS * 8) break;
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    if (!failed) contents = reinterpret_cast<const char*>(arena->fileContents.data());
+#endif
+    if (contents == NULL || !viewArenaFile(contents, size, arena)) {
+        delete arena;
+        return NULL;
+    }
+    return arena;
+}
+
+extern "C" EdlibResultArena* edlibResultArenaFromBuffer(const void* const buffer, const long long size) {
+    if (buffer == NULL || size < 0 || reinterpret_cast<uintptr_t>(buffer) % 8 != 0) return NULL;
+    EdlibResultArena* const arena = new EdlibResultArena(false, EDLIB_CIGAR_STANDARD, true);
+    if (!viewArenaFile(static_cast<const char*>(buffer), static_cast<uint64_t>(size), arena)) {
+        delete arena;
+        return NULL;
+    }
+    return arena;
+}
+
+extern "C" void edlibFreeResultArena(EdlibResultArena* const arena) {
+    delete arena;
+}
 
 extern "C" EdlibAlignConfig edlibNewAlignConfig(int k, EdlibAlignMode mode, EdlibAlignTask task,
                                                 const EdlibEqualityPair* additionalEqualities,
@@ -1468,6 +5687,16 @@ extern "C" EdlibAlignConfig edlibNewAlignConfig(int k, EdlibAlignMode mode, Edli
     config.task = task;
     config.additionalEqualities = additionalEqualities;
     config.additionalEqualitiesLength = additionalEqualitiesLength;
+    config.equalityPresets = 0;
+    config.equalitySet = NULL;
+    config.numThreads = 1;
+    config.speculativeRounds = 1;
+    config.executor = NULL;
+    config.cancellationToken = NULL;
+    config.timeoutMs = 0;
+    config.progressCallback = NULL;
+    config.progressContext = NULL;
+    config.progressIntervalMs = ProgressReporter::DEFAULT_INTERVAL_MS;
     return config;
 }
 
@@ -1475,8 +5704,29 @@ extern "C" EdlibAlignConfig edlibDefaultAlignConfig(void) {
     return edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0);
 }
 
+extern "C" EdlibEqualitySet* edlibNewEqualitySet(const EdlibEqualityPair* additionalEqualities,
+                                                 int additionalEqualitiesLength, int equalityPresets) {
+    return new EdlibEqualitySet(additionalEqualities, additionalEqualitiesLength, equalityPresets);
+}
+
+extern "C" void edlibFreeEqualitySet(EdlibEqualitySet* equalitySet) {
+    delete equalitySet;
+}
+
+extern "C" EdlibCancellationToken* edlibNewCancellationToken(void) {
+    return new EdlibCancellationToken();
+}
+
+extern "C" void edlibCancel(EdlibCancellationToken* cancellationToken) {
+    cancellationToken->cancelled.store(true);
+}
+
+extern "C" void edlibFreeCancellationToken(EdlibCancellationToken* cancellationToken) {
+    delete cancellationToken;
+}
+
 extern "C" void edlibFreeAlignResult(EdlibAlignResult result) {
-    if (result.endLocations) free(result.endLocations);
-    if (result.startLocations) free(result.startLocations);
-    if (result.alignment) free(result.alignment);
+    freeResultArray(result.endLocations);
+    freeResultArray(result.startLocations);
+    freeResultArray(result.alignment);
 }
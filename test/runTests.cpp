@@ -3,6 +3,14 @@
 #include <cstdlib>
 #include <cstring>
 #include <climits>
+#include <cctype>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include "edlib.h"
 #include "SimpleEditDistance.h"
@@ -569,12 +577,1494 @@ bool testEmptySequences() {
     return r;
 }
 
+// Packs DNA sequence into 2 bits per base and collects intervals of N.
+void packSequence(const char* seq, int length,
+                  vector<unsigned char>* data, vector<EdlibInterval>* nIntervals) {
+    data->assign((length + 3) / 4, 0);
+    nIntervals->clear();
+    for (int i = 0; i < length; i++) {
+        unsigned char code = 0;
+        switch (seq[i]) {
+        case 'C': code = 1; break;
+        case 'G': code = 2; break;
+        case 'T': code = 3; break;
+        case 'N':
+            if (!nIntervals->empty() && nIntervals->back().end == i) {
+                nIntervals->back().end++;
+            } else {
+                EdlibInterval interval = {i, i + 1};
+                nIntervals->push_back(interval);
+            }
+            break;
+        }
+        (*data)[i / 4] |= code << (2 * (i % 4));
+    }
+}
+
+bool testPackedSequences() {
+    printf("Packed sequences: ");
+    const char bases[] = "ACGT";
+    bool pass = true;
+    for (int i = 0; i < 30 && pass; i++) {
+        int queryLength = 1 + rand() % 150;
+        int targetLength = 1 + rand() % 2000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = bases[rand() % 4];
+        for (int j = 0; j < targetLength; j++) target[j] = bases[rand() % 4];
+        // Put some runs of N into target and occasionally into query.
+        for (int j = 0; j < targetLength; j += 1 + rand() % 500) {
+            for (int r = rand() % 100; r > 0 && j < targetLength; r--) target[j++] = 'N';
+        }
+        if (i % 3 == 0) query[rand() % queryLength] = 'N';
+
+        vector<unsigned char> queryData, targetData;
+        vector<EdlibInterval> queryNs, targetNs;
+        packSequence(query.data(), queryLength, &queryData, &queryNs);
+        packSequence(target.data(), targetLength, &targetData, &targetNs);
+        EdlibPackedSequence packedQuery = {queryData.data(), queryLength,
+                                           queryNs.data(), static_cast<int>(queryNs.size())};
+        EdlibPackedSequence packedTarget = {targetData.data(), targetLength,
+                                            targetNs.data(), static_cast<int>(targetNs.size())};
+
+        EdlibAlignMode modes[3] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+        for (int m = 0; m < 3 && pass; m++) {
+            EdlibAlignConfig config = edlibNewAlignConfig(-1, modes[m], EDLIB_TASK_PATH, NULL, 0);
+            EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+            EdlibAlignResult result = edlibAlignPacked(packedQuery, packedTarget, config);
+            pass = result.status == EDLIB_STATUS_OK
+                && result.editDistance == expected.editDistance
+                && result.numLocations == expected.numLocations
+                && result.alignmentLength == expected.alignmentLength;
+            for (int j = 0; pass && j < result.numLocations; j++) {
+                pass = result.endLocations[j] == expected.endLocations[j]
+                    && result.startLocations[j] == expected.startLocations[j];
+            }
+            if (pass) {
+                pass = memcmp(result.alignment, expected.alignment, result.alignmentLength) == 0;
+            }
+            edlibFreeAlignResult(expected);
+            edlibFreeAlignResult(result);
+        }
+    }
+
+    // Overlapping N intervals are not valid.
+    unsigned char data[1] = {0};
+    EdlibInterval overlapping[2] = {{0, 2}, {1, 3}};
+    EdlibPackedSequence invalid = {data, 4, overlapping, 2};
+    EdlibAlignResult result = edlibAlignPacked(invalid, invalid, edlibDefaultAlignConfig());
+    pass = pass && result.status == EDLIB_STATUS_ERROR;
+    edlibFreeAlignResult(result);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testEqualityPresets() {
+    printf("Equality presets: ");
+    bool pass = true;
+
+    // Case insensitive alignment must be same as alignment of uppercased sequences.
+    const char mixedCase[] = "ACGTacgt";
+    for (int i = 0; i < 20 && pass; i++) {
+        int queryLength = 1 + rand() % 200;
+        int targetLength = 1 + rand() % 1000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = mixedCase[rand() % 8];
+        for (int j = 0; j < targetLength; j++) target[j] = mixedCase[rand() % 8];
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+        config.equalityPresets = EDLIB_EQUALITY_CASE_INSENSITIVE;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        for (int j = 0; j < queryLength; j++) query[j] = static_cast<char>(toupper(query[j]));
+        for (int j = 0; j < targetLength; j++) target[j] = static_cast<char>(toupper(target[j]));
+        config.equalityPresets = 0;
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations
+            && result.alphabetLength == expected.alphabetLength
+            && result.alignmentLength == expected.alignmentLength;
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+
+    // IUPAC preset must be same as listing all pairs of codes that overlap.
+    const char codes[] = "ACGTRYN";
+    const int codeBases[] = {1, 2, 4, 8, 1 | 4, 2 | 8, 15};
+    vector<EdlibEqualityPair> pairs;
+    for (int a = 0; a < 7; a++) {
+        for (int b = a + 1; b < 7; b++) {
+            if (codeBases[a] & codeBases[b]) {
+                EdlibEqualityPair pair = {codes[a], codes[b]};
+                pairs.push_back(pair);
+            }
+        }
+    }
+    // Same pairs, built once into equality set.
+    EdlibEqualitySet* equalitySet = edlibNewEqualitySet(pairs.data(), static_cast<int>(pairs.size()), 0);
+    for (int i = 0; i < 20 && pass; i++) {
+        int queryLength = 1 + rand() % 200;
+        int targetLength = 1 + rand() % 1000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = codes[rand() % 7];
+        for (int j = 0; j < targetLength; j++) target[j] = codes[rand() % 7];
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+        config.equalityPresets = EDLIB_EQUALITY_IUPAC_NUCLEOTIDE;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        EdlibAlignResult expected = edlibAlign(
+                query.data(), queryLength, target.data(), targetLength,
+                edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH,
+                                    pairs.data(), static_cast<int>(pairs.size())));
+        config.equalityPresets = 0;
+        config.equalitySet = equalitySet;
+        EdlibAlignResult fromSet = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.editDistance == expected.editDistance
+            && result.alignmentLength == expected.alignmentLength
+            && fromSet.editDistance == expected.editDistance
+            && fromSet.alignmentLength == expected.alignmentLength;
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+        edlibFreeAlignResult(fromSet);
+    }
+    edlibFreeEqualitySet(equalitySet);
+
+    // Soft-masked degenerate query, same as in testCustomEqualityRelation().
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+    config.equalityPresets = EDLIB_EQUALITY_CASE_INSENSITIVE | EDLIB_EQUALITY_IUPAC_NUCLEOTIDE;
+    EdlibAlignResult result = edlibAlign("gtgnrtcarcgaanctttn", 19,
+                                         "GTGAGTCATCGAATCTTTGAACGCACCTTGCGCTCCTTGGT", 41, config);
+    pass = pass && result.status == EDLIB_STATUS_OK && result.editDistance == 1;
+    edlibFreeAlignResult(result);
+
+    // Amino acid codes.
+    config.equalityPresets = EDLIB_EQUALITY_IUPAC_AMINO_ACID;
+    result = edlibAlign("MBZJX", 5, "MDQLW", 5, config);
+    pass = pass && result.status == EDLIB_STATUS_OK && result.editDistance == 0;
+    edlibFreeAlignResult(result);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testForeignTargetCharacters() {
+    printf("Target characters absent from query: ");
+    bool pass = true;
+
+    // X, Y and Z are not in query, so they all match nothing, but they are still counted in alphabet.
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+    EdlibAlignResult result = edlibAlign("ACGT", 4, "XXACYTZZ", 8, config);
+    pass = pass && result.editDistance == 1 && result.alphabetLength == 7
+        && result.numLocations == 1 && result.endLocations[0] == 5 && result.startLocations[0] == 2;
+    edlibFreeAlignResult(result);
+
+    // R is not in query, but it is equal to A and G, so it must not be treated as foreign.
+    config.mode = EDLIB_MODE_NW;
+    config.equalityPresets = EDLIB_EQUALITY_IUPAC_NUCLEOTIDE;
+    result = edlibAlign("AGA", 3, "RRX", 3, config);
+    pass = pass && result.editDistance == 1 && result.alphabetLength == 4;
+    edlibFreeAlignResult(result);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testForeignRuns() {
+    printf("Runs of target characters absent from query: ");
+    bool pass = true;
+
+    // Long runs of N, and runs that mix different characters absent from query (like NNRNN or text),
+    // are fast-forwarded in HW, so results must be the same as those of simple algorithm.
+    const char* const runCharacters[3] = {"N", "NNNRNYN", "xyz .,;!"};
+    for (int i = 0; i < 100 && pass; i++) {
+        int queryLength = 1 + rand() % 300;
+        vector<char> query(queryLength), target;
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        const char* const run = runCharacters[i % 3];
+        const int numRunCharacters = static_cast<int>(strlen(run));
+        for (int part = 0; part < 4; part++) {
+            int numBases = rand() % 500;
+            for (int j = 0; j < numBases; j++) {
+                // Parts of query, with some mutations.
+                target.push_back(rand() % 4 ? query[(part * 7 + j) % queryLength] : "ACGT"[rand() % 4]);
+            }
+            int runLength = rand() % 2000;
+            for (int j = 0; j < runLength; j++) target.push_back(run[rand() % numRunCharacters]);
+        }
+        if (target.empty()) continue;
+        int targetLength = static_cast<int>(target.size());
+        int k = rand() % 2 ? -1 : rand() % (queryLength + 1);
+        EdlibAlignConfig config = edlibNewAlignConfig(k, EDLIB_MODE_HW, EDLIB_TASK_LOC, NULL, 0);
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        int expectedScore, numExpectedLocations;
+        int* expectedLocations;
+        calcEditDistanceSimple(query.data(), queryLength, target.data(), targetLength, EDLIB_MODE_HW,
+                               &expectedScore, &expectedLocations, &numExpectedLocations);
+        if (k >= 0 && expectedScore > k) {
+            pass = result.editDistance == -1;
+        } else {
+            pass = result.editDistance == expectedScore && result.numLocations == numExpectedLocations;
+            for (int j = 0; pass && j < result.numLocations; j++) {
+                pass = result.endLocations[j] == expectedLocations[j];
+            }
+        }
+        delete[] expectedLocations;
+        edlibFreeAlignResult(result);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testParallelHW() {
+    printf("HW split between threads: ");
+    bool pass = true;
+
+    for (int i = 0; i < 10 && pass; i++) {
+        int queryLength = 1 + rand() % 300;
+        int targetLength = 200000 + rand() % 200000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) target[j] = "ACGT"[rand() % 4];
+        // Put copies of query with a few mutations in target, some of them around chunk boundaries.
+        for (int copy = 0; copy < 8; copy++) {
+            int start = copy % 2 ? rand() % (targetLength - queryLength)
+                                 : max(0, targetLength * (copy / 2 + 1) / 4 - queryLength / 2 - rand() % 10);
+            for (int j = 0; j < queryLength && start + j < targetLength; j++) {
+                target[start + j] = rand() % 20 ? query[j] : "ACGT"[rand() % 4];
+            }
+        }
+        EdlibAlignConfig config = edlibNewAlignConfig(rand() % 2 ? -1 : rand() % (queryLength + 1),
+                                                      EDLIB_MODE_HW, EDLIB_TASK_LOC, NULL, 0);
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        config.numThreads = 4;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations;
+        for (int j = 0; pass && j < result.numLocations; j++) {
+            pass = result.endLocations[j] == expected.endLocations[j]
+                && result.startLocations[j] == expected.startLocations[j];
+        }
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testPipelinedNW() {
+    printf("NW pipelined between threads: ");
+    bool pass = true;
+
+    // Edit distance must be large for pipeline to be used, so sequences are only loosely similar.
+    for (int i = 0; i < 6 && pass; i++) {
+        int queryLength = 10000 + rand() % 20000;
+        int targetLength = 10000 + rand() % 20000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) {
+            target[j] = j < queryLength && rand() % 3 ? query[j] : "ACGT"[rand() % 4];
+        }
+        EdlibAlignConfig config = edlibNewAlignConfig(i % 2 ? -1 : max(queryLength, targetLength) / 2,
+                                                      EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0);
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        config.numThreads = 2 + i;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.editDistance == expected.editDistance;
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testSpeculativeRounds() {
+    printf("Speculative rounds of k: ");
+    bool pass = true;
+
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    for (int i = 0; i < 30 && pass; i++) {
+        int queryLength = 1 + rand() % 3000;
+        int targetLength = 1 + rand() % 3000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) {
+            target[j] = j < queryLength && rand() % 2 ? query[j] : "ACGT"[rand() % 4];
+        }
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, modes[i % 3], EDLIB_TASK_PATH, NULL, 0);
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        config.speculativeRounds = 2 + i % 3;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations
+            && result.alignmentLength == expected.alignmentLength;
+        for (int j = 0; pass && j < result.numLocations; j++) {
+            pass = result.endLocations[j] == expected.endLocations[j]
+                && result.startLocations[j] == expected.startLocations[j];
+        }
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+// Concurrent rounds of NW must not share any state (this test is also meant to be run with thread sanitizer).
+bool testSpeculativeRoundsNW() {
+    printf("Speculative rounds of k in NW: ");
+    bool pass = true;
+
+    for (int i = 0; i < 20 && pass; i++) {
+        int queryLength = 1 + rand() % 2000;
+        int targetLength = 1 + rand() % 2000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) {
+            target[j] = j < queryLength && rand() % 4 ? query[j] : "ACGT"[rand() % 4];
+        }
+        const EdlibAlignTask task = i % 2 ? EDLIB_TASK_PATH : EDLIB_TASK_DISTANCE;
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, task, NULL, 0);
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        config.speculativeRounds = 4;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.status == EDLIB_STATUS_OK && result.editDistance == expected.editDistance
+            && result.alignmentLength == expected.alignmentLength
+            && (result.alignmentLength == 0
+                || !memcmp(result.alignment, expected.alignment, result.alignmentLength));
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+// Executor that runs each task in new thread, and counts tasks.
+void submitToNewThread(void* numSubmitted, EdlibTask task, void* taskContext) {
+    (*static_cast<std::atomic<int>*>(numSubmitted))++;
+    std::thread(task, taskContext).detach();
+}
+
+bool testExecutor() {
+    printf("Custom executor: ");
+    bool pass = true;
+
+    std::atomic<int> numSubmitted(0);
+    EdlibExecutor executor = {submitToNewThread, &numSubmitted};
+    const EdlibAlignMode modes[] = {EDLIB_MODE_HW, EDLIB_MODE_NW};
+    for (int i = 0; i < 4 && pass; i++) {
+        // HW is split into chunks and NW is pipelined only for long sequences with large edit distance.
+        int queryLength = modes[i % 2] == EDLIB_MODE_HW ? 1 + rand() % 300 : 20000;
+        int targetLength = modes[i % 2] == EDLIB_MODE_HW ? 300000 : 20000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) {
+            target[j] = j < queryLength && rand() % 3 ? query[j] : "ACGT"[rand() % 4];
+        }
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, modes[i % 2], EDLIB_TASK_LOC, NULL, 0);
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        config.numThreads = 3;
+        config.speculativeRounds = i < 2 ? 1 : 2;
+        config.executor = &executor;
+        EdlibAlignResult result = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+        pass = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations;
+        for (int j = 0; pass && j < result.numLocations; j++) {
+            pass = result.endLocations[j] == expected.endLocations[j];
+        }
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+    pass = pass && numSubmitted > 0;
+
+    // 0 threads (as in zero-initialized config) is the same as one thread, so executor is not used.
+    numSubmitted = 0;
+    vector<char> target(300000);
+    for (size_t j = 0; j < target.size(); j++) target[j] = "ACGT"[rand() % 4];
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_LOC, NULL, 0);
+    config.numThreads = 0;
+    config.executor = &executor;
+    EdlibAlignResult result = edlibAlign("ACGTACGTAC", 10, target.data(), static_cast<int>(target.size()), config);
+    pass = pass && result.status == EDLIB_STATUS_OK && numSubmitted == 0;
+    edlibFreeAlignResult(result);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testCancellation() {
+    printf("Cancellation: ");
+    bool pass = true;
+
+    const int length = 100000;
+    vector<char> query(length), target(length);
+    for (int i = 0; i < length; i++) {
+        query[i] = "ACGT"[rand() % 4];
+        target[i] = "ACGT"[rand() % 4];
+    }
+    EdlibCancellationToken* token = edlibNewCancellationToken();
+
+    // Token that is not cancelled changes nothing.
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+    config.cancellationToken = token;
+    EdlibAlignResult result = edlibAlign(query.data(), 1000, target.data(), length, config);
+    pass = result.status == EDLIB_STATUS_OK && result.alignment != NULL;
+    edlibFreeAlignResult(result);
+
+    // Already cancelled token stops alignment in each mode, also in threads of alignment.
+    edlibCancel(token);
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    for (int i = 0; i < 6 && pass; i++) {
+        config = edlibNewAlignConfig(-1, modes[i % 3], EDLIB_TASK_PATH, NULL, 0);
+        config.cancellationToken = token;
+        config.numThreads = i < 3 ? 1 : 2;
+        config.speculativeRounds = i < 3 ? 1 : 2;
+        result = edlibAlign(query.data(), length, target.data(), length, config);
+        pass = result.status == EDLIB_STATUS_CANCELLED && result.editDistance == -1 && result.alignment == NULL;
+        edlibFreeAlignResult(result);
+    }
+    edlibFreeCancellationToken(token);
+
+    // Token cancelled from other thread during alignment.
+    token = edlibNewCancellationToken();
+    std::thread canceller([token]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        edlibCancel(token);
+    });
+    config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+    config.cancellationToken = token;
+    result = edlibAlign(query.data(), length, target.data(), length, config);
+    canceller.join();
+    pass = pass && result.status == EDLIB_STATUS_CANCELLED && result.alignment == NULL;
+    edlibFreeAlignResult(result);
+    edlibFreeCancellationToken(token);
+
+    // Alignment that takes longer than timeout.
+    config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+    config.timeoutMs = 1;
+    result = edlibAlign(query.data(), length, target.data(), length, config);
+    pass = pass && result.status == EDLIB_STATUS_CANCELLED && result.alignment == NULL;
+    edlibFreeAlignResult(result);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+struct ProgressLog {
+    int numReports;
+    int phases;  // Bit for each reported phase.
+    bool valid;  // False if some reported progress is not valid.
+    int cancelAfter;  // Number of reports after which alignment is cancelled, -1 for never.
+};
+
+static int logProgress(const EdlibProgress* progress, void* progressContext) {
+    ProgressLog* log = static_cast<ProgressLog*>(progressContext);
+    log->numReports++;
+    log->phases |= 1 << progress->phase;
+    log->valid = log->valid && progress->fraction >= 0 && progress->fraction <= 1 && progress->round >= 0;
+    return log->numReports == log->cancelAfter;
+}
+
+// Aligns with many different equalities from inside of progress callback, which evicts cached equality sets.
+static int alignInProgress(const EdlibProgress*, void*) {
+    for (char c = 'C'; c < 'C' + 10; c++) {
+        const EdlibEqualityPair pair = {'A', c};
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, &pair, 1);
+        edlibFreeAlignResult(edlibAlign("ACGT", 4, "CCGT", 4, config));
+    }
+    return 0;
+}
+
+bool testProgress() {
+    printf("Progress callback: ");
+    bool pass = true;
+
+    const int length = 20000;
+    vector<char> query(length), target(length);
+    for (int i = 0; i < length; i++) {
+        query[i] = "ACGT"[rand() % 4];
+        target[i] = "ACGT"[rand() % 4];
+    }
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_HW};
+    for (int i = 0; i < 4 && pass; i++) {
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, modes[i % 2], EDLIB_TASK_PATH, NULL, 0);
+        config.numThreads = i < 2 ? 1 : 2;
+        EdlibAlignResult expected = edlibAlign(query.data(), length, target.data(), length, config);
+
+        ProgressLog log = {0, 0, true, -1};
+        config.progressCallback = logProgress;
+        config.progressContext = &log;
+        config.progressIntervalMs = 1;
+        EdlibAlignResult result = edlibAlign(query.data(), length, target.data(), length, config);
+        pass = result.status == EDLIB_STATUS_OK && result.editDistance == expected.editDistance
+            && result.alignmentLength == expected.alignmentLength && log.valid && log.numReports > 0
+            && (log.phases & (1 << EDLIB_PHASE_DISTANCE)) && (log.phases & (1 << EDLIB_PHASE_ALIGNMENT));
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+
+        // Alignment is cancelled once callback asks for it.
+        log.numReports = 0;
+        log.cancelAfter = 3;
+        result = edlibAlign(query.data(), length, target.data(), length, config);
+        pass = pass && result.status == EDLIB_STATUS_CANCELLED && log.numReports == 3;
+        edlibFreeAlignResult(result);
+    }
+
+    // Equality set that is in use stays valid while callback aligns with other equalities.
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+    config.equalityPresets = EDLIB_EQUALITY_CASE_INSENSITIVE | EDLIB_EQUALITY_IUPAC_NUCLEOTIDE;
+    EdlibAlignResult expected = edlibAlign(query.data(), length, target.data(), length, config);
+    config.progressCallback = alignInProgress;
+    config.progressIntervalMs = 1;
+    EdlibAlignResult result = edlibAlign(query.data(), length, target.data(), length, config);
+    pass = pass && result.status == EDLIB_STATUS_OK && result.editDistance == expected.editDistance
+        && result.alignmentLength == expected.alignmentLength;
+    edlibFreeAlignResult(result);
+    edlibFreeAlignResult(expected);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testStream() {
+    printf("Stream search: ");
+    bool pass = true;
+
+    for (int i = 0; i < 12 && pass; i++) {
+        const int queryLength = i % 3 == 0 ? 1 + rand() % 20 : 1 + rand() % 2000;
+        const int targetLength = 1 + rand() % 300000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) target[j] = "ACGTN"[rand() % 5];
+        if (targetLength > queryLength) {  // Plant query into target, with some mutations.
+            const int start = rand() % (targetLength - queryLength);
+            for (int j = 0; j < queryLength; j++) {
+                if (rand() % 10) target[start + j] = query[j];
+            }
+        }
+        const EdlibAlignMode mode = i % 4 == 3 ? EDLIB_MODE_SHW : EDLIB_MODE_HW;
+        const int k = i % 2 ? -1 : rand() % queryLength;
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_LOC, NULL, 0);
+        EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+
+        // Chunks of very different lengths, from single characters to whole target.
+        const int chunkLength = i % 3 == 0 ? 1 : (i % 3 == 1 ? 1 + rand() % 5000 : targetLength);
+        EdlibQueryProfile* profile = edlibNewQueryProfile(query.data(), queryLength, config);
+        EdlibStream* stream = edlibStreamBegin(profile, mode, k);
+        for (int start = 0; start < targetLength; start += chunkLength) {
+            edlibStreamFeed(stream, target.data() + start, min(chunkLength, targetLength - start));
+        }
+        EdlibStreamResult result = edlibStreamEnd(stream);
+        pass = result.status == EDLIB_STATUS_OK && result.editDistance == expected.editDistance
+            && result.numLocations == expected.numLocations;
+        for (int j = 0; pass && j < result.numLocations; j++) {
+            pass = result.endLocations[j] == expected.endLocations[j];
+        }
+        edlibFreeStreamResult(result);
+        edlibFreeQueryProfile(profile);
+        edlibFreeAlignResult(expected);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testColumnState() {
+    printf("Column state: ");
+    bool pass = true;
+
+    for (int i = 0; i < 30 && pass; i++) {
+        const int queryLength = 1 + rand() % 1000;
+        const int prefixLength = rand() % 5000;
+        const int suffixLength = rand() % 5000;
+        const int targetLength = prefixLength + suffixLength;
+        vector<char> query(queryLength), target(targetLength), otherTarget;
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) {
+            target[j] = j < queryLength && rand() % 5 ? query[j] : "ACGT"[rand() % 4];
+        }
+        // Other target has same prefix, but different suffix.
+        otherTarget = target;
+        for (int j = prefixLength; j < targetLength; j++) otherTarget[j] = "ACGT"[rand() % 4];
+
+        const EdlibAlignMode mode = static_cast<EdlibAlignMode>(i % 3);
+        const int k = i % 2 ? -1 : rand() % (queryLength + targetLength);
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_LOC, NULL, 0);
+        EdlibQueryProfile* profile = edlibNewQueryProfile(query.data(), queryLength, config);
+        EdlibColumnState* state = edlibColumnStateBegin(profile, mode, k);
+        edlibColumnStateAdvance(state, target.data(), prefixLength);
+        EdlibColumnState* snapshot = edlibColumnStateCopy(state);
+        edlibColumnStateAdvance(state, target.data() + prefixLength, suffixLength);
+        edlibColumnStateAdvance(snapshot, otherTarget.data() + prefixLength, suffixLength);
+        pass = edlibColumnStatePosition(snapshot) == targetLength;
+
+        const vector<char>* targets[] = {&target, &otherTarget};
+        const EdlibColumnState* states[] = {state, snapshot};
+        for (int j = 0; j < 2 && pass; j++) {
+            EdlibAlignResult expected = edlibAlign(query.data(), queryLength, targets[j]->data(), targetLength,
+                                                   config);
+            EdlibStreamResult result = edlibColumnStateResult(states[j]);
+            pass = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations;
+            for (int l = 0; pass && l < result.numLocations; l++) {
+                pass = result.endLocations[l] == expected.endLocations[l];
+            }
+            edlibFreeStreamResult(result);
+            edlibFreeAlignResult(expected);
+        }
+
+        // k can be lowered, but not raised.
+        pass = pass && edlibColumnStateSetK(state, 0) == EDLIB_STATUS_OK
+            && edlibColumnStateSetK(state, 1) == EDLIB_STATUS_ERROR;
+        edlibFreeColumnState(state);
+        edlibFreeColumnState(snapshot);
+        edlibFreeQueryProfile(profile);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testIncremental() {
+    printf("Incremental alignment: ");
+    bool pass = true;
+
+    for (int i = 0; i < 30 && pass; i++) {
+        const int queryLength = 1 + rand() % 500;
+        int targetLength = rand() % 10000;
+        vector<char> query(queryLength), target(targetLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < targetLength; j++) {
+            target[j] = j < queryLength && rand() % 5 ? query[j] : "ACGT"[rand() % 4];
+        }
+
+        const EdlibAlignMode mode = static_cast<EdlibAlignMode>(i % 3);
+        const EdlibAlignTask task = static_cast<EdlibAlignTask>(i / 3 % 3);
+        const int k = i % 2 ? -1 : rand() % (queryLength + 20);
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, NULL, 0);
+        EdlibIncrementalAlignment* alignment = edlibIncrementalBegin(query.data(), queryLength,
+                                                                     target.data(), targetLength, config);
+        int position0 = 0;  // Position of previous edit.
+        for (int e = 0; e < 8 && pass; e++) {
+            // Edits are both near previous edit and far from it, and some of them are long.
+            const int position = e % 2 && targetLength > 0 ? min(targetLength, position0 + rand() % 20)
+                                                            : rand() % (targetLength + 1);
+            const int deletedLength = min(targetLength - position, e % 4 == 3 ? rand() % 3000 : rand() % 10);
+            vector<char> inserted(e % 4 == 2 ? rand() % 6000 : rand() % 10);
+            for (char& c : inserted) c = "ACGTN"[rand() % (e == 5 ? 5 : 4)];
+            position0 = position;
+            pass = edlibIncrementalEdit(alignment, position, deletedLength,
+                                        inserted.data(), static_cast<int>(inserted.size())) == EDLIB_STATUS_OK;
+            target.erase(target.begin() + position, target.begin() + position + deletedLength);
+            target.insert(target.begin() + position, inserted.begin(), inserted.end());
+            targetLength = static_cast<int>(target.size());
+
+            EdlibAlignResult expected = edlibAlign(query.data(), queryLength, target.data(), targetLength, config);
+            EdlibAlignResult result = edlibIncrementalResult(alignment);
+            pass = pass && result.editDistance == expected.editDistance
+                && result.numLocations == expected.numLocations
+                && result.alignmentLength == expected.alignmentLength
+                && result.alphabetLength == expected.alphabetLength;
+            for (int l = 0; pass && l < result.numLocations; l++) {
+                pass = result.endLocations[l] == expected.endLocations[l]
+                    && (expected.startLocations == NULL || result.startLocations[l] == expected.startLocations[l]);
+            }
+            for (int l = 0; pass && l < result.alignmentLength; l++) {
+                pass = result.alignment[l] == expected.alignment[l];
+            }
+            edlibFreeAlignResult(result);
+            edlibFreeAlignResult(expected);
+        }
+        edlibFreeIncrementalAlignment(alignment);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+// Edit in NW (or SHW) changes all later scores by its cost, so columns after it are the same as before only up to
+// that offset. They still have to be recognized as same, so that edit is computed only around it.
+bool testIncrementalOffset() {
+    printf("Incremental alignment after edits that change all later scores: ");
+    bool pass = true;
+
+    // Similar sequences, with k close to edit distance, so that some edits raise it above k.
+    for (int i = 0; i < 40 && pass; i++) {
+        const int queryLength = 1 + rand() % 20000;
+        vector<char> query(queryLength), target(queryLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < queryLength; j++) target[j] = rand() % 100 ? query[j] : "ACGT"[rand() % 4];
+        const EdlibAlignMode mode = i % 2 ? EDLIB_MODE_NW : EDLIB_MODE_SHW;
+        EdlibAlignResult initial = edlibAlign(query.data(), queryLength, target.data(), queryLength,
+                                              edlibNewAlignConfig(-1, mode, EDLIB_TASK_DISTANCE, NULL, 0));
+        const int k = i % 4 < 2 ? -1 : initial.editDistance + rand() % 3;
+        edlibFreeAlignResult(initial);
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_LOC, NULL, 0);
+        EdlibIncrementalAlignment* alignment = edlibIncrementalBegin(query.data(), queryLength,
+                                                                     target.data(), queryLength, config);
+        for (int e = 0; e < 10 && pass; e++) {
+            const int targetLength = static_cast<int>(target.size());
+            const int position = rand() % (targetLength + 1);
+            const int deletedLength = min(targetLength - position, rand() % 3);
+            vector<char> inserted(rand() % 3);
+            for (char& c : inserted) c = "ACGT"[rand() % 4];
+            pass = edlibIncrementalEdit(alignment, position, deletedLength,
+                                        inserted.data(), static_cast<int>(inserted.size())) == EDLIB_STATUS_OK;
+            target.erase(target.begin() + position, target.begin() + position + deletedLength);
+            target.insert(target.begin() + position, inserted.begin(), inserted.end());
+
+            EdlibAlignResult expected = edlibAlign(query.data(), queryLength,
+                                                   target.data(), static_cast<int>(target.size()), config);
+            EdlibAlignResult result = edlibIncrementalResult(alignment);
+            pass = pass && result.editDistance == expected.editDistance
+                && result.numLocations == expected.numLocations;
+            for (int l = 0; pass && l < result.numLocations; l++) {
+                pass = result.endLocations[l] == expected.endLocations[l];
+            }
+            edlibFreeAlignResult(result);
+            edlibFreeAlignResult(expected);
+        }
+        edlibFreeIncrementalAlignment(alignment);
+    }
+
+    // Substitutions in long NW alignment must cost only few checkpoints of work each, not rest of target.
+    // Each of them recomputes about 2 / 64 of target, while recomputing until end would be about half of it.
+    if (pass) {
+        const int length = 1 << 20;
+        vector<char> query(length), target(length);
+        for (int j = 0; j < length; j++) query[j] = "ACGT"[rand() % 4];
+        target = query;
+        for (int j = 0; j < 30; j++) target[rand() % length] = "ACGT"[rand() % 4];
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0);
+        clock_t start = clock();
+        EdlibIncrementalAlignment* alignment = edlibIncrementalBegin(query.data(), length,
+                                                                     target.data(), length, config);
+        const clock_t beginTime = clock() - start;
+        clock_t editTime = 0;
+        for (int e = 0; e < 5 && pass; e++) {
+            const int position = rand() % length;
+            char substitute = "ACGT"[rand() % 4];
+            while (substitute == query[position]) substitute = "ACGT"[rand() % 4];
+            target[position] = substitute;
+            start = clock();
+            pass = edlibIncrementalEdit(alignment, position, 1, &substitute, 1) == EDLIB_STATUS_OK;
+            editTime += clock() - start;
+
+            EdlibAlignResult expected = edlibAlign(query.data(), length, target.data(), length, config);
+            EdlibAlignResult result = edlibIncrementalResult(alignment);
+            pass = pass && result.editDistance == expected.editDistance;
+            edlibFreeAlignResult(result);
+            edlibFreeAlignResult(expected);
+        }
+        edlibFreeIncrementalAlignment(alignment);
+        if (pass && editTime >= beginTime) {
+            printf("5 edits took %.3f s, while whole alignment took %.3f s! ",
+                   static_cast<double>(editTime) / CLOCKS_PER_SEC, static_cast<double>(beginTime) / CLOCKS_PER_SEC);
+            pass = false;
+        }
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testAlignQueries() {
+    printf("Queries with common prefixes: ");
+    bool pass = true;
+
+    for (int i = 0; i < 30 && pass; i++) {
+        const int numQueries = 1 + rand() % 30;
+        const int prefixLength = rand() % 300;
+        vector<string> queries(numQueries);
+        for (int j = 0; j < prefixLength; j++) queries[0] += "ACGT"[rand() % 4];
+        // Queries share prefixes of different lengths.
+        for (int q = 0; q < numQueries; q++) {
+            queries[q] = queries[0].substr(0, rand() % (prefixLength + 1));
+            const int suffixLength = rand() % (rand() % 3 ? 5 : 150);
+            for (int j = 0; j < suffixLength; j++) queries[q] += "ACGT"[rand() % 4];
+        }
+        const int targetLength = rand() % 3000;
+        string target;
+        for (int j = 0; j < targetLength; j++) {
+            target += j < static_cast<int>(queries[0].size()) && rand() % 5 ? queries[0][j] : "ACGT"[rand() % 4];
+        }
+
+        vector<const char*> queryPointers;
+        vector<int> queryLengths;
+        for (const string& query : queries) {
+            queryPointers.push_back(query.c_str());
+            queryLengths.push_back(static_cast<int>(query.size()));
+        }
+        const EdlibAlignMode mode = static_cast<EdlibAlignMode>(i % 3);
+        const EdlibAlignTask task = static_cast<EdlibAlignTask>(i / 3 % 3);
+        const int k = i % 2 ? -1 : rand() % 200;
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, NULL, 0);
+        vector<EdlibAlignResult> results(numQueries);
+        if (edlibAlignQueries(queryPointers.data(), queryLengths.data(), numQueries,
+                              target.c_str(), targetLength, config, results.data()) != EDLIB_STATUS_OK) {
+            pass = false;
+            break;
+        }
+        for (int q = 0; q < numQueries && pass; q++) {
+            EdlibAlignResult expected = edlibAlign(queryPointers[q], queryLengths[q], target.c_str(), targetLength,
+                                                   config);
+            const EdlibAlignResult& result = results[q];
+            pass = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations
+                && result.alignmentLength == expected.alignmentLength;
+            for (int l = 0; pass && l < result.numLocations; l++) {
+                pass = result.endLocations[l] == expected.endLocations[l]
+                    && (expected.startLocations == NULL || result.startLocations[l] == expected.startLocations[l]);
+            }
+            for (int l = 0; pass && l < result.alignmentLength; l++) {
+                pass = result.alignment[l] == expected.alignment[l];
+            }
+            edlibFreeAlignResult(expected);
+        }
+        for (EdlibAlignResult& result : results) edlibFreeAlignResult(result);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testDictionary() {
+    printf("Dictionary search: ");
+    bool pass = true;
+
+    for (int i = 0; i < 30 && pass; i++) {
+        // Many words share prefixes, some of them are equal.
+        const int numWords = rand() % 300;
+        vector<string> words(numWords);
+        for (int w = 0; w < numWords; w++) {
+            if (w > 0 && rand() % 2) words[w] = words[rand() % w].substr(0, rand() % 10);
+            const int suffixLength = rand() % (rand() % 3 ? 10 : 100);
+            for (int j = 0; j < suffixLength; j++) words[w] += "ACGT"[rand() % 4];
+        }
+        string query;
+        const int queryLength = rand() % (rand() % 3 ? 10 : 100);
+        for (int j = 0; j < queryLength; j++) query += "ACGT"[rand() % 4];
+
+        vector<const char*> wordPointers;
+        vector<int> wordLengths;
+        for (const string& word : words) {
+            wordPointers.push_back(word.c_str());
+            wordLengths.push_back(static_cast<int>(word.size()));
+        }
+        const EdlibAlignMode mode = static_cast<EdlibAlignMode>(i % 3);
+        const int k = i % 4 == 0 ? -1 : rand() % 10;
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_DISTANCE, NULL, 0);
+        EdlibDictionary* dictionary = edlibNewDictionary(wordPointers.data(), wordLengths.data(), numWords);
+        EdlibDictionaryResult result = edlibDictionarySearch(dictionary, query.c_str(), queryLength, config);
+
+        // Matches are ordered by edit distance, then by word.
+        vector<pair<int, int>> expected;
+        for (int w = 0; w < numWords; w++) {
+            EdlibAlignResult wordResult = edlibAlign(query.c_str(), queryLength, wordPointers[w], wordLengths[w],
+                                                     config);
+            if (wordResult.editDistance != -1) expected.push_back(make_pair(wordResult.editDistance, w));
+            edlibFreeAlignResult(wordResult);
+        }
+        sort(expected.begin(), expected.end());
+        pass = result.status == EDLIB_STATUS_OK && result.numMatches == static_cast<int>(expected.size());
+        for (int m = 0; pass && m < result.numMatches; m++) {
+            pass = result.matches[m].editDistance == expected[m].first && result.matches[m].word == expected[m].second;
+        }
+        edlibFreeDictionaryResult(result);
+        edlibFreeDictionary(dictionary);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testBarcodeIndex() {
+    printf("Barcode index: ");
+    bool pass = true;
+
+    for (int i = 0; i < 20 && pass; i++) {
+        const int k = i % 3;
+        const int numBarcodes = rand() % 200;
+        vector<string> barcodes(numBarcodes);
+        for (string& barcode : barcodes) {
+            const int barcodeLength = i % 5 == 0 ? rand() % 4 : 8 + rand() % 3;
+            for (int j = 0; j < barcodeLength; j++) barcode += "ACGT"[rand() % 4];
+        }
+        vector<const char*> barcodePointers;
+        vector<int> barcodeLengths;
+        for (const string& barcode : barcodes) {
+            barcodePointers.push_back(barcode.c_str());
+            barcodeLengths.push_back(static_cast<int>(barcode.size()));
+        }
+        EdlibBarcodeIndex* index = edlibNewBarcodeIndex(barcodePointers.data(), barcodeLengths.data(),
+                                                        numBarcodes, k);
+
+        for (int r = 0; r < 30 && pass; r++) {
+            // Read is barcode with a few random edits.
+            string read = numBarcodes > 0 ? barcodes[rand() % numBarcodes] : "";
+            const int numEdits = rand() % (k + 2);
+            for (int e = 0; e < numEdits; e++) {
+                const int position = rand() % (read.size() + 1);
+                if (rand() % 2 || position == static_cast<int>(read.size())) {
+                    read.insert(read.begin() + position, "ACGT"[rand() % 4]);
+                } else {
+                    read.erase(read.begin() + position);
+                }
+            }
+            EdlibBarcodeMatch match = edlibBarcodeIndexLookup(index, read.c_str(), static_cast<int>(read.size()));
+
+            int bestDistance = -1, numBest = 0, bestBarcode = -1;
+            for (int b = 0; b < numBarcodes; b++) {
+                int distance, numPositions;
+                int* positions;
+                calcEditDistanceSimple(read.c_str(), static_cast<int>(read.size()),
+                                       barcodes[b].c_str(), static_cast<int>(barcodes[b].size()),
+                                       EDLIB_MODE_NW, &distance, &positions, &numPositions);
+                delete[] positions;
+                if (distance > k) continue;
+                if (bestDistance == -1 || distance < bestDistance) {
+                    bestDistance = distance;
+                    numBest = 1;
+                    bestBarcode = b;
+                } else if (distance == bestDistance) {
+                    numBest++;
+                }
+            }
+            pass = match.status == EDLIB_STATUS_OK && match.editDistance == bestDistance
+                && match.ambiguous == (numBest > 1 ? 1 : 0) && match.barcode == (numBest > 1 ? -1 : bestBarcode);
+        }
+        edlibFreeBarcodeIndex(index);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+static void collectJoinPairs(const EdlibJoinPair* pairs, int numPairs, void* context) {
+    vector<EdlibJoinPair>* collected = static_cast<vector<EdlibJoinPair>*>(context);
+    collected->insert(collected->end(), pairs, pairs + numPairs);
+}
+
+bool testSimilarityJoin() {
+    printf("Similarity join: ");
+    bool pass = true;
+
+    for (int i = 0; i < 20 && pass; i++) {
+        const int k = i % 4;
+        // Sets have near duplicates of few base strings, so that many pairs are within k.
+        vector<string> bases(1 + rand() % 10);
+        for (string& base : bases) {
+            const int baseLength = i % 5 == 0 ? rand() % 5 : 20 + rand() % 60;
+            for (int j = 0; j < baseLength; j++) base += "ACGT"[rand() % 4];
+        }
+        vector<string> sets[2];
+        for (vector<string>& set : sets) {
+            set.resize(rand() % 150);
+            for (string& sequence : set) {
+                sequence = bases[rand() % bases.size()];
+                const int numEdits = rand() % (k + 3);
+                for (int e = 0; e < numEdits; e++) {
+                    const int position = rand() % (sequence.size() + 1);
+                    if (rand() % 2 || position == static_cast<int>(sequence.size())) {
+                        sequence.insert(sequence.begin() + position, "ACGT"[rand() % 4]);
+                    } else {
+                        sequence.erase(sequence.begin() + position);
+                    }
+                }
+            }
+        }
+        vector<const char*> pointers[2];
+        vector<int> lengths[2];
+        for (int s = 0; s < 2; s++) {
+            for (const string& sequence : sets[s]) {
+                pointers[s].push_back(sequence.c_str());
+                lengths[s].push_back(static_cast<int>(sequence.size()));
+            }
+        }
+        EdlibAlignConfig config = edlibDefaultAlignConfig();
+        config.k = k;
+        config.numThreads = 1 + i % 3;
+        vector<EdlibJoinPair> pairs;
+        const int status = edlibSimilarityJoin(pointers[0].data(), lengths[0].data(),
+                                               static_cast<int>(sets[0].size()),
+                                               pointers[1].data(), lengths[1].data(),
+                                               static_cast<int>(sets[1].size()),
+                                               config, collectJoinPairs, &pairs);
+        pass = status == EDLIB_STATUS_OK;
+
+        // Pairs must be exactly those found by aligning all pairs, ordered by a and then by b.
+        size_t numFound = 0;
+        for (int a = 0; a < static_cast<int>(sets[0].size()) && pass; a++) {
+            for (int b = 0; b < static_cast<int>(sets[1].size()) && pass; b++) {
+                int distance, numPositions;
+                int* positions;
+                calcEditDistanceSimple(sets[0][a].c_str(), lengths[0][a], sets[1][b].c_str(), lengths[1][b],
+                                       EDLIB_MODE_NW, &distance, &positions, &numPositions);
+                delete[] positions;
+                if (distance > k) continue;
+                pass = numFound < pairs.size() && pairs[numFound].a == a && pairs[numFound].b == b
+                    && pairs[numFound].editDistance == distance;
+                numFound++;
+            }
+        }
+        pass = pass && numFound == pairs.size();
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+static void collectScanPositions(long long endLocation, int editDistance, void* context) {
+    vector< pair<long long, int> >* positions = static_cast<vector< pair<long long, int> >*>(context);
+    positions->push_back(make_pair(endLocation, editDistance));
+}
+
+bool testScan() {
+    printf("Scan: ");
+    bool pass = true;
+
+    for (int i = 0; i < 30 && pass; i++) {
+        const int queryLength = i % 3 == 0 ? rand() % 10 : 1 + rand() % 200;
+        const int textLength = rand() % 3000;
+        vector<char> query(queryLength), text(textLength);
+        for (int j = 0; j < queryLength; j++) query[j] = "ACGT"[rand() % 4];
+        for (int j = 0; j < textLength; j++) text[j] = "ACGT\n"[rand() % (i % 2 ? 5 : 4)];
+        for (int p = 0; p < 5 && textLength > queryLength; p++) {  // Plant query into text, with some mutations.
+            const int start = rand() % (textLength - queryLength);
+            for (int j = 0; j < queryLength; j++) {
+                if (rand() % 10) text[start + j] = query[j];
+            }
+        }
+        const int k = rand() % (queryLength / 4 + 2);
+        const int separator = i % 4 == 1 ? -1 : '\n';
+
+        // Last row of dynamic programming matrix of HW alignment, which restarts after each separator.
+        vector< pair<long long, int> > expected;
+        vector<int> column(queryLength + 1);
+        for (int r = 0; r <= queryLength; r++) column[r] = r;
+        for (int c = 0; c < textLength; c++) {
+            if (text[c] == separator) {
+                for (int r = 0; r <= queryLength; r++) column[r] = r;
+                continue;
+            }
+            int diagonal = column[0];
+            for (int r = 1; r <= queryLength; r++) {
+                const int value = min(diagonal + (query[r - 1] == text[c] ? 0 : 1),
+                                      min(column[r - 1], column[r]) + 1);
+                diagonal = column[r];
+                column[r] = value;
+            }
+            if (column[queryLength] <= k) expected.push_back(make_pair(c, column[queryLength]));
+        }
+
+        EdlibQueryProfile* profile = edlibNewQueryProfile(query.data(), queryLength, edlibDefaultAlignConfig());
+        vector< pair<long long, int> > positions;
+        const int status = edlibScan(profile, text.data(), textLength, k, separator,
+                                     collectScanPositions, &positions);
+        pass = status == EDLIB_STATUS_OK && positions == expected;
+        edlibFreeQueryProfile(profile);
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+/**
+ * @return Edit distance (NW) between a and b, computed directly.
+ */
+static int directDistance(const string& a, const string& b) {
+    vector<int> column(a.size() + 1);
+    for (int r = 0; r <= static_cast<int>(a.size()); r++) column[r] = r;
+    for (int c = 0; c < static_cast<int>(b.size()); c++) {
+        int diagonal = column[0];
+        column[0] = c + 1;
+        for (int r = 1; r <= static_cast<int>(a.size()); r++) {
+            const int value = min(diagonal + (a[r - 1] == b[c] ? 0 : 1), min(column[r - 1], column[r]) + 1);
+            diagonal = column[r];
+            column[r] = value;
+        }
+    }
+    return column[a.size()];
+}
+
+bool testTrimRead() {
+    printf("Trim read: ");
+    bool pass = true;
+
+    for (int i = 0; i < 200 && pass; i++) {
+        EdlibTrimConfig trimConfig = edlibDefaultTrimConfig();
+        trimConfig.end = i % 2 ? EDLIB_TRIM_START : EDLIB_TRIM_END;
+        trimConfig.maxErrorRate = (rand() % 4) * 0.1;
+        trimConfig.minOverlap = rand() % 5;
+        trimConfig.searchLength = i % 3 ? -1 : rand() % 100;
+        const int numAdapters = 1 + rand() % 12;
+        vector<string> adapters(numAdapters);
+        vector<const char*> adapterPointers(numAdapters);
+        vector<int> adapterLengths(numAdapters);
+        for (int a = 0; a < numAdapters; a++) {
+            const int length = rand() % 10 ? rand() % 40 : 60 + rand() % 100;
+            for (int j = 0; j < length; j++) adapters[a] += "ACGT"[rand() % 4];
+            adapterPointers[a] = adapters[a].data();
+            adapterLengths[a] = length;
+        }
+        string read;
+        const int readLength = rand() % 150;
+        for (int j = 0; j < readLength; j++) read += "ACGT"[rand() % 4];
+        if (!adapters[0].empty() && readLength > 0) {  // Plant (part of) adapter at trimmed end, with mutations.
+            const string& adapter = adapters[rand() % numAdapters];
+            for (int j = 0; j < static_cast<int>(adapter.size()) && j < readLength; j++) {
+                if (rand() % 15 == 0) continue;
+                if (trimConfig.end == EDLIB_TRIM_END) read[readLength - 1 - j] = adapter[adapter.size() - 1 - j];
+                else read[j] = adapter[j];
+            }
+        }
+
+        // Adapters and read are oriented so that trimmed end is end of read, and each occurrence is checked.
+        const bool reversed = trimConfig.end == EDLIB_TRIM_START;
+        string orientedRead = read;
+        if (reversed) reverse(orientedRead.begin(), orientedRead.end());
+        const int searchStart = trimConfig.searchLength == -1 ? 0 : max(0, readLength - trimConfig.searchLength);
+        int bestAdapter = -1, bestLength = 0, bestDistance = 0, bestEnd = 0;
+        for (int a = 0; a < numAdapters; a++) {
+            string adapter = adapters[a];
+            if (reversed) reverse(adapter.begin(), adapter.end());
+            const int m = static_cast<int>(adapter.size());
+            vector<int> column(m + 1);
+            for (int r = 0; r <= m; r++) column[r] = r;
+            for (int c = searchStart; c < readLength; c++) {
+                int diagonal = column[0];
+                for (int r = 1; r <= m; r++) {
+                    const int value = min(diagonal + (adapter[r - 1] == orientedRead[c] ? 0 : 1),
+                                          min(column[r - 1], column[r]) + 1);
+                    diagonal = column[r];
+                    column[r] = value;
+                }
+                for (int length = 1; length <= m; length++) {
+                    if (length < m && (c < readLength - 1 || length < max(1, trimConfig.minOverlap))) continue;
+                    const int distance = column[length];
+                    if (distance > static_cast<int>(trimConfig.maxErrorRate * length + 1e-9)) continue;
+                    if (bestAdapter == -1 || length > bestLength
+                        || (length == bestLength && (distance < bestDistance
+                                                     || (distance == bestDistance && c < bestEnd)))) {
+                        bestAdapter = a;
+                        bestLength = length;
+                        bestDistance = distance;
+                        bestEnd = c;
+                    }
+                }
+            }
+        }
+
+        EdlibAdapterPanel* panel = edlibNewAdapterPanel(adapterPointers.data(), adapterLengths.data(), numAdapters,
+                                                        trimConfig, edlibDefaultAlignConfig());
+        const EdlibTrimResult result = edlibTrimRead(panel, read.data(), readLength);
+        edlibFreeAdapterPanel(panel);
+        pass = result.status == EDLIB_STATUS_OK && result.adapter == bestAdapter;
+        if (pass && bestAdapter != -1) {
+            string adapter = adapters[bestAdapter];
+            if (reversed) reverse(adapter.begin(), adapter.end());
+            adapter.resize(bestLength);
+            // Occurrence is the longest one that ends at best end and has best distance.
+            int start = bestEnd + 1;
+            for (int s = searchStart; s <= bestEnd + 1; s++) {
+                if (directDistance(adapter, orientedRead.substr(s, bestEnd - s + 1)) == bestDistance) {
+                    start = s;
+                    break;
+                }
+            }
+            pass = result.editDistance == bestDistance && result.adapterLength == bestLength
+                && result.startLocation == (reversed ? readLength - 1 - bestEnd : start)
+                && result.endLocation == (reversed ? readLength - 1 - start : bestEnd);
+        }
+    }
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testPlanAllVsAll() {
+    printf("Plan all vs all: ");
+    bool pass = true;
+
+    for (int i = 0; i < 100 && pass; i++) {
+        const int numSequences = i % 10 == 0 ? rand() % 3 : rand() % 200;
+        const int numShards = 1 + rand() % (i % 2 ? 4 : 40);
+        vector<int> lengths(numSequences);
+        for (int& length : lengths) length = i % 3 == 0 ? rand() % 3 : rand() % 1000;
+        const EdlibAllVsAllPlan plan = edlibPlanAllVsAll(lengths.data(), numSequences, numShards);
+        pass = plan.status == EDLIB_STATUS_OK && plan.numShards == numShards
+            && plan.shardTiles[0] == 0 && plan.shardTiles[numShards] == plan.numTiles;
+        for (int s = 0; s < numShards && pass; s++) pass = plan.shardTiles[s] <= plan.shardTiles[s + 1];
+
+        // Each pair i < j must be in exactly one tile, and work of tiles must sum to work of all pairs.
+        vector< vector<int> > covered(numSequences, vector<int>(numSequences, 0));
+        double maxTileWork = 0;
+        for (int t = 0; t < plan.numTiles && pass; t++) {
+            const EdlibTile& tile = plan.tiles[t];
+            double work = 0;
+            for (int a = tile.rowBegin; a < tile.rowEnd; a++) {
+                for (int b = max(a + 1, tile.columnBegin); b < tile.columnEnd; b++) {
+                    covered[a][b]++;
+                    work += static_cast<double>(max(lengths[a], 1)) * max(lengths[b], 1);
+                }
+            }
+            pass = fabs(work - tile.work) <= 1e-6 * work;
+            maxTileWork = max(maxTileWork, work);
+        }
+        double totalWork = 0;
+        for (int a = 0; a < numSequences && pass; a++) {
+            for (int b = 0; b < numSequences && pass; b++) {
+                pass = covered[a][b] == (a < b ? 1 : 0);
+                if (a < b) totalWork += static_cast<double>(max(lengths[a], 1)) * max(lengths[b], 1);
+            }
+        }
+        // No shard has more than one tile of work over its share.
+        for (int s = 0; s < numShards && pass; s++) {
+            double shardWork = 0;
+            for (int t = plan.shardTiles[s]; t < plan.shardTiles[s + 1]; t++) shardWork += plan.tiles[t].work;
+            pass = shardWork <= totalWork / numShards + maxTileWork + 1e-6 * totalWork;
+        }
+        // Plan is the same each time it is made.
+        const EdlibAllVsAllPlan again = edlibPlanAllVsAll(lengths.data(), numSequences, numShards);
+        pass = pass && again.numTiles == plan.numTiles
+            && !memcmp(again.tiles, plan.tiles, sizeof(EdlibTile) * plan.numTiles)
+            && !memcmp(again.shardTiles, plan.shardTiles, sizeof(int) * (numShards + 1));
+        edlibFreeAllVsAllPlan(again);
+        edlibFreeAllVsAllPlan(plan);
+    }
+    const int negativeLength = -1;
+    EdlibAllVsAllPlan plan = edlibPlanAllVsAll(&negativeLength, 1, 1);
+    pass = pass && plan.status == EDLIB_STATUS_ERROR;
+    edlibFreeAllVsAllPlan(plan);
+    plan = edlibPlanAllVsAll(NULL, 0, 0);
+    pass = pass && plan.status == EDLIB_STATUS_ERROR;
+    edlibFreeAllVsAllPlan(plan);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+bool testAlignAllPairs() {
+    printf("All pairs of queries and targets: ");
+    bool pass = true;
+
+    for (int i = 0; i < 30 && pass; i++) {
+        // Sequences are variants of one base, and some have characters that others do not have.
+        const char* const alphabet = i % 4 == 3 ? "ACGTacgtN" : "ACGT";
+        const int alphabetSize = static_cast<int>(strlen(alphabet));
+        string base;
+        const int baseLength = rand() % 400;
+        for (int j = 0; j < baseLength; j++) base += "ACGT"[rand() % 4];
+        vector<string> sequences[2];
+        for (vector<string>& set : sequences) {
+            set.resize(rand() % 12);
+            for (string& sequence : set) {
+                const int start = rand() % (baseLength + 1);
+                sequence = base.substr(start, rand() % (baseLength - start + 1));
+                for (char& c : sequence) {
+                    if (rand() % 10 == 0) c = alphabet[rand() % alphabetSize];
+                }
+            }
+        }
+        vector<const char*> pointers[2];
+        vector<int> lengths[2];
+        for (int s = 0; s < 2; s++) {
+            for (const string& sequence : sequences[s]) {
+                pointers[s].push_back(sequence.c_str());
+                lengths[s].push_back(static_cast<int>(sequence.size()));
+            }
+        }
+        const int numQueries = static_cast<int>(sequences[0].size());
+        const int numTargets = static_cast<int>(sequences[1].size());
+        const EdlibAlignMode mode = static_cast<EdlibAlignMode>(i % 3);
+        const EdlibAlignTask task = static_cast<EdlibAlignTask>(i / 3 % 3);
+        const int k = i % 2 ? -1 : rand() % 100;
+        EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, NULL, 0);
+        config.numThreads = 1 + i % 3;
+        if (i % 8 == 3) config.equalityPresets = EDLIB_EQUALITY_CASE_INSENSITIVE | EDLIB_EQUALITY_IUPAC_NUCLEOTIDE;
+        vector<EdlibAlignResult> results(numQueries * numTargets);
+        if (edlibAlignAllPairs(pointers[0].data(), lengths[0].data(), numQueries,
+                               pointers[1].data(), lengths[1].data(), numTargets,
+                               config, results.data()) != EDLIB_STATUS_OK) {
+            pass = false;
+            break;
+        }
+        for (int q = 0; q < numQueries; q++) {
+            for (int t = 0; t < numTargets; t++) {
+                EdlibAlignResult& result = results[q * numTargets + t];
+                EdlibAlignResult expected = edlibAlign(pointers[0][q], lengths[0][q], pointers[1][t], lengths[1][t],
+                                                       config);
+                pass = pass && result.status == expected.status && result.editDistance == expected.editDistance
+                    && result.numLocations == expected.numLocations
+                    && result.alphabetLength == expected.alphabetLength
+                    && result.alignmentLength == expected.alignmentLength
+                    && (expected.startLocations == NULL) == (result.startLocations == NULL);
+                for (int l = 0; pass && l < result.numLocations; l++) {
+                    pass = result.endLocations[l] == expected.endLocations[l]
+                        && (expected.startLocations == NULL || result.startLocations[l] == expected.startLocations[l]);
+                }
+                for (int l = 0; pass && l < result.alignmentLength; l++) {
+                    pass = result.alignment[l] == expected.alignment[l];
+                }
+                edlibFreeAlignResult(expected);
+                edlibFreeAlignResult(result);
+            }
+        }
+    }
+    const int negativeLength = -1;
+    const char* const sequence = "A";
+    EdlibAlignResult result;
+    pass = pass && edlibAlignAllPairs(&sequence, &negativeLength, 1, &sequence, &negativeLength, 1,
+                                      edlibDefaultAlignConfig(), &result) == EDLIB_STATUS_ERROR;
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
+// Checks that result stored in arena is the same as expected one.
+static bool sameArenaResult(const EdlibResultArena* const arena, const long long index,
+                            const EdlibAlignResult& expected, const bool withCigars,
+                            const EdlibCigarFormat cigarFormat) {
+    const EdlibAlignResult result = edlibResultArenaGet(arena, index);
+    bool same = result.status == expected.status && result.editDistance == expected.editDistance
+        && result.alphabetLength == expected.alphabetLength && result.numLocations == expected.numLocations
+        && result.alignmentLength == expected.alignmentLength
+        && (result.startLocations == NULL) == (expected.startLocations == NULL)
+        && (result.alignment == NULL) == (expected.alignment == NULL);
+    for (int l = 0; same && l < result.numLocations; l++) {
+        same = result.endLocations[l] == expected.endLocations[l]
+            && (expected.startLocations == NULL || result.startLocations[l] == expected.startLocations[l]);
+    }
+    for (int l = 0; same && l < result.alignmentLength; l++) same = result.alignment[l] == expected.alignment[l];
+    const char* const cigar = edlibResultArenaCigar(arena, index);
+    if (same && withCigars && expected.alignment) {
+        char* const expectedCigar = edlibAlignmentToCigar(expected.alignment, expected.alignmentLength, cigarFormat);
+        same = cigar != NULL && !strcmp(cigar, expectedCigar);
+        free(expectedCigar);
+    } else {
+        same = same && cigar == NULL;
+    }
+    return same;
+}
+
+bool testResultArena() {
+    printf("Result arena: ");
+    bool pass = true;
+    const char* const path = "runTestsResultArena.bin";
+
+    for (int i = 0; i < 20 && pass; i++) {
+        vector<string> sequences[2];
+        for (vector<string>& set : sequences) {
+            set.resize(rand() % 8);
+            for (string& sequence : set) {
+                const int length = rand() % 200;
+                for (int j = 0; j < length; j++) sequence += "ACGT"[rand() % (i % 2 ? 4 : 2)];
+            }
+        }
+        vector<const char*> pointers[2];
+        vector<int> lengths[2];
+        for (int s = 0; s < 2; s++) {
+            for (const string& sequence : sequences[s]) {
+                pointers[s].push_back(sequence.c_str());
+                lengths[s].push_back(static_cast<int>(sequence.size()));
+            }
+        }
+        const int numQueries = static_cast<int>(sequences[0].size());
+        const int numTargets = static_cast<int>(sequences[1].size());
+        const EdlibAlignConfig config = edlibNewAlignConfig(i % 3 ? -1 : rand() % 50,
+                                                            static_cast<EdlibAlignMode>(i % 3),
+                                                            static_cast<EdlibAlignTask>(i / 3 % 3), NULL, 0);
+        const EdlibCigarFormat cigarFormat = i % 2 ? EDLIB_CIGAR_EXTENDED : EDLIB_CIGAR_STANDARD;
+        const bool withCigars = i % 4 != 0;
+        EdlibResultArena* const arena = edlibNewResultArena(withCigars, cigarFormat);
+        // Results are appended in two batches.
+        vector<EdlibAlignResult> results(numQueries * numTargets);
+        edlibAlignAllPairs(pointers[0].data(), lengths[0].data(), numQueries,
+                           pointers[1].data(), lengths[1].data(), numTargets, config, results.data());
+        const int firstBatch = static_cast<int>(results.size()) / 2;
+        pass = edlibResultArenaAppend(arena, results.data(), firstBatch) == EDLIB_STATUS_OK
+            && edlibResultArenaAppend(arena, results.data() + firstBatch,
+                                      static_cast<int>(results.size()) - firstBatch) == EDLIB_STATUS_OK
+            && edlibResultArenaSize(arena) == static_cast<long long>(results.size())
+            && edlibSaveResultArena(arena, path) == EDLIB_STATUS_OK;
+        EdlibResultArena* const loaded = edlibLoadResultArena(path);
+        pass = pass && loaded != NULL && edlibResultArenaSize(loaded) == edlibResultArenaSize(arena);
+
+        // The same batch aligned straight into arena, after queries aligned to first target.
+        EdlibAlignConfig directConfig = config;
+        directConfig.numThreads = i % 2 ? 3 : 1;
+        EdlibResultArena* const direct = edlibNewResultArena(withCigars, cigarFormat);
+        const long long numDirectQueries = numTargets > 0 ? numQueries : 0;
+        if (numTargets > 0) {
+            pass = pass && edlibAlignQueriesToArena(pointers[0].data(), lengths[0].data(), numQueries,
+                                                    pointers[1][0], lengths[1][0], directConfig,
+                                                    direct) == EDLIB_STATUS_OK;
+        }
+        pass = pass && edlibAlignAllPairsToArena(pointers[0].data(), lengths[0].data(), numQueries,
+                                                 pointers[1].data(), lengths[1].data(), numTargets,
+                                                 directConfig, direct) == EDLIB_STATUS_OK
+            && edlibResultArenaSize(direct) == numDirectQueries + edlibResultArenaSize(arena);
+        for (int q = 0; q < numDirectQueries && pass; q++) {
+            EdlibAlignResult expected = edlibAlign(pointers[0][q], lengths[0][q], pointers[1][0], lengths[1][0],
+                                                   config);
+            pass = sameArenaResult(direct, q, expected, withCigars, cigarFormat);
+            edlibFreeAlignResult(expected);
+        }
+
+        // File contents are used in place by arena created from buffer.
+        vector<uint64_t> buffer;
+        FILE* const file = fopen(path, "rb");
+        if (file) {
+            uint64_t word;
+            while (fread(&word, sizeof(word), 1, file) == 1) buffer.push_back(word);
+            fclose(file);
+        }
+        const long long size = static_cast<long long>(buffer.size() * sizeof(uint64_t));
+        EdlibResultArena* const viewed = edlibResultArenaFromBuffer(buffer.data(), size);
+        pass = pass && viewed != NULL && edlibResultArenaSize(viewed) == edlibResultArenaSize(arena);
+        for (int q = 0; q < numQueries && pass; q++) {
+            for (int t = 0; t < numTargets && pass; t++) {
+                EdlibAlignResult expected = edlibAlign(pointers[0][q], lengths[0][q], pointers[1][t], lengths[1][t],
+                                                       config);
+                const long long index = static_cast<long long>(q) * numTargets + t;
+                pass = sameArenaResult(arena, index, expected, withCigars, cigarFormat)
+                    && sameArenaResult(loaded, index, expected, withCigars, cigarFormat)
+                    && sameArenaResult(viewed, index, expected, withCigars, cigarFormat)
+                    && sameArenaResult(direct, numDirectQueries + index, expected, withCigars, cigarFormat);
+                edlibFreeAlignResult(expected);
+            }
+        }
+        pass = pass && edlibResultArenaGet(arena, edlibResultArenaSize(arena)).status == EDLIB_STATUS_ERROR
+            && edlibResultArenaAppend(loaded, results.data(), 0) == EDLIB_STATUS_ERROR
+            && edlibAlignAllPairsToArena(pointers[0].data(), lengths[0].data(), numQueries,
+                                         pointers[1].data(), lengths[1].data(), numTargets,
+                                         config, loaded) == EDLIB_STATUS_ERROR
+            && edlibAlignQueriesToArena(pointers[0].data(), lengths[0].data(), numQueries, "A", 1,
+                                        config, loaded) == EDLIB_STATUS_ERROR;
+        // Truncated or corrupted contents are not accepted.
+        if (pass && size > 48) {
+            pass = edlibResultArenaFromBuffer(buffer.data(), size - 8) == NULL;
+            buffer[0] ^= 1;
+            pass = pass && edlibResultArenaFromBuffer(buffer.data(), size) == NULL;
+        }
+        edlibFreeResultArena(direct);
+        edlibFreeResultArena(viewed);
+        edlibFreeResultArena(loaded);
+        edlibFreeResultArena(arena);
+    }
+    remove(path);
+
+    printf(pass ? "\x1B[32m""OK""\x1B[0m\n" : "\x1B[31m""FAIL""\x1B[0m\n");
+    return pass;
+}
+
 bool runTests() {
     // TODO: make this global vector where tests have to add themselves.
-    int numTests = 19;
+    int numTests = 43;
     bool (* tests [])() = {test1, test2, test3, test4, test5, test6,
                            test7, test8, test9, test10, test11, test12, test13, test14, test15, test16,
-                           testCigar, testCustomEqualityRelation, testEmptySequences};
+                           testCigar, testCustomEqualityRelation, testEmptySequences, testPackedSequences,
+                           testEqualityPresets, testForeignTargetCharacters,
+                           testForeignRuns, testParallelHW, testPipelinedNW,
+                           testSpeculativeRounds, testSpeculativeRoundsNW, testExecutor, testCancellation, testProgress,
+                           testStream, testColumnState, testIncremental, testIncrementalOffset,
+                           testAlignQueries, testDictionary, testBarcodeIndex,
+                           testSimilarityJoin, testScan, testTrimRead, testPlanAllVsAll,
+                           testAlignAllPairs, testResultArena};
 
     bool allTestsPassed = true;
     for (int i = 0; i < numTests; i++) {
@@ -0,0 +1,239 @@
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "edlib.h"
+#include "../apps/server/edlibClient.h"
+#include "../apps/server/protocol.h"
+
+using namespace std;
+
+// Starts edlib-server (path of which is the only parameter), aligns queries of concurrent clients on it
+// and checks that results are the same as those of edlibAlign(). One more client sends many requests and never
+// reads responses, which should neither hold up other clients nor stop server from shutting down.
+
+static vector<char> randomSequence(int length) {
+    vector<char> sequence(length);
+    for (char& c : sequence) c = "ACTG"[rand() % 4];
+    return sequence;
+}
+
+static bool sameResults(const EdlibAlignResult& expected, const EdlibAlignResult& actual) {
+    if (expected.status != actual.status || expected.editDistance != actual.editDistance
+        || expected.numLocations != actual.numLocations || expected.alignmentLength != actual.alignmentLength
+        || (expected.startLocations == NULL) != (actual.startLocations == NULL)
+        || (expected.alignment == NULL) != (actual.alignment == NULL)) {
+        return false;
+    }
+    for (int i = 0; i < expected.numLocations; i++) {
+        if (expected.endLocations[i] != actual.endLocations[i]) return false;
+        if (expected.startLocations && expected.startLocations[i] != actual.startLocations[i]) return false;
+    }
+    return expected.alignment == NULL
+        || memcmp(expected.alignment, actual.alignment, expected.alignmentLength) == 0;
+}
+
+static EdlibClient* connectToServer(const char* socketPath) {
+    for (int attempt = 0; attempt < 200; attempt++) {
+        EdlibClient* client = edlibClientConnect(socketPath);
+        if (client) return client;
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    return NULL;
+}
+
+/**
+ * Aligns queries cut out of references (with some mutations) on server, in few calls of edlibClientAlign().
+ * @return Number of results that differ from those of edlibAlign(), or -1 if server could not be reached.
+ */
+static int runClient(const char* socketPath, const vector< vector<char> >& references, unsigned seed) {
+    EdlibClient* client = connectToServer(socketPath);
+    if (client == NULL) return -1;
+    int numWrong = 0;
+    const EdlibAlignMode modes[3] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    const EdlibAlignTask tasks[3] = {EDLIB_TASK_DISTANCE, EDLIB_TASK_LOC, EDLIB_TASK_PATH};
+    for (int call = 0; call < 6; call++) {
+        const int reference = (seed + call) % references.size();
+        const vector<char>& target = references[reference];
+        const EdlibAlignMode mode = modes[call % 3];
+        const int k = call % 2 ? -1 : 30;
+        const EdlibAlignConfig config = edlibNewAlignConfig(k, mode, tasks[(call / 2) % 3], NULL, 0);
+        vector< vector<char> > queries(20);
+        for (vector<char>& query : queries) {
+            const int length = 50 + rand_r(&seed) % 150;
+            const int start = mode == EDLIB_MODE_NW ? 0 : rand_r(&seed) % (target.size() - length);
+            query.assign(target.begin() + start, target.begin() + start + length);
+            for (int i = 0; i < length / 20; i++) query[rand_r(&seed) % length] = "ACTG"[rand_r(&seed) % 4];
+        }
+        vector<const char*> queryPointers;
+        vector<int> queryLengths;
+        for (const vector<char>& query : queries) {
+            queryPointers.push_back(query.data());
+            queryLengths.push_back(static_cast<int>(query.size()));
+        }
+        vector<EdlibAlignResult> results(queries.size());
+        if (edlibClientAlign(client, reference, queryPointers.data(), queryLengths.data(),
+                             static_cast<int>(queries.size()), config, results.data()) != EDLIB_STATUS_OK) {
+            edlibClientClose(client);
+            return -1;
+        }
+        for (size_t i = 0; i < queries.size(); i++) {
+            EdlibAlignResult expected = edlibAlign(queries[i].data(), queryLengths[i],
+                                                   target.data(), static_cast<int>(target.size()), config);
+            if (!sameResults(expected, results[i])) numWrong++;
+            edlibFreeAlignResult(expected);
+            edlibFreeAlignResult(results[i]);
+        }
+    }
+    edlibClientClose(client);
+    return numWrong;
+}
+
+/**
+ * Connects to server and sends it requests with long alignments, whose responses do not fit into socket buffers.
+ * @return Socket, which is never read from, or -1 on failure.
+ */
+static int sendWithoutReading(const char* socketPath, const vector<char>& reference) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) return -1;
+    const int queryLength = 2000;
+    vector<char> request(sizeof(EdlibRequestHeader));
+    EdlibRequestHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = EDLIB_SERVER_MAGIC;
+    header.type = EDLIB_REQUEST_ALIGN;
+    header.reference = 0;
+    header.k = -1;
+    header.mode = EDLIB_MODE_HW;
+    header.task = EDLIB_TASK_PATH;
+    header.queryLength = queryLength;
+    memcpy(request.data(), &header, sizeof(header));
+    request.insert(request.end(), reference.begin(), reference.begin() + queryLength);
+    for (int i = 0; i < 500; i++) {
+        if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <edlib-server>\n", argv[0]);
+        return 1;
+    }
+    srand(42);
+    char directory[] = "/tmp/edlib-server-test-XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        fprintf(stderr, "Error: Can not create temporary directory\n");
+        return 1;
+    }
+    const string socketPath = string(directory) + "/edlib.sock";
+    const string referencesPath = string(directory) + "/references.fasta";
+    vector< vector<char> > references;
+    references.push_back(randomSequence(20000));
+    references.push_back(randomSequence(3000));
+    FILE* file = fopen(referencesPath.c_str(), "w");
+    for (size_t i = 0; i < references.size(); i++) {
+        fprintf(file, ">ref%d\n", static_cast<int>(i));
+        fwrite(references[i].data(), 1, references[i].size(), file);
+        fprintf(file, "\n");
+    }
+    fclose(file);
+
+    const pid_t server = fork();
+    if (server == 0) {
+        execl(argv[1], argv[1], "-t", "2", "-b", "16", socketPath.c_str(), referencesPath.c_str(),
+              static_cast<char*>(NULL));
+        _exit(127);
+    }
+
+    bool allTestsPassed = true;
+    EdlibClient* probe = connectToServer(socketPath.c_str());
+    if (probe == NULL) {
+        printf("Server did not start!\n");
+        allTestsPassed = false;
+    } else {
+        edlibClientClose(probe);
+    }
+
+    int slowFd = -1;
+    if (allTestsPassed) {
+        slowFd = sendWithoutReading(socketPath.c_str(), references[0]);
+        if (slowFd < 0) {
+            printf("Client that does not read could not connect!\n");
+            allTestsPassed = false;
+        }
+    }
+
+    if (allTestsPassed) {
+        const int numClients = 4;
+        vector<int> numWrong(numClients);
+        atomic<int> numDone(0);
+        vector<thread> clients;
+        for (int i = 0; i < numClients; i++) {
+            clients.push_back(thread([&, i]() {
+                numWrong[i] = runClient(socketPath.c_str(), references, 100 + i);
+                numDone++;
+            }));
+        }
+        const auto deadline = chrono::steady_clock::now() + chrono::seconds(60);
+        while (numDone < numClients && chrono::steady_clock::now() < deadline) {
+            this_thread::sleep_for(chrono::milliseconds(20));
+        }
+        const bool answered = numDone == numClients;
+        if (!answered) {
+            printf("Clients were not answered while another client did not read its responses!\n");
+            allTestsPassed = false;
+            kill(server, SIGKILL);  // So that clients that wait for responses fail.
+        }
+        for (thread& client : clients) client.join();
+        for (int i = 0; i < numClients && answered; i++) {
+            if (numWrong[i] != 0) {
+                printf("Client %d: %d results differ from edlibAlign()!\n", i, numWrong[i]);
+                allTestsPassed = false;
+            }
+        }
+    }
+
+    // Server should stop although client that does not read is still connected.
+    kill(server, SIGTERM);
+    int status = -1;
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+    while (waitpid(server, &status, WNOHANG) == 0) {
+        if (chrono::steady_clock::now() > deadline) {
+            printf("Server did not stop!\n");
+            allTestsPassed = false;
+            kill(server, SIGKILL);
+            waitpid(server, &status, 0);
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    if (slowFd >= 0) close(slowFd);
+    unlink(referencesPath.c_str());
+    unlink(socketPath.c_str());
+    rmdir(directory);
+
+    if (allTestsPassed) {
+        printf("All server tests passed!\n");
+        return 0;
+    }
+    printf("Some server tests failed\n");
+    return 1;
+}